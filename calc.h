@@ -0,0 +1,79 @@
+#ifndef CALC_H
+#define CALC_H
+
+/* libcalc: la calculatrice sous forme de bibliothèque.
+   Un contexte possède ses variables et évalue une ligne à la fois, avec le même langage et les mêmes messages que la
+   console. Les fonctions sont réentrantes: plusieurs threads peuvent chacun utiliser leur propre contexte. Un même
+   contexte ne doit pas être utilisé par deux threads en même temps. La limite mémoire (#mem max) est commune au
+   processus. */
+
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define CALC_API __attribute__((visibility("default")))
+#else
+#define CALC_API
+#endif
+
+// Codes de retour, identiques à ceux de la calculatrice.
+#define CALC_OK 0
+#define CALC_ERR_NOMEM 1
+#define CALC_ERR_SYNTAX 2
+#define CALC_ERR_FILE 3
+#define CALC_ERR_INTERRUPTED 4 // Calcul arrêté par calc_interrupt ou par la limite de temps (#time max).
+#define CALC_ERR_LIMIT 5 // Résultat refusé avant tout calcul: n! aurait plus de 2 000 000 chiffres.
+
+typedef struct calc_ctx calc_ctx;
+
+/* Tampon de résultat: le texte est ajouté à la suite de data (len octets, sans '\0' final). Il se réutilise d'un
+   appel à l'autre avec calc_buffer_clear et se libère avec calc_buffer_free. */
+typedef struct calc_buffer { char *data; size_t len; size_t cap; } calc_buffer;
+
+#define CALC_BUFFER_INIT {NULL, 0, 0}
+
+// Renvoie NULL si out of memory. Nouveau contexte, sans variables.
+CALC_API calc_ctx* calc_new(void);
+
+// Détruit le contexte et ses variables. NULL est accepté.
+CALC_API void calc_free(calc_ctx *ctx);
+
+/* Évalue une ligne (len octets, sans '\n') et ajoute à out ce que la console afficherait: le résultat suivi de '\n',
+   la sortie d'une commande ou le message d'erreur. Retourne l'un des codes CALC_*. */
+CALC_API int calc_eval_line(calc_ctx *ctx, const char *buf, size_t len, calc_buffer *out);
+
+/* Comme calc_eval_line, mais le texte est écrit dans out au fil du calcul, sans être gardé en mémoire: un grand
+   résultat part par morceaux. Les erreurs d'écriture restent sur out (ferror). */
+CALC_API int calc_eval_line_file(calc_ctx *ctx, const char *buf, size_t len, FILE *out);
+
+// Équivalents des commandes save et load. Retournent l'un des codes CALC_*.
+CALC_API int calc_save(calc_ctx *ctx, const char *path, calc_buffer *out);
+CALC_API int calc_load(calc_ctx *ctx, const char *path, calc_buffer *out);
+
+/* Nombre de threads utilisés par les grands calculs (multiplication au-delà de quelques milliers de chiffres), pour
+   tout le processus. 1: séquentiel, 0: un par cœur (par défaut). */
+CALC_API void calc_set_threads(int threads);
+
+/* Arrête les calculs en cours, dans tous les contextes: les lignes en cours échouent avec CALC_ERR_INTERRUPTED, sans
+   changer les variables. Peut être appelée depuis un gestionnaire de signal. Sans effet si aucune ligne n'est en cours. */
+CALC_API void calc_interrupt(void);
+
+CALC_API void calc_buffer_init(calc_buffer *buffer);
+
+// Vide le tampon en gardant sa capacité.
+CALC_API void calc_buffer_clear(calc_buffer *buffer);
+
+CALC_API void calc_buffer_free(calc_buffer *buffer);
+
+// Renvoie 1 si out of memory. Ajoute len octets au tampon.
+CALC_API int calc_buffer_append(calc_buffer *buffer, const char *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
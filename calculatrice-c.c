@@ -1,6 +1,31 @@
+#define _GNU_SOURCE // fopencookie
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <malloc.h>
 #include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include "calc.h"
+
+#ifdef ORACLE
+#include <gmp.h>
+#endif
 
 // Chiffre qui est chaîné à au poids le plus fort
 typedef struct cell{ char chiffre; struct cell *suivant; } cell;
@@ -19,20 +44,56 @@ typedef struct pile {int length; struct node *top;} pile;
 /*
    Une structure mémoire afin de pouvoir conserver les variables déjà affectées
    Le buffer qui utilisera les valeurs actuellement affectées par l'expression permet de protéger la mémoire en cas d'erreurs lors de l'évaluation
-   de l'expression postfixe. La mémoire est une liste chaînée également. */
+   de l'expression postfixe. La mémoire est une table de symboles: les variables sont rangées par ordre de création dans
+   entrees et retrouvées par adressage ouvert (sondage linéaire) dans indices, qui contient 1 + leur position (0: case
+   libre). Chaque nom est copié une seule fois, à la création de sa variable, avec son empreinte: une recherche ne compare
+   les noms que si les empreintes sont égales. L'index valeurs retrouve de même, par l'empreinte des chiffres, une
+   variable qui tient déjà un nombre égal (checkMem) sans parcourir toutes les variables. */
+
+/* var est une case mémoire qui contiendra la variable et le nombre auquel elles est associée, avec leurs empreintes,
+   la date (horloge de la mémoire) du dernier changement de son nombre et sa formule (:=nom), NULL pour une valeur. */
+typedef struct variable {
+    char *nom; unsigned long long empreinte; struct num *nombre; unsigned long long empreinteNombre;
+    long long modifiee; struct formule *formule;
+} variable;
+
+// Un nombre tenu par au moins une variable, et le nombre de variables qui le tiennent.
+typedef struct valeur {struct num *nombre; unsigned long long empreinte; int variables; } valeur;
+
+typedef struct memoire {
+    variable *entrees; int nombreVariables, capaciteEntrees;
+    int *indices; int capaciteIndices; // Puissance de 2, au moins deux fois le nombre de variables.
+    valeur *valeurs; int nombreValeurs, capaciteValeurs; // Puissance de 2, au moins deux fois le nombre de valeurs.
+    int baseSortie; // Base d'affichage des résultats (commande obase): 10, 16 ou 2.
+    num **historique; int debutHistorique, nombreHistorique, capaciteHistorique; // Anneau des résultats affichés.
+    long long premierHistorique; // Numéro ($n) du plus ancien résultat encore gardé.
+    long long octetsHistorique, limiteHistorique; // Octets des nombres distincts de l'historique, et leur limite (0: aucune).
+    long long horloge; int nombreFormules; // Horloge des changements de valeur, et variables qui sont des formules.
+} memoire;
 
-typedef struct memoire {struct variable *tete; } memoire;
+// Case de départ d'une empreinte dans une table de capacité puissance de 2.
+#define CASE_EMPREINTE(empreinte, capacite) ((int) (((empreinte) ^ ((empreinte) >> 32)) & (unsigned long long) ((capacite) - 1)))
 
-// var est une case mémoire qui contiendra la variable et le nombre auquel elles est associée.
+// Tableau de tranches de 9 chiffres (base 10^9), poids faible en premier. Sert de représentation de travail aux algorithmes rapides.
+#define BASE_TRANCHE 1000000000u
+#define CHIFFRES_TRANCHE 9
+#define SEUIL_KARATSUBA 32
+#define SEUIL_DIVISION 64 // En dessous (en tranches), la division reste celle de Knuth plutôt que par l'inverse.
 
-typedef struct variable {char var; struct num *nombre; struct variable *suivant; } variable;
+// Taille maximale (en chiffres) d'une factorielle. Au-delà, n! est refusé avant tout calcul.
+#define CHIFFRES_MAX_FACTORIELLE 2000000
+
+typedef struct tranches {int longueur; unsigned int *valeurs; } tranches;
 
 
 
 /* OPÉRATIONS MÉMOIRE */
 
-//Ajoute la variable dans la mémoire, et décrémente le compteur de référence.
-int affecterVal(memoire *mem, char var, num* nombre);
+// Initialise une mémoire vide. Les tables ne sont allouées qu'à la première variable.
+void initMem(memoire *mem);
+
+// Renvoie 1 si out of memory. Affecte le nombre à la variable nom (créée au besoin) et incrémente son compteur de référence.
+int affecterVal(memoire *mem, const char *nom, num* nombre);
 
 // Rétablis les valeurs du buffer dans la mémoire. S'effectue après une expression postfixe entièrement valide.
 int retablirValeurs(memoire *mem, memoire* buf);
@@ -45,8 +106,30 @@ void deleteMem(memoire *mem, num *nombre);
 // Vérifie qu'un nombre n'est pas déjà présent en mémoire.
 num* checkMem(num *nombre, memoire *mem);
 
-// Retourne un pointeur sur la variable recherchée en memoire (ou buffer) sinon NULL si absente.
-variable* rechercherVar(memoire *mem, char var);
+// Retourne un pointeur sur la variable recherchée en memoire (ou buffer) sinon NULL si absente. empreinte: empreinteNom(nom).
+variable* rechercherVar(memoire *mem, const char *nom, unsigned long long empreinte);
+
+// Empreinte (FNV-1a) d'un nom de variable.
+unsigned long long empreinteNom(const char *nom);
+
+// Empreinte (FNV-1a) du signe et des chiffres d'un nombre. Deux nombres égaux (isEqual) ont la même empreinte.
+unsigned long long empreinteNombre(num *nombre);
+
+/* Renvoie 1 si out of memory. Agrandit les tables pour que supplementaires nouvelles variables, et autant de nouveaux
+   nombres, y entrent sans autre allocation. */
+int reserverMem(memoire *mem, int supplementaires);
+
+// Crée la variable nom, dont la mémoire prend possession. La place doit avoir été réservée.
+void ajouterVariable(memoire *mem, char *nom, unsigned long long empreinte, num *nombre, unsigned long long empreinteNombre);
+
+// Remplace le nombre d'une variable. La place d'un nouveau nombre doit avoir été réservée.
+void remplacerNombre(memoire *mem, variable *var, num *nombre, unsigned long long empreinte);
+
+// Retourne la case de l'index des valeurs qui tient ce nombre (comparé par adresse), -1 s'il n'y est pas.
+int trouverValeur(memoire *mem, num *nombre, unsigned long long empreinte);
+
+// Ajoute (variables = 1) ou retire (variables = -1) une variable qui tient ce nombre dans l'index des valeurs.
+void compterValeur(memoire *mem, num *nombre, unsigned long long empreinte, int variables);
 
 
 
@@ -67,15 +150,57 @@ num* evaluerOpBin(num *nombre1, num *nombre2, char operator);
 // Retourne le nombre calculé par l'opération unaire.
 num* evaluerOpUn(memoire *buffer, memoire *mem, pile *stack, num *nombre, char *opun);
 
-// Retourne 1 si la chaîne de cractères est un literal: a,...,z et les nombres sans 0 en poids forts.
+/* Résultat de ? et len: le nombre écrit dans str, ou l'opérande s'il lui est égal. Un nombre égal déjà dans la pile ou
+   la mémoire leur appartient et n'est pas détruit. NULL si out of memory. */
+num* resultatEntier(memoire *buffer, memoire *mem, pile *stack, num *nombre, char *str);
+
+// Retourne 1 si la chaîne de cractères est un literal: un nom de variable ou un nombre sans 0 en poids forts.
 int validLiteral(char *literal);
 
-// Retourne 1 si la chaîne de cacactères est un opérateur binaire (+, -, *), 0 sinon.
+/* Retourne 1 si la chaîne est un nom de variable: une lettre ou '_', puis des lettres, chiffres ou '_', et pas un mot
+   réservé (opérateur ou commande). */
+int validNom(const char *nom);
+
+// Mots réservés, terminés par NULL: ils ne peuvent pas être des noms de variables.
+const char *motsReserves[] = {"gcd", "sqrt", "len", "head", "save", "load", "obase", NULL};
+
+// Retourne 1 si la chaîne de cacactères est un opérateur binaire (+, -, *, gcd, head), 0 sinon.
 int validOpBin(char *opbin);
 
-// Retourne 1 si la chaîne de caractères est un opérateur unaire (=a , ?) valide, 0 sinon.
+// Retourne 1 si la chaîne de caractères est un opérateur unaire (=nom , ?, !, sqrt, len) valide, 0 sinon.
 int validOpUn(char *opun);
 
+#define LIGNE_LUE 0
+#define LIGNE_DERNIERE 1 // Ligne terminée par la fin de fichier plutôt que par '\n'.
+#define LIGNE_OUT_OF_MEMORY 2 // La ligne a été consommée mais n'a pas pu être conservée.
+#define LIGNE_FIN_FICHIER 3
+
+// Lit une ligne sans son '\n' dans *ligne (à libérer). Retourne l'un des codes LIGNE_*.
+int lireLigne(FILE *entree, char **ligne);
+
+/* Évalue une ligne complète (expression postfixe ou commande) et écrit son résultat ou son message d'erreur sur sortie.
+   Les variables affectées sont conservées dans mem. Une ligne terminée par ';' est évaluée sans que son résultat soit
+   converti en décimal ni affiché. Retourne 0, 1 si out of memory, 2 si erreur de syntaxe, 4 si le calcul a été
+   interrompu ou 5 si un résultat dépasserait sa taille limite (n!). */
+int evaluerLigne(memoire *mem, char *ligne, FILE *sortie);
+
+// Mots d'une ligne découpée sur place: mots pointe dans la ligne, et seul le tableau est alloué.
+typedef struct ligneDecoupee { char **mots; int nombreMots; int exception; int silencieuse; } ligneDecoupee;
+
+/* Découpe la ligne sur place en mots séparés par un espace et retire le ';' final. exception reçoit 1 si out of memory,
+   ou 2 au premier mot vide (espace initial, final ou double): seuls les mots qui le précèdent sont gardés, et l'erreur
+   n'est signalée qu'après leur évaluation. mots est à libérer. */
+void decouperLigne(char *ligne, ligneDecoupee *decoupee);
+
+// Évalue les mots d'une ligne découpée, avec les mêmes retours et le même affichage qu'evaluerLigne.
+int evaluerMots(memoire *mem, ligneDecoupee *decoupee, FILE *sortie);
+
+// Écrit le message d'une erreur (1: out of memory, 2: syntaxe, 3: fichier, 4: calcul interrompu, 5: limite). Rien pour 0.
+void afficherErreur(FILE *sortie, int exception);
+
+// --quiet-assign: le résultat d'une ligne qui se termine par une affectation (=x) n'est pas affiché, comme avec ';'.
+int affectationsSilencieuses = 0;
+
 
 /* OPÉRATIONS AVEC LES NOMBRES */
 
@@ -85,20 +210,277 @@ num* addition(num *nombre1, num *nombre2);
 // Renvoie le résultat de la soustraction d'un nombre1 avec un nombre2. Peut faire appel à l'addition.
 num* soustraction(num *nombre1,num *nombre2);
 
-// Renvoie le résultat de la multiplication d'un nombre1 avec un nombre2. Fait appel à des additions successives.
+// Renvoie le résultat de la multiplication d'un nombre1 avec un nombre2, calculée sur les tranches.
 num* multiplication(num *nombre1,num *nombre2);
 
+// Renvoie le plus grand commun diviseur (toujours positif) des valeurs absolues de nombre1 et nombre2. Algorithme de Lehmer.
+num* pgcd(num *nombre1, num *nombre2);
+
+/* Renvoie la factorielle d'un nombre positif, calculée par découpage binaire du produit 1 * 2 * ... * n.
+   Renvoie NULL si out of memory ou si le résultat estimé dépasse CHIFFRES_MAX_FACTORIELLE chiffres. */
+num* factorielle(num *nombre);
+
+/* Renvoie 1 si la factorielle du nombre (positif) dépasserait CHIFFRES_MAX_FACTORIELLE chiffres, estimation faite avec
+   lgamma avant tout calcul. Sinon renvoie 0 et n reçoit la valeur du nombre. */
+int limiteFactorielle(num *nombre, unsigned int *n);
+
+// Renvoie la racine carrée entière (partie entière de la racine) d'un nombre positif, NULL si out of memory.
+num* racineCarree(num *nombre);
+
+/* Renvoie les k premiers chiffres (poids forts) d'un nombre, avec son signe: le nombre entier si k dépasse sa longueur,
+   0 si k vaut 0. k doit être positif. Seules les k cellules gardées sont recopiées. NULL si out of memory. */
+num* tete(num *nombre, num *k);
+
 // Permet d'enlever les poids les plus forts qui ont la valeur 0
 void enleverPoidsForts0(num *nombre);
 
 
+/* OPÉRATIONS SUR LES TRANCHES
+   Pour les opérations coûteuses (pgcd, ...), un nombre est converti en tableau de tranches de 9 chiffres (base 10^9),
+   de la tranche de poids le plus faible à celle de poids le plus fort. La conversion est linéaire dans les deux sens. */
+
+// Renvoie 1 si out of memory. Alloue un tableau de tranches initialisées à 0.
+int allouerTranches(tranches *t, int longueur);
+
+// Libère les valeurs d'un tableau de tranches.
+void libererTranches(tranches *t);
+
+// Enlève les tranches de poids fort qui valent 0.
+void normaliserTranches(tranches *t);
+
+// Renvoie 1 si out of memory. Convertit la valeur absolue d'un nombre en tranches.
+int numVersTranches(num *nombre, tranches *t);
+
+// Renvoie NULL si out of memory. Construit un nombre (compteurRef à 0) à partir de tranches.
+num* tranchesVersNum(tranches *t, int negatif);
+
+// Renvoie -1, 0 ou 1 selon que a < b, a == b ou a > b. Les tranches doivent être normalisées.
+int comparerTranches(tranches *a, tranches *b);
+
+// Renvoie 1 si out of memory. Division euclidienne (algorithme D de Knuth). quotient ou reste peuvent être NULL.
+int divisionTranches(tranches *a, tranches *b, tranches *quotient, tranches *reste);
+
+/* Renvoie 1 si out of memory. inverse reçoit (B^2k - 1) / d (quotient entier) pour d normalisé de k tranches. L'inverse
+   des tranches de poids fort de d, calculé récursivement, est affiné par une itération de Newton qui double sa
+   précision: le coût total est celui de quelques multiplications de k tranches. */
+int inverseTranches(tranches *d, tranches *inverse);
+
+/* Renvoie 1 si out of memory. quotient reçoit a / b (b non nul et normalisé). Au-delà de SEUIL_DIVISION tranches, le
+   quotient est le produit de a par l'inverse de b, à une ou deux unités près, puis corrigé sur le reste. */
+int quotientTranches(tranches *a, tranches *b, tranches *quotient);
+
+// Renvoie 1 si out of memory. Multiplie deux tableaux de tranches (Karatsuba au-delà de SEUIL_KARATSUBA tranches).
+int multiplicationTranches(tranches *a, tranches *b, tranches *resultat);
+
+// Renvoie 1 si out of memory. resultat (na + nb tranches) reçoit a * b, quelles que soient les longueurs.
+int multiplicationTableaux(unsigned int *a, int na, unsigned int *b, int nb, unsigned int *resultat);
+
+// Renvoie 1 si out of memory. resultat (2n tranches) reçoit a * b pour deux tableaux de même longueur n.
+int karatsuba(unsigned int *a, unsigned int *b, int n, unsigned int *resultat);
+
+// Multiplication scolaire. resultat (na + nb tranches) doit être initialisé à 0.
+void multiplicationBasique(unsigned int *a, int na, unsigned int *b, int nb, unsigned int *resultat);
+
+// Ajoute a (na tranches) à r (nr >= na tranches). Renvoie la retenue sortante.
+unsigned int ajouterTableau(unsigned int *r, int nr, unsigned int *a, int na);
+
+// Soustrait a (na tranches) à r (nr >= na tranches). Renvoie l'emprunt sortant.
+unsigned int soustraireTableau(unsigned int *r, int nr, unsigned int *a, int na);
+
+// Renvoie 1 si out of memory. resultat reçoit le produit debut * (debut + 1) * ... * fin par découpage binaire.
+int produitIntervalle(unsigned int debut, unsigned int fin, tranches *resultat);
+
+/* Renvoie 1 si out of memory. racine reçoit la partie entière de la racine carrée de n (normalisé) par la méthode de Newton.
+   L'estimation de départ vient de la racine des tranches de poids fort, ce qui double la précision à chaque niveau, et
+   chaque itération divise par l'inverse (quotientTranches): le tout coûte quelques multiplications de n. */
+int racineTranches(tranches *n, tranches *racine);
+
+
+/* BASES 2 ET 16 (littéraux 0x... et 0b..., commande obase)
+   Les chiffres hexadécimaux ou binaires correspondent directement aux mots de 32 bits d'un tableau en base 2^32 (qui
+   réutilise la structure tranches). Le passage entre base 2^32 et base 10^9 se fait par découpage: la moitié haute est
+   convertie puis multipliée (Karatsuba) par la puissance de la base d'origine qui correspond à la moitié basse, à
+   laquelle on l'ajoute. Les puissances sont obtenues par élévations au carré successives. Sous SEUIL_CONVERSION mots ou
+   tranches, la conversion est faite par la méthode de Horner. */
+
+#define SEUIL_CONVERSION 32
+
+// Renvoie 1 si out of memory. Convertit des tranches en mots de 32 bits (versMots) ou des mots en tranches.
+int changerBase(tranches *source, int versMots, tranches *resultat);
+
+// Conversion récursive de n valeurs. puissances[j] vaut la base d'origine puissance 2^j, exprimée dans la base d'arrivée.
+int convertirBase(unsigned int *valeurs, int n, tranches *puissances, int versMots, tranches *resultat);
+
+// Renvoie 1 si out of memory. Produit de deux tableaux de mots de 32 bits (Karatsuba au-delà de SEUIL_KARATSUBA mots).
+int multiplicationMots(tranches *a, tranches *b, tranches *resultat);
+
+// Renvoie 1 si out of memory. resultat (na + nb mots) reçoit a * b, quelles que soient les longueurs.
+int multiplicationTableauxMots(unsigned int *a, int na, unsigned int *b, int nb, unsigned int *resultat);
+
+// Renvoie 1 si out of memory. resultat (2n mots) reçoit a * b pour deux tableaux de même longueur n.
+int karatsubaMots(unsigned int *a, unsigned int *b, int n, unsigned int *resultat);
+
+// Multiplication scolaire en base 2^32. resultat (na + nb mots) doit être initialisé à 0.
+void multiplicationBasiqueMots(unsigned int *a, int na, unsigned int *b, int nb, unsigned int *resultat);
+
+// Ajoute a (na mots) à r (nr >= na mots). Renvoie la retenue sortante.
+unsigned int ajouterMots(unsigned int *r, int nr, unsigned int *a, int na);
+
+// Soustrait a (na mots) à r (nr >= na mots). Renvoie l'emprunt sortant.
+unsigned int soustraireMots(unsigned int *r, int nr, unsigned int *a, int na);
+
+// Retourne 1 si la chaîne est un littéral 0x suivi de chiffres hexadécimaux, ou 0b suivi de chiffres binaires.
+int validLiteralBinaire(char *literal);
+
+// Renvoie 1 si out of memory. Donne à nombre (sans chiffres) la valeur d'un littéral 0x... ou 0b... valide.
+int literalBinaire(char *literal, num *nombre);
+
+// Renvoie 1 si out of memory. Écrit le nombre dans la base donnée (10, 16 avec le préfixe 0x, 2 avec le préfixe 0b).
+int afficherNombre(FILE *sortie, num *nombre, int base);
+
+
+/* CALCUL PARALLÈLE
+   Un groupe de threads (--threads=N, par défaut le nombre de cœurs) exécute les tâches soumises par les noyaux sur
+   les tranches. Le thread qui attend une tâche exécute lui-même celles qui sont en file: les tâches peuvent ainsi
+   en soumettre d'autres (Karatsuba dans Karatsuba) sans bloquer le groupe. Sous SEUIL_PARALLELE tranches, les
+   noyaux restent séquentiels. */
+
+#define SEUIL_PARALLELE 2048
+#define THREADS_MAX 256
+#define TACHE_EN_FILE 0
+#define TACHE_EN_COURS 1
+#define TACHE_FINIE 2
+
+// echeance: celle de la ligne qui a soumis la tâche (voir calculInterrompu), donnée par soumettreTache.
+typedef struct tache {void (*fonction)(void *argument); void *argument; int etat; struct tache *suivante; long long echeance; } tache;
+
+typedef struct groupeCalcul {
+    pthread_mutex_t verrou; pthread_cond_t travail, fini;
+    tache *tete; // Pile des tâches en file: la dernière soumise, la plus petite en général, part en premier.
+    atomic_int voulus; int lances; pthread_t threads[THREADS_MAX];
+} groupeCalcul;
+
+groupeCalcul groupe = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0, 0, {0}};
+
+// Fixe le nombre de threads de calcul, thread appelant compris (1: séquentiel, 0: nombre de cœurs).
+void definirThreads(int nombre);
+
+// Nombre de threads de calcul en vigueur.
+int threadsCalcul(void);
+
+// Met la tâche en file, ou l'exécute aussitôt si le calcul est séquentiel.
+void soumettreTache(tache *t);
+
+// Attend la fin de la tâche en exécutant les tâches en file.
+void attendreTache(tache *t);
+
+// Boucle d'un thread de calcul.
+void* threadCalcul(void *argument);
+
+// Sous-produit de Karatsuba exécuté comme tâche.
+typedef struct argumentsKaratsuba {unsigned int *a, *b, *resultat; int n, erreur; } argumentsKaratsuba;
+
+void karatsubaTache(void *argument);
+
+/* Addition et soustraction par blocs, au-delà de SEUIL_ADDITION_PARALLELE tranches. Chaque bloc est sommé en parallèle
+   avec une retenue entrante nulle; on en retient la retenue sortante (genere) et si une retenue entrante la traverserait
+   (propage: bloc de 999999999, ou de 0 pour la soustraction), ce qui donne sa retenue sortante sous les deux hypothèses.
+   Un balayage des blocs fixe ensuite les retenues entrantes et les blocs qui en reçoivent une sont corrigés en
+   parallèle. Le résultat est le même que celui de la boucle séquentielle. */
+
+#define SEUIL_ADDITION_PARALLELE 16384
+#define BLOCS_PAR_THREAD 4
+
+typedef struct argumentsBloc {unsigned int *a, *b, *resultat; int debut, fin, nb, soustraire, genere, propage; } argumentsBloc;
+
+// Renvoie NULL si out of memory. |nombre1| + |nombre2|, ou |nombre1| - |nombre2| si soustraire (|nombre1| >= |nombre2|).
+num* additionParallele(num *nombre1, num *nombre2, int soustraire, int negatif);
+
+// Somme (ou différence) d'un bloc avec une retenue entrante nulle, exécutée comme tâche.
+void blocTache(void *argument);
+
+// Ajoute (ou retire) au bloc la retenue entrante, exécuté comme tâche.
+void correctionBlocTache(void *argument);
+
+/* ARBRES D'EXPRESSION (--parallel-expr)
+   Avec --parallel-expr, une ligne dont plusieurs sous-expressions coûteuses ne dépendent pas les unes des autres
+   ("A B * C D * *") est d'abord transformée en arbre: une feuille par nombre lu, un noeud par opération. Les
+   sous-arbres indépendants sont calculés par le groupe de threads, la tâche qui attend exécutant celles qui sont en
+   file: un sous-arbre n'est confié à une tâche que si son coût estimé, d'après le nombre de chiffres des opérandes,
+   dépasse SEUIL_ARBRE, et le plus coûteux des deux reste au thread qui le rencontre. Une variable affectée dans la
+   ligne (=x) puis relue est un noeud partagé: les noeuds partagés sont calculés en premier, dans l'ordre de la ligne,
+   et ne sont plus ensuite que lus. La ligne est enfin évaluée comme d'habitude, mot par mot, chaque opération prenant
+   le résultat déjà calculé pour elle: affectations, historique, erreurs et messages sont ceux de l'évaluation
+   séquentielle. Une opération dont le calcul a échoué (opérande négatif, out of memory) est refaite à son tour. */
+
+#define SEUIL_ARBRE 1e7 // Coût estimé (opérations sur les chiffres) au-delà duquel un sous-arbre devient une tâche.
+
+/* Une feuille (operateur 0: nombre lu, qui appartient à l'arbre si son compteur est à 0) ou une opération ('g' pgcd,
+   'h' head, 's' sqrt, 'l' len). Le sous-arbre d'un noeud occupe les indices debut à lui-même, hors noeuds partagés
+   qu'il relit. fourche: il contient une opération dont les deux opérandes sont coûteux. */
+typedef struct noeudArbre {
+    char operateur; int gauche, droite, debut, mot, utilisations, fait, fourche;
+    num *valeur; double chiffres, cout; // Chiffres estimés de la valeur, coût estimé du sous-arbre.
+} noeudArbre;
+
+typedef struct arbre { noeudArbre *noeuds; int nombreNoeuds, *racines, nombreRacines; } arbre;
+
+typedef struct tacheArbre { arbre *a; int noeud; } tacheArbre;
+
+// --parallel-expr: les sous-expressions indépendantes d'une ligne sont calculées en parallèle.
+int expressionsParalleles = 0;
+
+// Résultat calculé d'avance pour l'opération en cours d'évaluation, NULL sinon. Propre au thread qui évalue la ligne.
+_Thread_local num *resultatPrecalcule = NULL;
+
+/* Renvoie NULL s'il n'y a rien à gagner (moins de deux sous-expressions coûteuses indépendantes), si la ligne ne s'y
+   prête pas (commande, ?, formule à réévaluer, erreur) ou si out of memory: la ligne est alors évaluée comme
+   d'habitude. Sinon, renvoie un tableau d'un résultat par mot (NULL pour les mots sans résultat calculé d'avance), à
+   libérer avec libererPrecalcules. */
+num** precalculerLigne(memoire *mem, char **mots, int nombreMots);
+
+// Détruit les résultats qui n'ont pas été pris par l'évaluation, puis le tableau.
+void libererPrecalcules(num **precalcules, int nombreMots);
+
+// Renvoie 1 si la ligne ne s'y prête pas ou si out of memory. Construit l'arbre des mots et estime ses coûts.
+int construireArbre(memoire *mem, char **mots, int nombreMots, arbre *a);
+
+// Calcule le sous-arbre du noeud, en confiant l'un des opérandes à une tâche s'ils sont tous deux coûteux.
+void calculerNoeud(arbre *a, int indice);
+
+// Calcule la valeur du noeud à partir de celles de ses opérandes. Erreur ou out of memory: la valeur reste NULL.
+void calculerValeur(arbre *a, int indice);
+
+// Calcul d'un noeud exécuté comme tâche.
+void noeudTache(void *argument);
+
+// Détruit les valeurs qui appartiennent encore à l'arbre, puis ses tableaux.
+void detruireArbre(arbre *a);
+
+// Prend le résultat calculé d'avance pour l'opération en cours, NULL s'il n'y en a pas.
+num* prendrePrecalcule(void);
+
+
 /* PRINT NOMBRES */
 
 // Méthode récursive afin d'imprimer un nombre du bits de poids le plus fort au plus faible (ex: 10000)
-void printRev(cell *chiffre);
+void printRev(FILE *sortie, cell *chiffre);
 
 // Imprimer un nombre avec son signe (+ ou -) et du poids le plus fort au plus faible
-void printNumReverse(num* nombre);
+void printNumReverse(FILE *sortie, num* nombre);
+
+/* Au-delà de CHIFFRES_MORCEAU chiffres, un nombre est écrit par morceaux du poids fort au poids faible, sans construire
+   sa représentation complète: un premier parcours note le début de chaque morceau (coupures aux puissances de
+   10^CHIFFRES_MORCEAU), puis chaque morceau est inversé dans un tampon et écrit dès qu'il est prêt. La mémoire en plus
+   est bornée par MORCEAUX_ECRITURE tampons et un pointeur par morceau. */
+#define CHIFFRES_MORCEAU 65536
+#define MORCEAUX_ECRITURE 4 // Morceaux envoyés par appel à writev.
+
+// Renvoie 1 si out of memory. Écrit les chiffres par morceaux, avec writev si sortie a un descripteur.
+int ecrireParMorceaux(FILE *sortie, num *nombre, int longueur);
+
+// Renvoie 1 en cas d'erreur. Écrit entièrement les vecteurs sur fd, en reprenant après une écriture partielle.
+int ecrireVecteurs(int fd, struct iovec *vecteurs, int nombre);
 
 
 /* LONGUEUR ET COMPARAISON DE NOMBRES */
@@ -162,307 +544,1221 @@ int isEmpty(pile* stack);
 num* checkPile(num* nombre, pile* stack);
 
 
+#ifdef BENCH
 
-int main(int argc, char*argv[]) {
+/* BANC D'ESSAI (compilé avec -DBENCH) */
 
-    char *mot; // Un mot que l'on veut étudier (une opérande, un opérateur ou une affection, ou un mot hors langage également).
-    pile *stack = NULL; // Pile qui va nous permettre d'évaluer l'expression postfixe.
-    memoire *buffer = NULL;
-    int c; // Un caractère que je récupère dans la console.
-    int erreur; // Permet de vérifier qu'il n'y pas eu d'erreurs dans mes appels de fonctions.
-    int debut; // Permet de marquer le début d'un nouveau mot.
-    int exception = 0;
+#define NOMBRE_NOYAUX 9
+#define CONFIGURATIONS_MAX 10 // Nombres de threads mesurés par --echelle: 1, 2, 4, ..., N.
 
-    memoire* mem = malloc(sizeof(memoire));
-    if (!mem)
-        exception = 1;
-    else
-        mem->tete = NULL;
+// Opérandes partagés par les mesures d'une même taille.
+typedef struct contexteBench {
+    num *nombre1, *nombre2, *nombreProche; char *chaine1, *chaine2;
+    memoire *mem, *buffer; pile *stack; long long puits;
+    calc_ctx *calc; calc_buffer resultat; char *ligne; size_t longueurLigne; // Noyau calc_eval_line.
+} contexteBench;
 
-    init:
+// Construit en temps linéaire le nombre décrit par une chaîne de chiffres (poids fort en premier).
+num* nombreAleatoire(char *chaine, int chiffres);
 
-    while (1) {
-        stack = malloc(sizeof(pile));
-        if (!stack)
-            exception = 1;
-        else
-            initPile(stack);
+// Renvoie 1 si out of memory. Exécute une fois le noyau mesuré.
+int executerNoyau(int noyau, contexteBench *ctx);
 
-        buffer = malloc(sizeof(memoire));
-        if (!buffer)
-            exception = 1;
-        else
-            buffer->tete = NULL;
-
-        mot = NULL;
-        char *motCpy = NULL;
-        int longueurMot = 0;
-        debut = 1;
-        printf("> ");
-        while ((c = getchar())) {
-            if (!exception && debut && c == ' ')
-                exception = 2; // Pas d'espace au début d'un mot. SYNTAXE
-            else if (c == '\n' || c == EOF) {  // À la fin de la ligne, on arrête.
-                if (!exception) {
-                    erreur = postfixeEvaluation(buffer, mem, stack, mot); // Derniere opération à effectuer puisqu'on a atteint la fin de ligne ou de fichier.
-                    if (erreur)
-                        exception = erreur; // Out of Memory ou Erreur de syntaxe
-                }
-                if (!exception && stack->length == 1) {
-                    num* val1 = pop(stack);
-                    if (val1) {
-                        // Si tout est bon, on peut actualiser les valeurs de la mémoire à partir de celles du buffer
-                        if (retablirValeurs(buffer, mem))
-                            exception = 1; // Out of memory
-                        if (!exception) {
-                            deleteMem(buffer, val1); // Destruction du buffer.
-                            buffer = NULL; // Afin d'éviter de re-désallouer le buffer en bas de la boucle, on met à NULL.
-                            printNumReverse(val1); // Impression du résultat
-                            if (!val1->compteurRef)
-                                deleteNumber(val1); // Si la veuleur popé n'est plus référencé, on peut la détruire
-                        }
-                    }
-                }
-                else if (!exception) exception = 2; // La stack n'est pas de longueur 1 à la fin, c'est qu'il y a une erreur dans l'expression postfixée.
-
-                if (!exception)
-                    printf("\n");
-                if (c == EOF)
-                    goto stop; // Fin de fichier, le programme peut s'arrêter.
-                else if (c == '\n')
-                    break; //Si fin de ligne, on reprend la boucle principale pour relire une nouvelle ligne.
-            }
+// Point d'entrée du banc d'essai, appelé par main.
+int benchmark(int argc, char *argv[]);
 
-            else if (!exception && c == ' ' && !debut) { // Un nouveau mot a été lu.
-                erreur = postfixeEvaluation(buffer, mem, stack, mot);
-                if (erreur)
-                    exception = erreur; // Out of Memory ou Erreur de syntaxe
-                if (mot)
-                    free(mot);
-                mot = NULL;
-                debut = 1;
-            }
-            else if (!exception) { // On est en train d'enregistrer un mot
-                debut = 0;
-                if (!mot) {
-                    mot = malloc(sizeof(char) + 1);
-                    if (!mot)
-                        exception = 1;
-                    else {
-                        strncpy(mot, (char *) &c, 2);
-                        longueurMot++;
-                    }
-                }
-                else {
-                    motCpy = malloc(sizeof(char)*(longueurMot + 2));
-                    if (!motCpy)
-                        exception = 1;
-                    else {
-                        strcpy(motCpy, mot);
-                        strcat(motCpy, (char *) &c);
-                        free(mot);
-                    }
-
-                    mot = malloc(sizeof(char)*(longueurMot + 2));
-                    if (!mot)
-                        exception = 1;
-                    else {
-                        strcpy(mot, motCpy);
-                        longueurMot++;
-                    }
-                    free(motCpy);
-                }
-            }
-        }
+#endif
 
-        // On attend d'avoir atteint la fin de ligne pour sortir de la boucle de getChar() afin de traiter les exceptions.
-        // En effet, si on avait pas géré l'exception de cette manière, getChar() continuerait à traiter la suite de l'expression à partir
-        // de là où l'exception a été levée.
+#ifdef ORACLE
 
-        switch (exception) {
-            case 1:
-                printf("Out of Memory. Le programme n'a plus assez de mémoire pour fonctionner normalement.\n");
-                exception = 0;
-                break;
+/* ORACLE GMP (compilé avec -DORACLE, lié avec -lgmp) */
 
-            case 2:
-                printf("Erreur de syntaxe:\n     L'expression doit être une expression postfixe\n"
-                               "     L'expression ne doit pas commencer par un espace, ni se terminer par un espace\n"
-                               "     Chaque opérande et opérateur ou affection doivent être espacés d'un espace exactement\n"
-                               "     Une variable doit être affectée pour pouvoir être utilisée.\n");
-                exception = 0;
-                break;
+#define OPERATIONS_ORACLE 11 // Binaires (+, -, *, gcd, head), unaires (!, sqrt, len, =x), littéral, variable.
+#define SEAUX_ORACLE 8 // Tailles d'opérande par puissance de 10: 1 à 9 chiffres, 10 à 99, ..., 10^7 et plus.
+#define NOMS_ORACLE 9
+#define FACTORIELLE_ORACLE 3000 // Plus grand n dont le générateur demande n!.
 
-            default:
-                break;
-        }
+// Mots et temps cumulés (en nanosecondes) d'une opération pour une taille d'opérande, dans la calculatrice et dans GMP.
+typedef struct mesureOracle { long long mots, calc, gmp; } mesureOracle;
 
-        // Enfin, après une exception ou une fin de boucle, on s'assure bien d'avoir vider la pile, le mot, et le buffer
-        // Avant de recommencer un traitement d'une nouvelle ligne.
+/* Générateur de lignes, qui les évalue aussi avec GMP mot par mot (évaluateur de référence): la pile et les variables
+   de GMP lui disent quels opérateurs sont valides (sqrt d'un nombre positif, ! d'un petit nombre). */
+typedef struct generateurOracle {
+    unsigned long long graine; long long chiffresMax; int profondeurMax;
+    mpz_t *pile; int longueur, capacite; mpz_t variables[NOMS_ORACLE]; int affectees[NOMS_ORACLE];
+    char *mot; // Mot en cours de génération: chiffresMax chiffres, ou quelques milliers de bits d'un littéral 0b.
+    long long *durees; int nombreMots, capaciteMots; // Temps de GMP pour chaque mot de la ligne.
+} generateurOracle;
 
-        if (mot) free(mot);
-        if (stack) deletePile(stack);
-        if (buffer) deleteMem(buffer, NULL);
-        goto init;
-    }
+// Nombre pseudo-aléatoire (splitmix64): la même graine donne les mêmes lignes sur toutes les machines.
+unsigned long long aleatoireOracle(unsigned long long *graine);
 
-    // Étiquette de fin du programme. On détruit toutes les cases mémoires possiblement allouées.
-    stop:
-    if (mot) free(mot);
-    if (buffer) deleteMem(buffer, NULL);
-    if (stack) deletePile(stack);
-    if (mem) deleteMem(mem, NULL);
+// Catégorie d'un mot de ligne générée (indice dans nomsOperationsOracle).
+int operationOracle(const char *mot);
 
-    return 0;
-}
+// Seau de taille d'un opérande de chiffres chiffres.
+int seauOracle(long long chiffres);
 
-num* transformationStructure(memoire* buffer, memoire* mem, pile * stack, char *str) {
-    int longueurChaine = (int) strlen(str);
-    num* nombre = malloc(sizeof(num));
-    if (!nombre)
-        return nombre;
+// Nombre exact de chiffres décimaux de la valeur absolue de x (1 pour 0).
+size_t chiffresGmp(mpz_t x);
 
-    nombre->compteurRef = 0;
-    nombre->negatif = 0;
-    nombre->chiffres = NULL;
-    if (!(longueurChaine == 1 && str[0] == '0')) { // Prendre en compte le cas 0 pour le mémoire
-        int i;
-        for(i = longueurChaine - 1; i >= 0; i--){
-            if (addTailNum(nombre, str[i])) {
-                deleteNumber(nombre);
-                return NULL;
-            }
-        }
-    }
-    num* num1 = checkPile(nombre, stack); // et surtout checkMemoire;
-    num* num2 = checkMem(nombre, mem);
-    num* num3 = checkMem(nombre, buffer);
-    if (num1) {
-        deleteNumber(nombre);
-        return num1;
-    }
-    if (num2) {
-        deleteNumber(nombre);
-        return num2;
-    }
-    if (num3) {
-        deleteNumber(nombre);
-        return num3;
-    }
-    return nombre;
-}
+// Renvoie 2 si le mot est invalide pour la pile de GMP. Évalue un mot avec GMP et mesure son temps.
+int appliquerGmp(generateurOracle *gen, const char *mot);
 
-int postfixeEvaluation(memoire *buffer, memoire* mem, pile* stack, char* mot) {
+// Écrit dans gen->mot un opérande aléatoire: littéral décimal, 0x ou 0b de taille log-uniforme, ou variable affectée.
+void genererOperande(generateurOracle *gen);
 
-    if (validLiteral(mot)) {
+// Renvoie 2 si le mot est invalide. Ajoute le mot à la ligne et l'évalue avec GMP.
+int emettreMot(generateurOracle *gen, FILE *ligne, const char *mot);
 
-        if (mot[0] >= 'a' && *mot <= 'z') {
-            int erreur;
-            variable *ptr = rechercherVar(mem, *mot);
-            variable *ptrBuf = rechercherVar(buffer, *mot);
-            if (!ptr && !ptrBuf)
-                return 2; // Buf et memoire vide. Cette variable n'a pas été affectée.
-            else
-                erreur = ptrBuf ? push(stack, ptrBuf->nombre) : push(stack, ptr->nombre); // On va chercher en priorité la valeur contenue dans le buffer qui est la plus actuelle.
-            // si elle n'est pas présente dans le buffer, on push le pointeur de nombre de la variable contenu en memoire.
+/* Renvoie 1 si out of memory. Écrit dans ligne une ligne aléatoire valide et dans attendu (à libérer par (free)) son
+   résultat calculé par GMP. Les variables affectées restent connues pour les lignes suivantes. */
+int genererLigne(generateurOracle *gen, FILE *ligne, char **attendu);
 
-            if (erreur)
-                return 1; // Out of Memory
-            return 0; // Tout s'est bien passé
-        }
+/* Évalue les mots comme evaluerMots, sans historique, en mesurant chaque mot (durees) et la taille de ses opérandes
+   (seaux). Le résultat est écrit dans *texte (à libérer par (free)). Retourne 0, 1 si out of memory ou 2. */
+int evaluerOracle(memoire *mem, ligneDecoupee *decoupee, long long *durees, int *seaux, char **texte);
 
-        else {
-            num* val1 = transformationStructure(buffer, mem, stack, mot);
-            if (!val1)
-                return 1; // Out of memory, il n'y avait plus de place pour malloc dans transformationStructure;
-            if (push(stack, val1)) { // En cas d'échec, on doit détruire ce nombre si son compteur de référence est à 0, sinon on en perdrait la trace.
-                if (!val1->compteurRef)
-                    deleteNumber(val1);
-                return 1; // Out of Memory, il n'y a plus de place pour la pile.
-            }
-            return 0;
-        }
-    }
-    else if(validOpBin(mot)) {
-        num *val2 = pop(stack);// Destack val1
-        num *val1 = pop(stack);// Destack val2
+// Point d'entrée de l'oracle, appelé par main.
+int oracle(int argc, char *argv[]);
 
-        if (val1 && val2) {
-            num *resultat = evaluerOpBin(val1, val2, *mot); // Evaluer l'expression
-            if (!resultat) {
-                // Le resultat est NULL, echec de l'opération. On vérifie que les valeurs ne pointent pas sur le même nombre, sinon on pourrait
-                // désalloué un même nombre deux fois. S'ils ne sont pas égaux, et que leur compteur de ref vaut 0, on peut les détruire sans soucis.
-                // De plus, il faut désallouer, car sinon risque d'objets morts en sortant de la méthode.
-                if ((isEqual(val1, val2) && !val1->compteurRef))
-                    deleteNumber(val1);
-                else if (!isEqual(val1, val2) && !val1->compteurRef && !val2->compteurRef) {
-                    deleteNumber(val1);
-                    deleteNumber(val2);
-                }
-                else if (!isEqual(val1, val2) && !val1->compteurRef && val2->compteurRef)
-                    deleteNumber(val1);
-                else if (!isEqual(val1, val2) && val1->compteurRef && !val2->compteurRef)
-                    deleteNumber(val2);
-                return 1;// Out of memory pour l'allocation dans evaluerOpBin;
-            }
+#endif
 
-            // Le résultat n'est pas NULL. On devrait donc vérifier dans la memoire (buffer et memoire principale) ainsi
-            // que la pile que ce nombre n'existe pas déjà en mémoire. S'il existe déjà, on peut détruire le résultat.
 
-            num *num1 = checkPile(resultat, stack);
-            num *num2 = checkMem(resultat, mem);
-            num *num3 = checkMem(resultat, buffer);
 
-            if (num1) {
-                deleteNumber(resultat);
-                resultat = num1;
-            }
-            else if (num2) {
-                deleteNumber(resultat);
-                resultat = num2;
-            }
-            else if (num3) {
-                deleteNumber(resultat);
-                resultat = num3;
-            }
-            else if (isEqual(val1, resultat)) {
-                deleteNumber(resultat);
-                resultat = val1;
-            }
-            else if (isEqual(val2, resultat)) {
-                deleteNumber(resultat);
-                resultat = val2;
-            }
-            else
-                resultat->compteurRef = 0;
+/* COMPTABILITÉ MÉMOIRE
+   Toutes les allocations passent par allouer/liberer (macros malloc, calloc et free), qui comptent pour chaque bloc
+   les octets que malloc lui réserve vraiment (malloc_usable_size), sans en-tête: un chiffre garde la taille d'un petit
+   bloc de malloc. On connaît ainsi à tout moment les octets utilisés, et une allocation qui dépasserait la limite
+   (--mem-max ou #mem max) échoue comme un vrai out of memory: la ligne est abandonnée et la mémoire reste intacte. */
 
-            // Si le resultat a la même valeur que val1 ou val2, on pourrait désallouer val1 ou val2  alors que resultat pointe
-            // sur le même nombre. Ainsi, afin de ne pas pas désallouer resultat, on incrémente son compteur de référence.
-            resultat->compteurRef++;
+#define MAX_ARGUMENTS 8
 
-            if ((isEqual(val1, val2) && !val1->compteurRef))
-                deleteNumber(val1);
-            else if (!isEqual(val1, val2) && !val1->compteurRef && !val2->compteurRef) {
-                deleteNumber(val1);
-                deleteNumber(val2);
-            }
-            else if (!isEqual(val1, val2) && !val1->compteurRef && val2->compteurRef)
-                deleteNumber(val1);
-            else if (!isEqual(val1, val2) && val1->compteurRef && !val2->compteurRef)
-                deleteNumber(val2);
+atomic_llong octetsUtilises;
+atomic_llong octetsMax; // 0: aucune limite
 
-            // Passé cette étape, on peut décrémenter le compteur de référence, qui sera re-incrémenter par le push dans la pile.
-            resultat->compteurRef--;
+// Renvoie NULL si out of memory ou si la limite serait dépassée.
+void* allouer(size_t taille);
 
-            if (push(stack, resultat)) {
-                if (!resultat->compteurRef)
-                    deleteNumber(resultat);
-                return 1;
-            }
-            return 0;
-        }
+// calloc comptabilisé.
+void* allouerZero(size_t nombre, size_t taille);
 
-        else {
+// Libère un bloc obtenu par allouer ou allouerZero. NULL est accepté.
+void liberer(void *ptr);
+
+// Octets comptés pour un bloc obtenu par allouer: sa taille utile chez malloc, ou sa place dans le fichier de débordement.
+long long octetsBloc(void *ptr);
+
+// Vrai pour le thread lecteur du pipeline: ses blocs ne sont pas comptés, ni soumis à la limite, avant rattacherBloc.
+_Thread_local int allocationsDetachees = 0;
+
+/* Compte un bloc alloué par un thread aux allocations détachées, au moment où il est pris en charge. Renvoie 1 si la
+   limite est dépassée: le bloc est compté quand même et doit être libéré. NULL est accepté. */
+int rattacherBloc(void *ptr);
+
+/* DÉBORDEMENT SUR DISQUE (--spill-dir, --spill-threshold)
+   Au-delà de seuil octets résidents, ou quand malloc échoue, les blocs viennent d'un fichier de débordement (créé
+   dans le dossier puis aussitôt supprimé) projeté en mémoire avec MAP_SHARED: le noyau peut alors renvoyer leurs pages
+   sur disque au lieu de manquer de mémoire, et un calcul plus grand que la RAM aboutit, lentement. Les petits blocs
+   (chiffres, nombres, noeuds de pile: TAILLE_CASE octets au plus) sont pris dans des arènes de TAILLE_ARENE octets
+   découpées en cases, allouées à la suite dans le fichier: une liste de chiffres y est donc presque contiguë et ses
+   parcours (addition, comparaison, affichage) lisent le fichier en séquence. Les grands blocs (tranches, temporaires
+   de Karatsuba, à partir de TAILLE_BLOC_DEDIE octets) ont chacun leur projection, et leur place sur le disque est
+   rendue (FALLOC_FL_PUNCH_HOLE) quand ils sont libérés. Les blocs intermédiaires restent sur malloc.
+   Toutes les projections sont placées dans une zone d'adresses réservée (PROT_NONE) à l'activation: liberer reconnaît
+   un bloc du fichier à son adresse. Les cases sont dans la première moitié de la zone et n'ont pas d'en-tête; un bloc
+   dédié, dans la seconde, commence par un en-tête (blocDedie) qui garde sa taille, celle de sa plage de pages et son
+   décalage dans le fichier. Une plage libérée reste projetée et passe dans la liste blocsLibres, où sa première page
+   garde l'en-tête: les blocs dédiés suivants la reprennent (premier qui convient, le reste étant redécoupé) avant de
+   prendre de nouvelles adresses, si bien que les temporaires de chaque multiplication n'usent pas la zone. */
+
+#define TAILLE_CASE ((size_t) 16)
+#define TAILLE_ARENE ((size_t) 64 << 20)
+#define TAILLE_BLOC_DEDIE ((size_t) 1 << 20)
+#define TAILLE_ZONE ((size_t) 1 << 42) // Espace d'adresses réservé: 2 Tio de cases, 2 Tio de blocs dédiés à la fois.
+// En-tête d'un bloc dédié, puis d'une plage libre. Ses 32 octets gardent l'alignement de malloc pour le bloc rendu.
+typedef struct blocDedie { size_t taille, longueur; long long decalage; struct blocDedie *suivant; } blocDedie;
+#define TAILLE_ENTETE sizeof(blocDedie)
+
+typedef struct debordement {
+    int actif; char *dossier; long long seuil; // seuil: octets résidents (comptés hors débordement) avant de déborder.
+    pthread_mutex_t verrou; int fd; long long fin; // Taille du fichier: les projections sont prises à la suite.
+    char *zone; size_t finCases, finBlocs; // Zone réservée, et place prise dans chacune de ses moitiés.
+    char *arene; size_t resteArene; void *casesLibres; // Arène en cours et cases rendues (chaînées par leur premier mot).
+    blocDedie *blocsLibres; int trousImpossibles; // Plages libres, et FALLOC_FL_PUNCH_HOLE refusé (déjà signalé).
+    atomic_llong octets; // Octets des blocs qui sont dans le fichier.
+} debordement;
+
+debordement disque = {0, NULL, 0, PTHREAD_MUTEX_INITIALIZER, -1, 0, NULL, 0, 0, NULL, 0, NULL, NULL, 0, 0};
+
+// Vrai si ptr vient du fichier de débordement.
+#define DANS_DEBORDEMENT(ptr) (disque.zone && (char *) (ptr) >= disque.zone && (char *) (ptr) < disque.zone + TAILLE_ZONE)
+
+// Renvoie NULL si le fichier ne peut être créé ou agrandi. Bloc pris dans le fichier de débordement.
+char* allouerDebordement(size_t taille);
+
+// Rend un bloc du fichier de débordement.
+void libererDebordement(char *ptr);
+
+// Renvoie 1 si le dossier n'est pas utilisable. Active le débordement; seuil 0: la moitié de la mémoire physique.
+int activerDebordement(char *dossier, long long seuil);
+
+
+/* INTERRUPTION DES CALCULS (Ctrl-C, --time-max, #time max)
+   Le calcul d'une ligne s'arrête sur Ctrl-C à la console, ou quand il dépasse la limite de temps par ligne. Les noyaux
+   longs (Karatsuba, division, pgcd, factorielle, racine) appellent calculInterrompu à chaque étape, et allouer toutes
+   les VERIFICATIONS_ALLOCATION allocations: un calcul arrêté échoue comme un out of memory, la ligne est abandonnée
+   avec le code 4 et, comme après toute erreur, ni les variables ni l'historique ne changent. Seuls l'évaluation des
+   mots et le recalcul des formules sont surveillés: une ligne dont le résultat est obtenu va jusqu'au bout. Les tâches
+   du groupe de threads prennent l'échéance de la ligne qui les a soumises. Hors d'un calcul, Ctrl-C arrête le
+   programme. */
+
+#define ECHEANCE_AUCUNE LLONG_MAX // Ligne surveillée sans limite de temps: seul Ctrl-C l'arrête.
+#define VERIFICATIONS_ALLOCATION 64
+
+atomic_llong tempsMax; // Limite de temps par ligne en millisecondes, 0: aucune.
+atomic_int interruptionDemandee; // Ctrl-C (ou calc_interrupt) pendant un calcul.
+atomic_int lignesEnCours; // Lignes en cours d'évaluation, tous threads confondus.
+
+// Échéance (maintenantNs) de la ligne dont ce thread fait le calcul, 0 hors de l'évaluation d'une ligne.
+_Thread_local long long echeanceCalcul = 0;
+_Thread_local int allocationsVerifiees = 0;
+
+// Renvoie 1 si le calcul en cours doit s'arrêter: Ctrl-C, ou échéance dépassée. Toujours 0 hors d'un calcul.
+int calculInterrompu(void);
+
+// Début de l'évaluation d'une ligne: renvoie son échéance d'après tempsMax.
+long long debutCalcul(void);
+
+// Fin de l'évaluation d'une ligne. Quand il n'y en a plus en cours, la demande d'interruption est effacée.
+void finCalcul(void);
+
+// SIGINT à la console: arrête le calcul en cours, ou le programme s'il n'y en a pas.
+void signalInterruption(int numero);
+
+// Lit une durée en secondes (décimales admises). Renvoie -1 si invalide, sinon des millisecondes.
+long long lireDuree(char *texte);
+
+// Octets occupés par un nombre: sa structure et ses chiffres, comptés comme par allouer.
+long long octetsNombre(num *nombre);
+
+// Affiche les variables (chiffres, octets, compteur de référence), la pile et le total alloué.
+void afficherMemoire(FILE *sortie, memoire *mem, pile *stack);
+
+// Lit un nombre d'octets avec suffixe optionnel K, M ou G. Renvoie -1 si invalide.
+long long lireTaille(char *texte);
+
+// Renvoie 1 si le mot, en début de ligne, est une commande (#mem, #hist, #time, save, load, obase) dont les mots suivants sont les arguments.
+int estCommande(char *mot);
+
+// Retourne 0 si tout s'est bien passé, 1 si out of memory, 2 si erreur de syntaxe, 3 si erreur de fichier.
+int executerCommande(memoire *mem, pile *stack, char *commande, char **arguments, int nombreArguments, FILE *sortie);
+
+#define malloc(taille) allouer(taille)
+#define calloc(nombre, taille) allouerZero(nombre, taille)
+#define free(ptr) liberer(ptr)
+
+
+/* HISTORIQUE DES RÉSULTATS ($1, $-1, #hist)
+   Chaque résultat affiché est gardé par référence (compteurRef), sans copie de ses chiffres, dans un anneau qui double
+   jusqu'à TAILLE_HISTORIQUE cases: $n est le n-ième résultat affiché depuis le début, $-1 le dernier, $-2
+   l'avant-dernier. Les plus anciens sont abandonnés quand l'anneau est plein ou quand les nombres distincts qu'il tient
+   dépassent limiteHistorique octets (#hist max). */
+
+#define TAILLE_HISTORIQUE 1024
+#define LIMITE_HISTORIQUE (64LL << 20)
+
+// Renvoie 1 si le mot est une référence à l'historique: '$', un '-' facultatif, puis un entier positif sans zéro initial.
+int validHistorique(char *mot);
+
+// Renvoie le résultat désigné par $n ou $-n, NULL s'il n'a jamais existé ou n'est plus gardé.
+num* resultatHistorique(memoire *mem, char *mot);
+
+// Renvoie 1 si out of memory. Agrandit l'anneau s'il est plein: ajouterHistorique ne peut plus échouer.
+int reserverHistorique(memoire *mem);
+
+/* Garde un résultat affiché (son compteur de référence est incrémenté), puis applique les limites. Le nombre n'est
+   jamais détruit ici: comme après un pop, l'appelant le détruit s'il n'est plus référencé. */
+void ajouterHistorique(memoire *mem, num *nombre);
+
+// Abandonne le plus ancien résultat gardé, et détruit son nombre s'il n'est plus référencé.
+void retirerHistorique(memoire *mem);
+
+// Nombre de cases de l'historique qui tiennent ce nombre (comparé par adresse).
+int occurrencesHistorique(memoire *mem, num *nombre);
+
+// Affiche les résultats gardés (numéro, chiffres, compteur de référence), puis le total et la limite.
+void afficherHistorique(FILE *sortie, memoire *mem);
+
+
+/* FORMULES (a b * :=c)
+   Une ligne terminée par :=nom affecte son résultat à nom, comme =nom, et garde ses mots: nom devient une formule des
+   variables qu'ils lisent. Chaque variable porte la date, à l'horloge de la mémoire, du dernier changement de son
+   nombre, et chaque formule celle de son dernier calcul. Après une ligne qui a changé une variable, les formules dont
+   une variable lue a changé depuis leur calcul sont réévaluées, chacune après les formules qu'elle lit. Une formule
+   dont la valeur ne change pas garde son nombre et sa date: celles qui la lisent ne sont pas réévaluées. Avec
+   --lazy-formulas, une formule n'est réévaluée que lorsqu'elle est lue. Une affectation ordinaire (=nom, load)
+   remplace la formule par sa valeur. */
+
+/* Mots de la formule (sans le :=nom), copiés à la suite de la structure, date de son dernier calcul et son erreur
+   (0 s'il a réussi). */
+typedef struct formule { long long calculee; int enCours, erreur, nombreMots; char **mots; } formule;
+
+// --lazy-formulas: une formule n'est réévaluée que lorsqu'elle est lue.
+int formulesDifferees = 0;
+
+// Renvoie 1 si le mot est := suivi d'un nom de variable.
+int validFormule(const char *mot);
+
+// Renvoie NULL si out of memory. Nouvelle formule, faite d'une copie des mots.
+formule* creerFormule(char **mots, int nombreMots);
+
+// Renvoie 1 si les mots lisent la variable nom, directement ou par les formules qu'ils lisent.
+int dependDe(memoire *mem, char **mots, int nombreMots, const char *nom);
+
+/* Retourne 0, 1 si out of memory ou 2 si erreur de syntaxe (sqrt d'un nombre devenu négatif...). Met à jour les
+   formules lues par celle de la variable d'indice donné, puis la réévalue si l'une de ses variables a changé depuis
+   son dernier calcul. Après une erreur de syntaxe, la variable garde son nombre mais ne peut plus être lue (même
+   erreur) jusqu'au prochain changement d'une variable de la formule. Après un out of memory, elle reste à réévaluer. */
+int actualiserFormule(memoire *mem, int indice);
+
+// Même retour, pour la première erreur. Met à jour toutes les formules de la mémoire.
+int actualiserFormules(memoire *mem);
+
+
+/* SAUVEGARDE DES VARIABLES (save, load, --load)
+   Format binaire, entiers 32 bits dans l'ordre de la machine: l'en-tête, puis chaque nombre distinct (signe, nombre de
+   tranches, tranches de 10^9 du poids faible au poids fort), puis chaque variable (longueur du nom, indice de son
+   nombre, nom complété à 4 octets). Tout est aligné sur 4 octets: au chargement, le fichier est projeté en mémoire et
+   les tranches sont lues sur place, sans repasser par le texte décimal. Les variables qui partagent un nombre le
+   partagent encore après le chargement. */
+
+#define MAGIE_SAUVEGARDE "CALCVAR1"
+
+typedef struct enteteSauvegarde {char magie[8]; unsigned int nombres, variables; unsigned long long somme; } enteteSauvegarde;
+
+// Somme de contrôle (FNV-1a par mot de 32 bits) de mots, à partir de la somme précédente.
+unsigned long long sommeControle(unsigned long long somme, const unsigned int *mots, size_t nombre);
+
+// Retourne 0, 1 si out of memory ou 3 si le fichier n'a pas pu être écrit. Le fichier est remplacé d'un coup.
+int sauverVariables(memoire *mem, const char *chemin, FILE *sortie);
+
+/* Retourne 0, 1 si out of memory ou 3 si le fichier est illisible ou invalide. Les variables chargées remplacent
+   celles de même nom; en cas d'erreur, la mémoire n'est pas modifiée. */
+int chargerVariables(memoire *mem, const char *chemin, FILE *sortie);
+
+
+/* TRACE (--trace=fichier.json)
+   Événements début/fin au format Chrome trace (chrome://tracing, Perfetto). Chaque thread accumule ses événements
+   dans son propre tampon, vidé dans le fichier entre deux lignes (ou quand il est plein). */
+
+#define TAILLE_TAMPON_TRACE 8192
+
+typedef struct evenementTrace {
+    const char *nom; const char *niveau; char phase; long long ns, chiffres1, chiffres2; char mot[24];
+} evenementTrace;
+
+typedef struct tamponTrace {int longueur; int tid; evenementTrace evenements[TAILLE_TAMPON_TRACE]; } tamponTrace;
+
+FILE *fichierTrace = NULL;
+
+// Renvoie 1 si le fichier de trace ne peut être ouvert.
+int ouvrirTrace(const char *chemin);
+
+// Ajoute un événement au tampon du thread. chiffres1, chiffres2 < 0 et niveau, mot NULL sont omis.
+void tracer(const char *nom, char phase, long long chiffres1, long long chiffres2, const char *niveau, const char *mot);
+
+// Écrit les événements du tampon du thread dans le fichier de trace.
+void viderTrace(void);
+
+// Vide le tampon et termine le fichier de trace.
+void fermerTrace(void);
+
+// Niveau de noyau utilisé par un opérateur sur des opérandes de chiffres1 et chiffres2 chiffres (-1: unaire), pour la trace.
+const char* niveauNoyau(char *mot, int chiffres1, int chiffres2);
+
+#define TRACE_DEBUT(nom, chiffres1, chiffres2, niveau, mot) do { if (fichierTrace) tracer(nom, 'B', chiffres1, chiffres2, niveau, mot); } while (0)
+#define TRACE_FIN(nom) do { if (fichierTrace) tracer(nom, 'E', -1, -1, NULL, NULL); } while (0)
+
+
+#ifdef STATS
+
+/* STATISTIQUES (compilées avec -DSTATS, activées par --stats)
+   Par opérateur: nombre d'appels, distribution de la taille des opérandes, histogramme des latences
+   et allocations. Les compteurs sont atomiques: les threads de calcul et les sessions du serveur les incrémentent en
+   même temps. Sans -DSTATS, les macros ci-dessous ne produisent aucun code. */
+
+#define NOMBRE_CATEGORIES 12
+#define SOUS_SEAUX 8 // Histogramme à la HDR: 8 sous-seaux par puissance de 2, soit une précision de 12,5 %.
+#define SEAUX_LATENCE (62 * SOUS_SEAUX)
+#define SEAUX_TAILLE 12 // Tailles d'opérandes par puissance de 10 (1-9 chiffres, 10-99, ...).
+
+typedef struct statsOperateur {
+    atomic_ullong appels, nanosecondes, latenceMax, allocations, octets;
+    atomic_ullong latence[SEAUX_LATENCE]; atomic_ullong taille[SEAUX_TAILLE];
+} statsOperateur;
+
+typedef struct statistiques {
+    int actives; atomic_ullong allocations, octets;
+    atomic_ullong recherchesPile, trouvesPile, recherchesMem, trouvesMem;
+    statsOperateur operateurs[NOMBRE_CATEGORIES];
+} statistiques;
+
+statistiques stats;
+
+// Renvoie la catégorie d'un mot (+, -, *, gcd, !, sqrt, ?, =x, littéral, variable, len, head).
+int categorieStats(char *mot);
+
+// Évalue un mot avec postfixeEvaluation et enregistre sa mesure.
+int postfixeEvaluationMesuree(memoire *buffer, memoire *mem, pile *stack, char *mot);
+
+// Écrit les statistiques sur la sortie d'erreur. N'utilise que write: peut être appelée depuis un signal.
+void afficherStats(void);
+
+// Gestionnaire de SIGUSR1.
+void signalStats(int signal);
+
+#define POSTFIXE_EVALUATION(buffer, mem, stack, mot) (stats.actives ? postfixeEvaluationMesuree(buffer, mem, stack, mot) : postfixeEvaluation(buffer, mem, stack, mot))
+#define STATS_AJOUTER(compteur, valeur) ((void) atomic_fetch_add_explicit(&(compteur), (valeur), memory_order_relaxed))
+#define STATS_COMPTER(compteur) (stats.actives ? STATS_AJOUTER(compteur, 1) : (void) 0)
+
+#else
+
+#define POSTFIXE_EVALUATION(buffer, mem, stack, mot) postfixeEvaluation(buffer, mem, stack, mot)
+#define STATS_COMPTER(compteur) ((void) 0)
+
+#endif
+
+/* BIBLIOTHÈQUE (calc.h, compilée avec -DLIBCALC)
+   Un contexte regroupe la mémoire des variables et un FILE dont les écritures vont dans le tampon de l'appel en cours:
+   evaluerLigne et les commandes écrivent ainsi le résultat directement dans le calc_buffer de l'appelant.
+   calc_eval_line_file leur passe plutôt le FILE de l'appelant (stdout pour la console). */
+
+struct calc_ctx {
+    memoire *mem; FILE *sortie; calc_buffer *courant;
+    char *ligne; size_t capaciteLigne; // Copie terminée par '\0' de la ligne évaluée, réutilisée d'un appel à l'autre.
+};
+
+// Fonction d'écriture du FILE d'un contexte. Renvoie 0 si out of memory.
+ssize_t ecrireContexte(void *cookie, const char *donnees, size_t taille);
+
+// Renvoie 1 si out of memory. Copie la ligne (len octets) dans ctx->ligne, terminée par '\0', pour evaluerLigne.
+int copierLigne(calc_ctx *ctx, const char *buf, size_t len);
+
+
+// Horloge monotone en nanosecondes.
+long long maintenantNs(void);
+
+// Comparaison de durées pour qsort.
+int comparerDurees(const void *a, const void *b);
+
+
+#ifndef LIBCALC
+
+/* PIPELINE (--pipeline, entrée redirigée)
+   Avec --pipeline et une entrée qui n'est pas un terminal, la console travaille sur trois threads: le lecteur lit et
+   découpe les lignes, le thread principal les évalue, et l'écrivain envoie le texte produit sur stdout. Ils
+   communiquent par deux files SPSC (un producteur, un consommateur) bornées et sans verrou. Les morceaux de sortie
+   sont TAILLE_FILE tampons fixes qui circulent entre une file de morceaux pleins et une file de morceaux libres: la
+   mémoire en transit reste bornée et un grand résultat part par morceaux pendant que le suivant est calculé. L'ordre
+   des lignes, des invites et des messages est celui de la console séquentielle. Ce n'est pas le mode par défaut: dès
+   qu'un second thread existe, malloc et stdio prennent leurs verrous, ce qui coûte plus, sur des lignes courtes, que
+   le recouvrement ne gagne. */
+
+#define TAILLE_FILE 64 // Cases d'une file, puissance de 2
+#define TAILLE_MORCEAU_SORTIE 65536
+#define ESSAIS_ACTIFS 256 // Lectures de l'indice attendu avant de s'endormir.
+
+/* File SPSC de TAILLE_FILE éléments de tailleElement octets. tete: prochaine case lue, queue: prochaine case écrite.
+   Les indices ne font que croître. Le verrou et la condition ne servent qu'à dormir quand la file est vide ou pleine:
+   enAttente compte les threads endormis, et un dépôt ou un retrait ne prend le verrou que s'il y en a. */
+typedef struct fileSPSC {
+    char *cases; size_t tailleElement; atomic_size_t tete, queue;
+    atomic_int enAttente; pthread_mutex_t verrou; pthread_cond_t reveil;
+} fileSPSC;
+
+// Une ligne lue d'avance: son code LIGNE_*, et ses mots découpés si elle a été lue.
+typedef struct ligneLue { int lecture; char *ligne; ligneDecoupee decoupee; } ligneLue;
+
+typedef struct morceauSortie { size_t longueur; char donnees[TAILLE_MORCEAU_SORTIE]; } morceauSortie;
+
+// Le FILE du thread d'évaluation remplit le morceau courant, pris dans libres et publié dans pleins.
+typedef struct sortiePipeline { fileSPSC *pleins, *libres; morceauSortie *courant; } sortiePipeline;
+
+// --pipeline: l'entrée redirigée est lue, évaluée et écrite par trois threads.
+int pipelineActif = 0;
+
+/* Renvoie 1 si le pipeline n'a pas pu démarrer (rien n'a été lu: la console séquentielle prend le relais). Évalue
+   toute l'entrée standard dans mem, comme la boucle de la console. */
+int pipeline(memoire *mem);
+
+void initFile(fileSPSC *file, void *cases, size_t tailleElement);
+
+void detruireFile(fileSPSC *file);
+
+/* Copie un élément dans la file. Si elle est pleine, attend qu'elle soit à moitié vide: le producteur n'est pas
+   réveillé à chaque case libérée. */
+void deposerFile(fileSPSC *file, const void *element);
+
+// Copie dans element le plus ancien élément de la file, en attendant s'il n'y en a pas.
+void retirerFile(fileSPSC *file, void *element);
+
+int fileVide(fileSPSC *file);
+
+// Attend que l'indice atteigne seuil: attente active pendant ESSAIS_ACTIFS lectures, puis sommeil sur la condition.
+void attendreFile(fileSPSC *file, atomic_size_t *indice, size_t seuil);
+
+// Réveille les threads endormis sur la file.
+void reveillerFile(fileSPSC *file);
+
+// Thread lecteur: lit et découpe les lignes de stdin jusqu'à la fin de fichier.
+void* threadLecteur(void *argument);
+
+// Thread écrivain: écrit les morceaux pleins sur stdout et les rend à la file des libres, jusqu'au morceau NULL.
+void* threadEcrivain(void *argument);
+
+// Fonction d'écriture du FILE du thread d'évaluation. Copie les données dans les morceaux.
+ssize_t ecrirePipeline(void *cookie, const char *donnees, size_t taille);
+
+// Publie le morceau courant, même incomplet. Le FILE doit avoir été vidé (fflush) avant.
+void publierSortie(sortiePipeline *sortie);
+
+/* LOTS (--batch, entrée redirigée)
+   Avec --batch, l'entrée redirigée est lue par lots de TAILLE_LOT lignes. Une ligne faite seulement de littéraux
+   décimaux et de +, - ou * (terminée ou non par ';') est classée selon sa forme: ses mots, chaque littéral remplacé par
+   'n' ("nn*n+" pour "12 34 * 5 +"). Les lignes d'une même forme sont évaluées ensemble: leurs littéraux sont rangés en
+   colonnes, une par position, et chaque opérateur est appliqué à une colonne entière, VOIES_LOT valeurs par
+   instruction. Les valeurs tiennent dans un long long: la ligne n'est retenue que si le nombre de chiffres de chaque
+   résultat intermédiaire, borné par le plus grand des deux plus un pour + et -, et par leur somme pour *, ne dépasse
+   pas CHIFFRES_LOT. Les autres lignes (variables, historique, commandes, grands nombres, erreurs) passent par
+   evaluerLigne, à leur place: l'affichage et l'historique sont ceux de la console. Un résultat du lot ne devient un
+   nombre que lorsqu'une ligne ordinaire pourrait le lire par $n; seuls les TAILLE_HISTORIQUE derniers le peuvent. */
+
+#define TAILLE_LOT 4096
+#define MOTS_LOT 32 // Mots au plus d'une ligne évaluée en colonnes, ';' non compris.
+#define CHIFFRES_LOT 18 // Chiffres au plus de chaque valeur: |v| < 10^18 < 2^63.
+#define FORMES_LOT 64 // Formes distinctes par lot. Au-delà, les lignes d'une forme nouvelle passent par evaluerLigne.
+#define VOIES_LOT 4
+
+typedef long long voiesLot __attribute__((vector_size(VOIES_LOT * 8)));
+
+// Une forme du lot: ses mots et ses colonnes (operandes colonnes de lignes valeurs). Le résultat finit dans la première.
+typedef struct formeLot {
+    char motif[MOTS_LOT + 1]; int operandes, lignes; long long *colonnes;
+} formeLot;
+
+// Une ligne du lot: son code LIGNE_*, sa forme (-1: evaluerLigne), son rang dans la forme et ses littéraux.
+typedef struct ligneLot {
+    char *ligne; int lecture, forme, rang, silencieuse, debut;
+} ligneLot;
+
+// Résultats du lot affichés mais pas encore gardés dans l'historique, du plus ancien au plus récent.
+typedef struct attenteLot { long long valeurs[TAILLE_HISTORIQUE]; int debut, nombre; } attenteLot;
+
+// --batch: les lignes simples de l'entrée redirigée sont évaluées en colonnes.
+int lotsActifs = 0;
+
+/* Renvoie 1 si les lots n'ont pas pu démarrer (rien n'a été lu: la console séquentielle prend le relais). Évalue
+   toute l'entrée standard dans mem, comme la boucle de la console. */
+int lots(memoire *mem);
+
+/* Renvoie le nombre de littéraux de la ligne, -1 si elle ne peut pas être évaluée en colonnes. Écrit sa forme dans
+   motif (MOTS_LOT + 1 octets) et ses littéraux dans valeurs (MOTS_LOT cases). */
+int classerLigneLot(const char *ligne, char *motif, long long *valeurs, int *silencieuse);
+
+// Évalue toutes les lignes de la forme, colonne par colonne.
+void evaluerFormeLot(formeLot *forme);
+
+// a[i] = a[i] operateur b[i] pour i < n.
+void operationLot(long long *a, const long long *b, int n, char operateur);
+
+// Écrit la valeur en décimal dans tampon (au moins 20 octets), sans '\0'. Retourne le nombre d'octets écrits.
+int ecrireEntierLot(char *tampon, long long valeur);
+
+// Met un résultat affiché en attente. Si l'attente est pleine, le plus ancien ne sera jamais lu: il est sauté.
+void attendreResultatLot(memoire *mem, attenteLot *attente, long long valeur);
+
+// Garde dans l'historique, dans l'ordre, les résultats en attente, avant une ligne ordinaire.
+void garderResultatsLot(memoire *mem, attenteLot *attente);
+
+// Renvoie 1 si out of memory. Construit le nombre de la valeur et le garde dans l'historique.
+int garderResultatLot(memoire *mem, long long valeur);
+
+/* Le prochain résultat ne sera pas gardé: l'historique est vidé et son numéro passé. Les TAILLE_HISTORIQUE résultats
+   qui le suivent avant la prochaine lecture de l'historique auraient de toute façon remplacé les résultats gardés. */
+void sauterHistorique(memoire *mem);
+
+/* SERVEUR (--serve chemin.sock)
+   Un socket Unix servi par une boucle epoll. Chaque client a sa propre session (variables et lignes en attente)
+   et le même protocole que la console: une ligne par requête, la réponse suivie de l'invite "> ". Les lignes sont
+   évaluées par un groupe de travailleurs pour que les gros calculs ne bloquent pas les autres clients; une session
+   n'a jamais plus d'une ligne en cours, ce qui garde l'ordre des réponses et des affectations. */
+
+#define TAILLE_LECTURE 65536
+#define SORTIE_MAX_EN_ATTENTE (1 << 20) // Au-delà, on attend que le client lise avant d'évaluer sa ligne suivante.
+#define ENTREE_MAX_EN_ATTENTE (1 << 20) // Au-delà, on cesse de lire une session occupée.
+#define EVENEMENTS_MAX 64
+
+typedef struct session {
+    int fd; calc_ctx *calc; unsigned int evenements; // Abonnement epoll en cours.
+    char *entree; size_t debutEntree, longueurEntree, capaciteEntree;
+    char *sortie; size_t debutSortie, longueurSortie, capaciteSortie;
+    int occupee, finEntree, perdue; // perdue: le client est parti, il n'y a plus rien à lui envoyer.
+    char *ligne; calc_buffer reponse; // Ligne confiée à un travailleur et sa réponse, vide si out of memory.
+    struct session *suivante; // Chaînage dans la file des travaux ou des réponses.
+    struct session *avant, *apres; // Liste des sessions ouvertes.
+} session;
+
+typedef struct fileTravaux {
+    pthread_mutex_t verrou; pthread_cond_t signal;
+    session *tete, *queue; // Lignes à évaluer.
+    session *faites; // Réponses à renvoyer, relevées par la boucle epoll.
+    int reveil; // eventfd qui réveille la boucle epoll quand une réponse est prête.
+    int arret;
+} fileTravaux;
+
+fileTravaux travaux = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, NULL, -1, 0};
+volatile sig_atomic_t arretServeur = 0;
+session *sessions = NULL;
+
+// Un client du générateur de charge et les latences qu'il a mesurées.
+typedef struct contexteClient {const char *chemin; const char *ligne; int requetes; int erreur; long long *latences; } contexteClient;
+
+// Retourne 1 en cas d'erreur. Sert le socket chemin avec nombreTravailleurs threads jusqu'à SIGINT ou SIGTERM.
+int serveur(const char *chemin, int nombreTravailleurs);
+
+// Boucle d'un travailleur: évalue les lignes de la file et dépose les réponses.
+void* travailleur(void *argument);
+
+// Accepte les connexions en attente et crée leurs sessions.
+void accepterClients(int epoll, int ecoute);
+
+// Lit ce que le client a envoyé. Retourne 1 si out of memory.
+int lireSession(session *s);
+
+// Confie la prochaine ligne complète de la session à un travailleur, ou la ferme si tout est terminé.
+void avancerSession(int epoll, session *s);
+
+// Ajoute des octets à la sortie de la session. Retourne 1 si out of memory.
+int ecrireSession(session *s, const char *texte, size_t longueur);
+
+// Envoie ce que le socket accepte sans bloquer. Marque la session perdue si le client est parti.
+void envoyerSession(session *s);
+
+// Ajuste l'abonnement epoll de la session (lecture, écriture) à son état.
+void abonnerSession(int epoll, session *s);
+
+// Ferme la connexion et libère la session.
+void fermerSession(session *s);
+
+// Gestionnaire de SIGINT et SIGTERM en mode serveur.
+void signalArret(int signal);
+
+/* Générateur de charge (--charge chemin.sock): clients threads en boucle fermée, chacun envoyant requetes fois ligne.
+   Affiche le débit et les percentiles de latence. Retourne 1 en cas d'erreur. */
+int generateurCharge(const char *chemin, int clients, int requetes, const char *ligne);
+
+// Boucle d'un client du générateur de charge.
+void* clientCharge(void *argument);
+
+// Lit jusqu'à l'invite "> " qui termine chaque réponse. Retourne 1 si la connexion est perdue.
+int attendreInvite(int fd);
+
+#endif
+
+
+#ifndef LIBCALC
+
+int main(int argc, char*argv[]) {
+#ifdef BENCH
+    return benchmark(argc, argv);
+#endif
+#ifdef ORACLE
+    return oracle(argc, argv);
+#endif
+
+    char *ligne = NULL; // La ligne lue dans la console, évaluée par calc_eval_line_file.
+    calc_buffer resultat = CALC_BUFFER_INIT;
+    char *cheminSocket = NULL; // Chemin du socket en mode serveur (--serve).
+    char *charge = NULL; // Chemin du socket visé par le générateur de charge (--charge).
+    char *sauvegarde = NULL; // Variables chargées au démarrage (--load).
+    char *dossierDebordement = NULL; // Dossier du fichier de débordement (--spill-dir).
+    long long seuilDebordement = 0; // Octets résidents avant de déborder (--spill-threshold), 0: la moitié de la RAM.
+    char *ligneCharge = "123456789012345678901234567890 987654321098765432109876543210 *";
+    int travailleurs = 4, clients = 8, requetes = 1000;
+    int i, lecture;
+
+    for (i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--trace=", 8)) {
+            if (ouvrirTrace(argv[i] + 8)) {
+                fprintf(stderr, "Impossible d'ouvrir le fichier de trace %s\n", argv[i] + 8);
+                return 1;
+            }
+        }
+        else if (!strncmp(argv[i], "--mem-max=", 10)) {
+            long long limite = lireTaille(argv[i] + 10);
+            if (limite < 0) {
+                fprintf(stderr, "Limite mémoire invalide: %s\n", argv[i] + 10);
+                return 1;
+            }
+            atomic_store(&octetsMax, limite);
+        }
+        else if (!strcmp(argv[i], "--stats")) {
+#ifdef STATS
+            stats.actives = 1;
+            signal(SIGUSR1, signalStats); // kill -USR1 affiche les statistiques sans arrêter le programme.
+#else
+            fprintf(stderr, "--stats: le programme doit être compilé avec -DSTATS.\n");
+#endif
+        }
+        else if (!strcmp(argv[i], "--serve") && i + 1 < argc)
+            cheminSocket = argv[++i];
+        else if (!strcmp(argv[i], "--quiet-assign"))
+            affectationsSilencieuses = 1;
+        else if (!strcmp(argv[i], "--lazy-formulas"))
+            formulesDifferees = 1;
+        else if (!strcmp(argv[i], "--pipeline"))
+            pipelineActif = 1;
+        else if (!strcmp(argv[i], "--batch"))
+            lotsActifs = 1;
+        else if (!strcmp(argv[i], "--parallel-expr"))
+            expressionsParalleles = 1;
+        else if (!strncmp(argv[i], "--time-max=", 11)) {
+            long long limite = lireDuree(argv[i] + 11);
+            if (limite < 0) {
+                fprintf(stderr, "Limite de temps invalide: %s\n", argv[i] + 11);
+                return 1;
+            }
+            atomic_store(&tempsMax, limite);
+        }
+        else if (!strncmp(argv[i], "--spill-dir=", 12))
+            dossierDebordement = argv[i] + 12;
+        else if (!strncmp(argv[i], "--spill-threshold=", 18)) {
+            if ((seuilDebordement = lireTaille(argv[i] + 18)) < 0) {
+                fprintf(stderr, "Seuil de débordement invalide: %s\n", argv[i] + 18);
+                return 1;
+            }
+        }
+        else if (!strncmp(argv[i], "--threads=", 10))
+            calc_set_threads(atoi(argv[i] + 10));
+        else if (!strncmp(argv[i], "--workers=", 10))
+            travailleurs = atoi(argv[i] + 10);
+        else if (!strcmp(argv[i], "--load") && i + 1 < argc)
+            sauvegarde = argv[++i];
+        else if (!strcmp(argv[i], "--charge") && i + 1 < argc)
+            charge = argv[++i];
+        else if (!strncmp(argv[i], "--clients=", 10))
+            clients = atoi(argv[i] + 10);
+        else if (!strncmp(argv[i], "--requetes=", 11))
+            requetes = atoi(argv[i] + 11);
+        else if (!strncmp(argv[i], "--ligne=", 8))
+            ligneCharge = argv[i] + 8;
+        else {
+            fprintf(stderr, "Option inconnue: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (dossierDebordement && activerDebordement(dossierDebordement, seuilDebordement)) {
+        fprintf(stderr, "Dossier de débordement inutilisable: %s\n", dossierDebordement);
+        return 1;
+    }
+    if (cheminSocket)
+        return serveur(cheminSocket, travailleurs > 0 ? travailleurs : 1);
+    if (charge)
+        return generateurCharge(charge, clients > 0 ? clients : 1, requetes > 0 ? requetes : 1, ligneCharge);
+
+    calc_ctx *ctx = calc_new();
+    if (!ctx) {
+        printf("Out of Memory. Le programme n'a plus assez de mémoire pour fonctionner normalement.\n");
+        return 1;
+    }
+    if (sauvegarde && calc_load(ctx, sauvegarde, &resultat)) {
+        fwrite(resultat.data, 1, resultat.len, stderr);
+        calc_buffer_free(&resultat);
+        calc_free(ctx);
+        return 1;
+    }
+    calc_buffer_clear(&resultat);
+
+    signal(SIGINT, signalInterruption); // Ctrl-C arrête le calcul en cours, et le programme à l'invite.
+
+    // --batch ou --pipeline et entrée redirigée: lignes simples évaluées en colonnes, ou lecture, évaluation et
+    // écriture en parallèle. Au terminal, l'invite précède la lecture.
+    int lue = !isatty(STDIN_FILENO) && ((lotsActifs && !lots(ctx->mem)) || (pipelineActif && !pipeline(ctx->mem)));
+    if (!lue) {
+        while (1) {
+            printf("> ");
+            lecture = lireLigne(stdin, &ligne);
+            if (lecture == LIGNE_FIN_FICHIER)
+                break; // Fin de fichier, le programme peut s'arrêter.
+            if (lecture == LIGNE_OUT_OF_MEMORY)
+                printf("Out of Memory. Le programme n'a plus assez de mémoire pour fonctionner normalement.\n");
+            else {
+                // Sur stdout plutôt que dans un calc_buffer: les grands résultats partent au fil de l'écriture.
+                calc_eval_line_file(ctx, ligne, strlen(ligne), stdout);
+                free(ligne);
+            }
+            viderTrace(); // Entre deux lignes, hors du calcul.
+            if (lecture == LIGNE_DERNIERE)
+                break; // Dernière ligne sans '\n'
+        }
+    }
+
+    // Fin du programme. On détruit toutes les cases mémoires possiblement allouées.
+    calc_buffer_free(&resultat);
+    calc_free(ctx);
+    fermerTrace();
+#ifdef STATS
+    if (stats.actives)
+        afficherStats();
+#endif
+
+    return 0;
+}
+
+#endif
+
+int lireLigne(FILE *entree, char **ligne) {
+    size_t capacite = 64, longueur = 0;
+    char *texte = malloc(capacite);
+    int c, outOfMemory = !texte;
+
+    while ((c = getc_unlocked(entree)) != EOF && c != '\n') { // Un seul thread lit l'entrée.
+        if (outOfMemory)
+            continue; // On lit quand même la ligne jusqu'au bout pour reprendre proprement à la suivante.
+        if (longueur + 1 == capacite) { // Capacité doublée: la lecture reste linéaire pour les très longs littéraux.
+            char *plusGrand = malloc(capacite * 2);
+            if (!plusGrand) {
+                outOfMemory = 1;
+                continue;
+            }
+            memcpy(plusGrand, texte, longueur);
+            free(texte);
+            texte = plusGrand;
+            capacite *= 2;
+        }
+        texte[longueur++] = (char) c;
+    }
+
+    if (outOfMemory) {
+        free(texte);
+        return c == EOF && !longueur ? LIGNE_FIN_FICHIER : LIGNE_OUT_OF_MEMORY;
+    }
+    if (c == EOF && !longueur) {
+        free(texte);
+        return LIGNE_FIN_FICHIER;
+    }
+    texte[longueur] = '\0';
+    *ligne = texte;
+    return c == EOF ? LIGNE_DERNIERE : LIGNE_LUE;
+}
+
+void afficherErreur(FILE *sortie, int exception) {
+    switch (exception) {
+        case 1:
+            fprintf(sortie, "Out of Memory. Le programme n'a plus assez de mémoire pour fonctionner normalement.\n");
+            break;
+
+        case 2:
+            fprintf(sortie, "Erreur de syntaxe:\n     L'expression doit être une expression postfixe\n"
+                            "     L'expression ne doit pas commencer par un espace, ni se terminer par un espace\n"
+                            "     Chaque opérande et opérateur ou affection doivent être espacés d'un espace exactement\n"
+                            "     Une variable doit être affectée pour pouvoir être utilisée.\n");
+            break;
+
+        case 3:
+            fprintf(sortie, "Erreur de fichier: le fichier n'a pas pu être écrit, ou n'est pas une sauvegarde valide.\n");
+            break;
+
+        case 4:
+            fprintf(sortie, "Calcul interrompu (Ctrl-C ou limite de temps). Les variables n'ont pas changé.\n");
+            break;
+
+        case 5:
+            fprintf(sortie, "Limite dépassée: n! aurait plus de %d chiffres.\n", CHIFFRES_MAX_FACTORIELLE);
+            break;
+
+        default:
+            break;
+    }
+}
+
+int evaluerLigne(memoire *mem, char *ligne, FILE *sortie) {
+    ligneDecoupee decoupee;
+    decouperLigne(ligne, &decoupee);
+    int exception = evaluerMots(mem, &decoupee, sortie);
+    free(decoupee.mots);
+    return exception;
+}
+
+void decouperLigne(char *ligne, ligneDecoupee *decoupee) {
+    char *debutMot = ligne, *finMot, *p;
+    int espaces = 0;
+
+    decoupee->mots = NULL;
+    decoupee->nombreMots = decoupee->exception = decoupee->silencieuse = 0;
+    size_t longueurLigne = strlen(ligne);
+    if (longueurLigne && ligne[longueurLigne - 1] == ';') { // "a b * =c;" ou "a b * =c ;": pas d'affichage.
+        ligne[--longueurLigne] = '\0';
+        if (longueurLigne && ligne[longueurLigne - 1] == ' ')
+            ligne[--longueurLigne] = '\0';
+        decoupee->silencieuse = 1;
+    }
+
+    TRACE_DEBUT("lecture", -1, -1, NULL, NULL);
+    for (p = ligne; *p; p++)
+        espaces += *p == ' ';
+    if (!(decoupee->mots = malloc(sizeof(char*) * (size_t) (espaces + 1)))) {
+        decoupee->exception = 1; // Out of memory
+        TRACE_FIN("lecture");
+        return;
+    }
+    // Chaque mot est suivi d'exactement un espace, sauf le dernier. Un mot vide correspond donc à un espace
+    // en début de ligne, à deux espaces consécutifs, à un espace final ou à une ligne vide.
+    while (1) {
+        finMot = strchr(debutMot, ' ');
+        if (finMot == debutMot || !*debutMot) {
+            decoupee->exception = 2; // Erreur de syntaxe, signalée après l'évaluation des mots qui précèdent.
+            break;
+        }
+        decoupee->mots[decoupee->nombreMots++] = debutMot;
+        if (!finMot)
+            break; // Fin de la ligne
+        *finMot = '\0';
+        debutMot = finMot + 1;
+    }
+    TRACE_FIN("lecture");
+}
+
+int evaluerMots(memoire *mem, ligneDecoupee *decoupee, FILE *sortie) {
+    char **mots = decoupee->mots;
+    char *commande = NULL; // Commande de la ligne (#mem): les mots suivants sont ses arguments, ils ne sont pas évalués.
+    int nombreArguments = 0, exception = decoupee->exception == 1, affectation = 0, i;
+    int dernier = decoupee->nombreMots - 1;
+    formule *nouvelle = NULL; // Formule de la ligne (a b * :=c), donnée à sa variable si la ligne réussit.
+    num **precalcules = NULL; // --parallel-expr: résultat de chaque opération, calculé avant l'évaluation.
+    long long horloge = mem->horloge, echeance = debutCalcul();
+
+    pile *stack = malloc(sizeof(pile)); // Pile qui va nous permettre d'évaluer l'expression postfixe.
+    memoire *buffer = malloc(sizeof(memoire));
+    if (!stack || !buffer)
+        exception = 1;
+    else {
+        initPile(stack);
+        initMem(buffer);
+    }
+
+    TRACE_DEBUT("ligne", -1, -1, NULL, NULL);
+    echeanceCalcul = echeance; // Les mots sont évalués sous surveillance: Ctrl-C, limite de temps.
+    if (!exception && decoupee->nombreMots && estCommande(mots[0])) {
+        commande = mots[0];
+        nombreArguments = decoupee->nombreMots - 1;
+        if (nombreArguments > MAX_ARGUMENTS)
+            exception = 2; // Trop d'arguments
+    }
+    else {
+        if (!exception && !decoupee->exception && dernier > 0 && validFormule(mots[dernier])) {
+            // Les mots seront réévalués: ni affectation, ni historique, et la variable ne doit pas se lire elle-même.
+            for (i = 0; !exception && i < dernier; i++)
+                if (mots[i][0] == '=' || mots[i][0] == '$' || mots[i][0] == ':')
+                    exception = 2;
+            if (!exception && dependDe(mem, mots, dernier, mots[dernier] + 2))
+                exception = 2; // Cycle
+            if (!exception && !(nouvelle = creerFormule(mots, dernier)))
+                exception = 1;
+        }
+        if (!exception && expressionsParalleles && !decoupee->exception)
+            precalcules = precalculerLigne(mem, mots, decoupee->nombreMots);
+        evaluationMots:
+        for (i = 0; !exception && i < decoupee->nombreMots; i++) {
+            char *mot = nouvelle && i == dernier ? mots[i] + 1 : mots[i]; // :=c est évalué comme =c.
+            if (precalcules) {
+                resultatPrecalcule = precalcules[i];
+                precalcules[i] = NULL;
+            }
+            TRACE_DEBUT("postfixeEvaluation", -1, -1, NULL, mot);
+            exception = POSTFIXE_EVALUATION(buffer, mem, stack, mot); // Out of Memory ou Erreur de syntaxe
+            TRACE_FIN("postfixeEvaluation");
+            if (resultatPrecalcule) // Non pris: l'opération a échoué avant son calcul.
+                deleteNumber(prendrePrecalcule());
+            if (exception == 1 && calculInterrompu())
+                exception = 4; // L'out of memory vient de l'interruption.
+            affectation = mot[0] == '=';
+        }
+        if (exception == 1 && precalcules) {
+            // Out of memory avec les résultats calculés d'avance, qui occupaient la mémoire: la ligne est refaite sans
+            // eux. Rien n'a encore changé hors du buffer et de la pile.
+            libererPrecalcules(precalcules, decoupee->nombreMots);
+            precalcules = NULL;
+            deletePile(stack);
+            deleteMem(buffer, NULL);
+            stack = malloc(sizeof(pile));
+            buffer = malloc(sizeof(memoire));
+            if (stack)
+                initPile(stack);
+            if (buffer)
+                initMem(buffer);
+            if (stack && buffer) {
+                exception = 0;
+                goto evaluationMots;
+            }
+        }
+    }
+    echeanceCalcul = 0; // Le résultat obtenu est enregistré et affiché sans interruption possible.
+    if (!exception)
+        exception = decoupee->exception; // Mot vide après les mots évalués
+
+    if (!exception && commande)
+        exception = executerCommande(mem, stack, commande, mots + 1, nombreArguments, sortie);
+    else if (!exception && stack->length == 1) {
+        num* val1 = pop(stack);
+        int affiche = !decoupee->silencieuse && !(affectation && affectationsSilencieuses);
+        // Si tout est bon, on peut actualiser les valeurs de la mémoire à partir de celles du buffer. La place du
+        // résultat dans l'historique est prise avant: la mémoire n'est modifiée que si rien ne peut plus échouer.
+        // Le résultat est tenu pendant ce temps: il peut être l'ancienne valeur (checkMem) d'une variable que la
+        // ligne réaffecte, que retablirValeurs détruirait sinon.
+        val1->compteurRef++;
+        TRACE_DEBUT("retablirValeurs", -1, -1, NULL, NULL);
+        if ((affiche && reserverHistorique(mem)) || retablirValeurs(buffer, mem))
+            exception = 1; // Out of memory
+        TRACE_FIN("retablirValeurs");
+        if (!exception) {
+            deleteMem(buffer, val1); // Destruction du buffer.
+            buffer = NULL; // Afin d'éviter de re-désallouer le buffer en bas, on met à NULL.
+        }
+        if (!exception && nouvelle) { // La variable vient d'être affectée: sa valeur est celle de la formule.
+            variable *var = rechercherVar(mem, mots[dernier] + 2, empreinteNom(mots[dernier] + 2));
+            var->formule = nouvelle;
+            nouvelle->calculee = mem->horloge;
+            mem->nombreFormules++;
+            nouvelle = NULL;
+        }
+        val1->compteurRef--;
+        if (!exception && affiche) {
+            TRACE_DEBUT("printNumReverse", findLenNum(val1), -1, NULL, NULL);
+            if (afficherNombre(sortie, val1, mem->baseSortie)) // Impression du résultat
+                exception = 1; // Out of memory pendant la conversion de base
+            else {
+                fprintf(sortie, "\n");
+                ajouterHistorique(mem, val1);
+            }
+            TRACE_FIN("printNumReverse");
+        }
+        if (!val1->compteurRef)
+            deleteNumber(val1); // Si la veuleur popé n'est plus référencé, on peut la détruire
+    }
+    else if (!exception)
+        exception = 2; // La stack n'est pas de longueur 1 à la fin, c'est qu'il y a une erreur dans l'expression postfixée.
+
+    // Les formules qui lisent une variable changée par la ligne. Leur erreur est affichée après le résultat.
+    if (!exception && !formulesDifferees && mem->horloge != horloge) {
+        echeanceCalcul = echeance;
+        if ((exception = actualiserFormules(mem)) == 1 && calculInterrompu())
+            exception = 4; // Les formules restent à recalculer, comme après un out of memory.
+        echeanceCalcul = 0;
+    }
+    finCalcul();
+    afficherErreur(sortie, exception);
+    if (nouvelle)
+        free(nouvelle);
+    if (precalcules)
+        libererPrecalcules(precalcules, decoupee->nombreMots);
+
+    // Enfin, après une exception ou une fin de ligne, on s'assure bien d'avoir vidé la pile et le buffer.
+    if (stack) deletePile(stack);
+    if (buffer) deleteMem(buffer, NULL);
+    TRACE_FIN("ligne");
+    return exception;
+}
+
+
+num* transformationStructure(memoire* buffer, memoire* mem, pile * stack, char *str) {
+    int longueurChaine = (int) strlen(str);
+    num* nombre = malloc(sizeof(num));
+    if (!nombre)
+        return nombre;
+
+    nombre->compteurRef = 0;
+    nombre->negatif = 0;
+    nombre->chiffres = NULL;
+    if (validLiteralBinaire(str)) { // 0x... ou 0b...: converti en chiffres décimaux, puis comparé comme les autres.
+        if (literalBinaire(str, nombre)) {
+            deleteNumber(nombre);
+            return NULL;
+        }
+    }
+    else if (!(longueurChaine == 1 && str[0] == '0')) { // Prendre en compte le cas 0 pour le mémoire
+        int i;
+        cell **queue = &nombre->chiffres; // Construction en temps linéaire, contrairement à addTailNum.
+        for(i = longueurChaine - 1; i >= 0; i--){
+            cell *nouveau_chiffre = malloc(sizeof(cell));
+            if (!nouveau_chiffre) {
+                deleteNumber(nombre);
+                return NULL;
+            }
+            nouveau_chiffre->chiffre = str[i];
+            nouveau_chiffre->suivant = NULL;
+            *queue = nouveau_chiffre;
+            queue = &nouveau_chiffre->suivant;
+        }
+    }
+    num* num1 = checkPile(nombre, stack); // et surtout checkMemoire;
+    num* num2 = checkMem(nombre, mem);
+    num* num3 = checkMem(nombre, buffer);
+    if (num1) {
+        deleteNumber(nombre);
+        return num1;
+    }
+    if (num2) {
+        deleteNumber(nombre);
+        return num2;
+    }
+    if (num3) {
+        deleteNumber(nombre);
+        return num3;
+    }
+    return nombre;
+}
+
+int postfixeEvaluation(memoire *buffer, memoire* mem, pile* stack, char* mot) {
+
+    if (validLiteral(mot)) {
+
+        if (mot[0] == '$') { // Référence à un résultat précédent: le nombre gardé est empilé tel quel.
+            num *resultat = resultatHistorique(mem, mot);
+            if (!resultat)
+                return 2; // Ce résultat n'existe pas, ou n'est plus gardé.
+            return push(stack, resultat); // 1 si out of memory
+        }
+
+        if (mot[0] < '0' || mot[0] > '9') {
+            int erreur;
+            unsigned long long empreinte = empreinteNom(mot); // Calculée une fois pour les deux recherches.
+            variable *ptr = rechercherVar(mem, mot, empreinte);
+            variable *ptrBuf = rechercherVar(buffer, mot, empreinte);
+            if (!ptr && !ptrBuf)
+                return 2; // Buf et memoire vide. Cette variable n'a pas été affectée.
+            if (!ptrBuf && ptr->formule) {
+                int indice = (int) (ptr - mem->entrees);
+                if (formulesDifferees && (erreur = actualiserFormule(mem, indice)))
+                    return erreur; // --lazy-formulas: la formule est réévaluée au moment où elle est lue.
+                ptr = &mem->entrees[indice];
+                if (ptr->formule->erreur)
+                    return ptr->formule->erreur; // Son dernier calcul a échoué: sa valeur n'est plus la bonne.
+            }
+            erreur = ptrBuf ? push(stack, ptrBuf->nombre) : push(stack, ptr->nombre); // On va chercher en priorité la valeur contenue dans le buffer qui est la plus actuelle.
+            // si elle n'est pas présente dans le buffer, on push le pointeur de nombre de la variable contenu en memoire.
+
+            if (erreur)
+                return 1; // Out of Memory
+            return 0; // Tout s'est bien passé
+        }
+
+        else {
+            num* val1 = transformationStructure(buffer, mem, stack, mot);
+            if (!val1)
+                return 1; // Out of memory, il n'y avait plus de place pour malloc dans transformationStructure;
+            if (push(stack, val1)) { // En cas d'échec, on doit détruire ce nombre si son compteur de référence est à 0, sinon on en perdrait la trace.
+                if (!val1->compteurRef)
+                    deleteNumber(val1);
+                return 1; // Out of Memory, il n'y a plus de place pour la pile.
+            }
+            return 0;
+        }
+    }
+    else if(validOpBin(mot)) {
+        num *val2 = pop(stack);// Destack val1
+        num *val1 = pop(stack);// Destack val2
+
+        if (val1 && val2 && *mot == 'h' && val2->negatif && val2->chiffres) { // head: k négatif.
+            if (!val1->compteurRef)
+                deleteNumber(val1);
+            if (val2 != val1 && !val2->compteurRef)
+                deleteNumber(val2);
+            return 2; // Erreur de syntaxe
+        }
+        if (val1 && val2) {
+            TRACE_DEBUT("evaluerOpBin", findLenNum(val1), findLenNum(val2),
+                        niveauNoyau(mot, findLenNum(val1), findLenNum(val2)), mot);
+            num *resultat = prendrePrecalcule(); // --parallel-expr: déjà calculé.
+            if (!resultat)
+                resultat = evaluerOpBin(val1, val2, *mot); // Evaluer l'expression
+            TRACE_FIN("evaluerOpBin");
+            if (!resultat) {
+                // Le resultat est NULL, echec de l'opération. On vérifie que les valeurs ne pointent pas sur le même nombre, sinon on pourrait
+                // désalloué un même nombre deux fois. S'ils ne sont pas égaux, et que leur compteur de ref vaut 0, on peut les détruire sans soucis.
+                // De plus, il faut désallouer, car sinon risque d'objets morts en sortant de la méthode.
+                if ((isEqual(val1, val2) && !val1->compteurRef))
+                    deleteNumber(val1);
+                else if (!isEqual(val1, val2) && !val1->compteurRef && !val2->compteurRef) {
+                    deleteNumber(val1);
+                    deleteNumber(val2);
+                }
+                else if (!isEqual(val1, val2) && !val1->compteurRef && val2->compteurRef)
+                    deleteNumber(val1);
+                else if (!isEqual(val1, val2) && val1->compteurRef && !val2->compteurRef)
+                    deleteNumber(val2);
+                return 1;// Out of memory pour l'allocation dans evaluerOpBin;
+            }
+
+            // Le résultat n'est pas NULL. On devrait donc vérifier dans la memoire (buffer et memoire principale) ainsi
+            // que la pile que ce nombre n'existe pas déjà en mémoire. S'il existe déjà, on peut détruire le résultat.
+
+            num *num1 = checkPile(resultat, stack);
+            num *num2 = checkMem(resultat, mem);
+            num *num3 = checkMem(resultat, buffer);
+
+            if (num1) {
+                deleteNumber(resultat);
+                resultat = num1;
+            }
+            else if (num2) {
+                deleteNumber(resultat);
+                resultat = num2;
+            }
+            else if (num3) {
+                deleteNumber(resultat);
+                resultat = num3;
+            }
+            else if (isEqual(val1, resultat)) {
+                deleteNumber(resultat);
+                resultat = val1;
+            }
+            else if (isEqual(val2, resultat)) {
+                deleteNumber(resultat);
+                resultat = val2;
+            }
+            else
+                resultat->compteurRef = 0;
+
+            // Si le resultat a la même valeur que val1 ou val2, on pourrait désallouer val1 ou val2  alors que resultat pointe
+            // sur le même nombre. Ainsi, afin de ne pas pas désallouer resultat, on incrémente son compteur de référence.
+            resultat->compteurRef++;
+
+            if ((isEqual(val1, val2) && !val1->compteurRef))
+                deleteNumber(val1);
+            else if (!isEqual(val1, val2) && !val1->compteurRef && !val2->compteurRef) {
+                deleteNumber(val1);
+                deleteNumber(val2);
+            }
+            else if (!isEqual(val1, val2) && !val1->compteurRef && val2->compteurRef)
+                deleteNumber(val1);
+            else if (!isEqual(val1, val2) && val1->compteurRef && !val2->compteurRef)
+                deleteNumber(val2);
+
+            // Passé cette étape, on peut décrémenter le compteur de référence, qui sera re-incrémenter par le push dans la pile.
+            resultat->compteurRef--;
+
+            if (push(stack, resultat)) {
+                if (!resultat->compteurRef)
+                    deleteNumber(resultat);
+                return 1;
+            }
+            return 0;
+        }
+
+        else {
             // Si on arrive dans ce cas, la pile n'a pu pop les nombres requis pour l'opération.
             // On vérifie les compteurs de références de ces nombres, et on désalloue si nécessaire.
             if (val1 && !val1->compteurRef)
@@ -473,846 +1769,5528 @@ int postfixeEvaluation(memoire *buffer, memoire* mem, pile* stack, char* mot) {
         }
     }
 
-    else if(validOpUn(mot)) {
-        num* val1 = pop(stack);// Destack val1
-        if (val1) {
-            num* resultat = evaluerOpUn(buffer, mem, stack, val1, mot);
-            if (!resultat && !val1->compteurRef) { // Cas out of memory avec resultat = NULL
-                deleteNumber(val1);
-                return 1; // Out of memory pour l'alloc dans evaluer expUn
+    else if(validOpUn(mot)) {
+        num* val1 = pop(stack);// Destack val1
+        if (val1) {
+            if (val1->negatif && val1->chiffres && (*mot == '!' || !strcmp(mot, "sqrt"))) { // Factorielle et racine: nombres positifs seulement.
+                if (!val1->compteurRef)
+                    deleteNumber(val1);
+                return 2; // Erreur de syntaxe
+            }
+            unsigned int n;
+            if (*mot == '!' && limiteFactorielle(val1, &n)) { // Refusée avant tout calcul, avec son propre message.
+                if (!val1->compteurRef)
+                    deleteNumber(val1);
+                return 5; // Limite dépassée
+            }
+            TRACE_DEBUT("evaluerOpUn", findLenNum(val1), -1, niveauNoyau(mot, findLenNum(val1), -1), mot);
+            num* resultat = evaluerOpUn(buffer, mem, stack, val1, mot);
+            TRACE_FIN("evaluerOpUn");
+            if (!resultat) { // Cas out of memory avec resultat = NULL
+                if (!val1->compteurRef)
+                    deleteNumber(val1);
+                return 1; // Out of memory pour l'alloc dans evaluer expUn
+            }
+            if (!isEqual(val1, resultat) && !val1->compteurRef)
+                deleteNumber(val1);
+            if (push(stack, resultat)) {
+                if (!resultat->compteurRef)
+                    deleteNumber(resultat);
+                return 1; // Out of Memory
+            }
+            return 0; // Tout s'est bien passé
+        }
+        return 2; // Erreur de Syntaxe: impossible de pop un opérande.
+    }
+    return 2; // Ni literral, ni binaire, ni unaire ( ?, !, sqrt, len et =a)
+}
+
+num* evaluerOpBin(num *nombre1, num *nombre2, char operator) {
+    num* resultat = malloc(sizeof(num));
+    if (!resultat)
+        return NULL;
+    num *temp = NULL;
+
+    switch(operator) {
+        case '+':
+            temp = addition(nombre1, nombre2); break;
+        case '-':
+            temp = soustraction(nombre1, nombre2); break;
+        case '*':
+            temp = multiplication(nombre1, nombre2); break;
+        case 'g':
+            temp = pgcd(nombre1, nombre2); break;
+        case 'h':
+            temp = tete(nombre1, nombre2); break;
+        default:
+            free(resultat); return NULL;
+    }
+
+    if (!temp) { // Out of memory dans l'opération: resultat n'a pas encore de chiffres.
+        free(resultat);
+        return NULL;
+    }
+    if (copyNum(temp, resultat)) {
+        if(resultat)
+            deleteNumber(resultat);
+        if (temp)
+            deleteNumber(temp);
+        return NULL;
+    }
+
+    deleteNumber(temp);
+    return resultat;
+}
+
+num* evaluerOpUn(memoire *buffer, memoire *mem, pile *stack, num *nombre, char *opun) {
+    num *resultat, *num2, *num3, *num4;
+    char str[16]; // Résultat entier de ? ou len, en décimal.
+
+    if (opun) {
+        if (opun[0] == '=') { // Affectation, quelle que soit la longueur du nom.
+            if (affecterVal(buffer, opun + 1, nombre))
+                return NULL;
+            return nombre;
+        }
+        int longueur = (int) strlen(opun);
+        switch(longueur) {
+            case 1:
+                if (opun[0] == '!') {
+                    if (!(resultat = prendrePrecalcule()))
+                        resultat = factorielle(nombre);
+                    break; // Le résultat est comparé aux nombres existants après le switch.
+                }
+                // Cas où l'on veut obtenir le compteur de référence d'un nombre.
+                sprintf(str, "%d", nombre->compteurRef);
+                return resultatEntier(buffer, mem, stack, nombre, str);
+
+            case 3: { // len: le nombre de chiffres, compté sur la liste sans la convertir. 0 s'écrit avec un chiffre.
+                int chiffres = findLenNum(nombre);
+                sprintf(str, "%d", chiffres ? chiffres : 1);
+                return resultatEntier(buffer, mem, stack, nombre, str);
+            }
+            case 4: // sqrt
+                if (!(resultat = prendrePrecalcule()))
+                    resultat = racineCarree(nombre);
+                break;
+            default:
+                return NULL;
+        }
+
+        // Le résultat d'un calcul (!, sqrt) est comparé aux nombres existants comme pour les opérations binaires.
+        if (!resultat)
+            return NULL;
+        num2 = checkPile(resultat, stack);
+        num3 = checkMem(resultat, mem);
+        num4 = checkMem(resultat, buffer);
+        if (num2 || num3 || num4 || isEqual(nombre, resultat)) {
+            deleteNumber(resultat);
+            resultat = num2 ? num2 : num3 ? num3 : num4 ? num4 : nombre;
+        }
+        return resultat;
+    }
+    return NULL;
+}
+
+num* resultatEntier(memoire *buffer, memoire *mem, pile *stack, num *nombre, char *str) {
+    num *resultat = transformationStructure(buffer, mem, stack, str); // Fais la verif checkMem etc.
+    if (!resultat)
+        return NULL;
+    if (isEqual(nombre, resultat)) {
+        if (!resultat->compteurRef)
+            deleteNumber(resultat);
+        resultat = nombre;
+    }
+    return resultat;
+}
+
+int validLiteral(char *nombre) {
+    if (!nombre)
+        return 0;
+    int longueurLiteral = (int) strlen(nombre);
+    if (*nombre == '$')
+        return validHistorique(nombre); // $1, $-1
+    if (*nombre < '0' || *nombre > '9')
+        return validNom(nombre); // Accepter 'a', 'total', 'acc2'
+    if (validLiteralBinaire(nombre))
+        return 1; // 0x1f3a, 0b1010: les zéros de poids fort sont admis.
+    if (longueurLiteral > 1 && *nombre == '0')
+        return 0; // Cas 0123 , 004324 mais on garde juste 0;
+    int i;
+    for(i = 0; i < longueurLiteral; i++)
+        if (!(*(nombre+i) >= '0' && *(nombre+i) <= '9'))
+            return 0;
+    return 1;
+}
+
+int validOpBin(char *opbin) {
+    if (!opbin)
+        return 0;
+    int longueur = (int) strlen(opbin);
+    if (longueur == 3 && !strcmp(opbin, "gcd"))
+        return 1; // Le pgcd est identifié par 'g' dans evaluerOpBin.
+    if (longueur == 4 && !strcmp(opbin, "head"))
+        return 1; // 'h' dans evaluerOpBin.
+    if (longueur > 1 || (*opbin != '+' && *opbin != '-' && *opbin != '*'))
+        return 0;
+    return 1;
+}
+
+int validOpUn(char *opun) {
+    if (!opun)
+        return 0;
+
+    int longueur = (int) strlen(opun);
+    if (longueur == 1 && (opun[0] == '?' || opun[0] == '!'))
+        return 1;
+    else if ((longueur == 4 && !strcmp(opun, "sqrt")) || (longueur == 3 && !strcmp(opun, "len")))
+        return 1;
+    else if (longueur >= 2 && opun[0] == '=' && validNom(opun + 1))
+        return 1;
+    return 0;
+}
+
+int validLiteralBinaire(char *literal) {
+    if (literal[0] != '0' || (literal[1] != 'x' && literal[1] != 'b') || !literal[2])
+        return 0;
+    char *p;
+    for (p = literal + 2; *p; p++) {
+        if (literal[1] == 'b' ? (*p != '0' && *p != '1')
+                              : !((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f') || (*p >= 'A' && *p <= 'F')))
+            return 0;
+    }
+    return 1;
+}
+
+int validNom(const char *nom) {
+    const char *p = nom;
+    int i;
+    if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || *p == '_'))
+        return 0;
+    for (p++; *p; p++)
+        if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_'))
+            return 0;
+    for (i = 0; motsReserves[i]; i++)
+        if (!strcmp(nom, motsReserves[i]))
+            return 0;
+    return 1;
+}
+
+void initPile(pile *stack) {
+    stack->length = 0;
+    stack->top = NULL;
+}
+
+int isEmpty(pile* stack) {
+    if (stack->top)
+        return 0;
+    return 1;
+}
+
+int push(pile* stack, num *nombre) { // 1 si out of memory, 0 sinon
+    node *noeud = malloc(sizeof(node));
+    if(!noeud)
+        return 1;
+    else {
+        noeud->nombre = nombre;
+        noeud->nombre->compteurRef++;
+        noeud->suivant = stack->top;
+        stack->top = noeud;
+        stack->length++;
+        return 0;
+    }
+}
+
+num* pop(pile* stack) {
+    node *noeud;
+    num *nombre;
+
+    if(isEmpty(stack))
+        return NULL;
+    noeud = stack->top;
+    stack->top = noeud->suivant;
+    nombre = noeud->nombre;
+    free(noeud);
+    stack->length--;
+
+    if (!stack->length)
+        stack->top = NULL;
+    nombre->compteurRef--;
+    return nombre;
+}
+
+num* checkPile(num *nombre, pile* stack) {
+    node *ptr = stack->top;
+    STATS_COMPTER(stats.recherchesPile);
+    TRACE_DEBUT("checkPile", findLenNum(nombre), -1, NULL, NULL);
+    while(ptr) {
+        if (isEqual(nombre, ptr->nombre)) {
+            STATS_COMPTER(stats.trouvesPile);
+            TRACE_FIN("checkPile");
+            return ptr->nombre; // On a trouvé un nombre égal à nombre dans la pile
+        }
+        ptr = ptr->suivant;
+    }
+    TRACE_FIN("checkPile");
+    return NULL;
+}
+
+void deletePile(pile* stack) {
+    num *nombre = pop(stack);
+    while (nombre) {
+        if (!nombre->compteurRef)
+            deleteNumber(nombre);
+        nombre = pop(stack);
+    }
+    free(stack);
+}
+
+num* addition(num *nombre1, num *nombre2) { // Addition de deux entiers positifs
+    num* temp;
+    // Valeurs absolues des opérandes: mêmes chiffres, sans toucher au signe des nombres, que d'autres threads lisent.
+    num absolu1 = *nombre1, absolu2 = *nombre2;
+    absolu1.negatif = absolu2.negatif = 0;
+    num* resultatSomme = malloc(sizeof(num));
+    if (!resultatSomme)
+        return NULL;
+    resultatSomme->chiffres = NULL; // Détruit sans chiffres si une opération intermédiaire échoue.
+
+    // En cas d'addition avec 0
+    if (!nombre1->chiffres && nombre2->chiffres) { // 0 + (-1234) ou 0 + 1234, il suffit de renvoyer num2
+        if (copyNum(nombre2, resultatSomme))
+            goto deleteSomme;
+        return resultatSomme;
+    }
+    else if (nombre1->chiffres && !nombre2->chiffres) { // 1234 + 0 ou -1234 + 0.
+        if (copyNum(nombre1, resultatSomme))
+            goto deleteSomme;
+        return resultatSomme;
+    }
+    else if (!nombre1->chiffres && !nombre2->chiffres) { // 0 + 0
+        resultatSomme->negatif = 0;
+        resultatSomme->chiffres = NULL;
+        return resultatSomme;
+    }
+
+    // En cas d'addition de nombre négatifs
+    if(nombre1->negatif && nombre2->negatif)
+        resultatSomme->negatif = 1; // Si on fait (-1234) + (-1234) = - (1234 + 1234)
+    else if (!nombre1->negatif && nombre2->negatif) { // Si on fait 1234 + (-1234) = 1234 - 1234
+        temp= soustraction(nombre1, &absolu2);
+        if (!temp)
+            goto deleteSomme;
+        if (copyNum(temp, resultatSomme))
+            goto deleteTempSomme;
+        deleteNumber(temp);
+        return resultatSomme;
+    }
+    else if (nombre1->negatif && !nombre2->negatif) { // Si on fait -1234 + 33
+        temp= soustraction(nombre2, &absolu1);
+        if (!temp)
+            goto deleteSomme;
+        if (copyNum(temp, resultatSomme))
+            goto deleteTempSomme;
+        deleteNumber(temp);
+        return resultatSomme;
+    }
+    else
+        resultatSomme->negatif = 0;
+
+    // Sinon on fait l'addition
+    if (threadsCalcul() > 1 && (findLenNum(nombre1) >= SEUIL_ADDITION_PARALLELE * CHIFFRES_TRANCHE
+                                || findLenNum(nombre2) >= SEUIL_ADDITION_PARALLELE * CHIFFRES_TRANCHE)) {
+        temp = additionParallele(nombre1, nombre2, 0, resultatSomme->negatif);
+        free(resultatSomme);
+        return temp;
+    }
+
+    int sommeIntermediaire;
+    int reste = 0;
+
+    resultatSomme->chiffres = NULL;
+    cell **queue = &resultatSomme->chiffres; // On garde la queue: addTailNum reparcourrait tout le nombre à chaque chiffre.
+    cell *chiffre1 = nombre1->chiffres; // Pointeur sur le premier chiffre de num1
+    cell *chiffre2 = nombre2->chiffres; // Pointeur sur le premier chiffre de num2
+
+    while(chiffre1 || chiffre2 || reste) {
+        sommeIntermediaire = reste;
+        if (chiffre1) {
+            sommeIntermediaire += chiffre1->chiffre - '0';
+            chiffre1 = chiffre1->suivant;
+        }
+        if (chiffre2) {
+            sommeIntermediaire += chiffre2->chiffre - '0';
+            chiffre2 = chiffre2->suivant;
+        }
+        reste = sommeIntermediaire / 10;
+
+        cell *nouveau_chiffre = malloc(sizeof(cell));
+        if (!nouveau_chiffre)
+            goto deleteSomme;
+        nouveau_chiffre->chiffre = (char) (sommeIntermediaire % 10 + '0');
+        nouveau_chiffre->suivant = NULL;
+        *queue = nouveau_chiffre;
+        queue = &nouveau_chiffre->suivant;
+    }
+    return resultatSomme;
+
+    deleteSomme:
+    deleteNumber(resultatSomme);
+    return NULL;
+
+    deleteTempSomme:
+    deleteNumber(resultatSomme);
+    deleteNumber(temp);
+    return NULL;
+}
+
+num* soustraction(num *nombre1, num *nombre2) {
+    int soustractionIntermediaire;
+    int reste = 0;
+    cell* chiffre1, *chiffre2;
+    num *temp;
+    num absolu1 = *nombre1, absolu2 = *nombre2; // Comme pour addition: les opérandes ne sont jamais modifiés.
+    absolu1.negatif = absolu2.negatif = 0;
+
+    num* resultatSoustraction = malloc(sizeof(num));
+    if (!resultatSoustraction)
+        return NULL;
+    resultatSoustraction->chiffres = NULL; // Détruit sans chiffres si une opération intermédiaire échoue.
+
+    // En cas de soustraction avec 0
+    if (!nombre1->chiffres && nombre2->chiffres) { // 0 - 1234 ou 0 - (-1234)
+        if (copyNum(nombre2, resultatSoustraction))
+            goto deleteSous;
+        if (nombre2->negatif)
+            resultatSoustraction->negatif = 0; // 0 - (-1234) si num2 negatif, alors le resultat est positif.
+        else
+            resultatSoustraction->negatif = 1; // 0 - 1234 si c'est 1234, alors ca devient négatif
+        return resultatSoustraction;
+    }
+    else if (nombre1->chiffres && !nombre2->chiffres) { // 1234 - 0 ou -1234 - 0; On garde num1 seulement
+        if (copyNum(nombre1, resultatSoustraction))
+            goto deleteSous;
+        return resultatSoustraction;
+    }
+    else if (!nombre1->chiffres && !nombre2->chiffres) { // Cas 0 - 0
+        resultatSoustraction->negatif = 0;
+        resultatSoustraction->chiffres = NULL;
+        return resultatSoustraction;
+    }
+
+
+    // Traitement des cas négatifs
+    if(nombre1->negatif && nombre2->negatif) { // (-12) - (-11) =  11 - 12
+        temp = soustraction(&absolu2, &absolu1);
+        if (!temp)
+            goto deleteSous;
+        if (copyNum(temp, resultatSoustraction))
+            goto deleteTempSous;
+        deleteNumber(temp);
+        return resultatSoustraction;
+    }
+    else if(nombre1->negatif && !nombre2->negatif) { // (-12) - (11) => - 12 - 11 = - (12+11) => addition(12,11) puis je prends le négatif
+        temp = addition(&absolu1, nombre2);
+        if (!temp)
+            goto deleteSous;
+        if (copyNum(temp, resultatSoustraction))
+            goto deleteTempSous;
+        deleteNumber(temp);
+        resultatSoustraction->negatif = 1;
+        return resultatSoustraction;
+    }
+    else if (!nombre1->negatif && nombre2->negatif) { // (12) - (-11) => addition(12,11) SEULEMENT
+        temp = addition(nombre1, &absolu2);
+        if (!temp)
+            goto deleteSous;
+        if (copyNum(temp, resultatSoustraction))
+            goto deleteTempSous;
+        deleteNumber(temp);
+        return resultatSoustraction;
+    }
+
+    // Si num2 plus grand que num1, par exemple 11 - 12
+    if (!compareNum(nombre1, nombre2)) { // Si num1 < num2
+        temp = soustraction(nombre2, nombre1);
+        if (!temp)
+            goto deleteSous;
+        if (copyNum(temp, resultatSoustraction))
+            goto deleteTempSous;
+        deleteNumber(temp);
+        resultatSoustraction->negatif = 1;
+        return resultatSoustraction;
+    }
+
+    if (threadsCalcul() > 1 && findLenNum(nombre1) >= SEUIL_ADDITION_PARALLELE * CHIFFRES_TRANCHE) {
+        temp = additionParallele(nombre1, nombre2, 1, 0);
+        free(resultatSoustraction);
+        return temp;
+    }
+
+    resultatSoustraction->chiffres = NULL;
+    cell **queue = &resultatSoustraction->chiffres; // Construction en temps linéaire, contrairement à addTailNum.
+    cell *dernierNonNul = NULL; // Les zéros de poids fort sont retirés d'un coup à la fin.
+    chiffre1 = nombre1->chiffres; // Pointeur sur le premier chiffre de num1
+    chiffre2 = nombre2->chiffres; // Pointeur sur le premier chiffre de num2
+
+    while(chiffre1) {
+
+        // Je fais la soustraction entre les deux chiffres.
+        soustractionIntermediaire = (chiffre1->chiffre - '0') - reste;
+        if (chiffre2) {
+            soustractionIntermediaire -= chiffre2->chiffre - '0';
+            chiffre2 = chiffre2->suivant;
+        }
+        if (soustractionIntermediaire < 0) {
+            soustractionIntermediaire += 10;
+            reste = 1;
+        }
+        else
+            reste = 0;
+
+        cell *nouveau_chiffre = malloc(sizeof(cell));
+        if (!nouveau_chiffre)
+            goto deleteSous;
+        nouveau_chiffre->chiffre = (char) (soustractionIntermediaire + '0');
+        nouveau_chiffre->suivant = NULL;
+        if (soustractionIntermediaire)
+            dernierNonNul = nouveau_chiffre;
+        *queue = nouveau_chiffre;
+        queue = &nouveau_chiffre->suivant;
+        chiffre1 = chiffre1->suivant;
+    }
+
+    resultatSoustraction->negatif = 0;
+    cell *p = dernierNonNul ? dernierNonNul->suivant : resultatSoustraction->chiffres, *suivant;
+    if (dernierNonNul)
+        dernierNonNul->suivant = NULL;
+    else
+        resultatSoustraction->chiffres = NULL;
+    while (p) {
+        suivant = p->suivant;
+        free(p);
+        p = suivant;
+    }
+    return resultatSoustraction;
+
+    deleteSous:
+    deleteNumber(resultatSoustraction);
+    return NULL;
+
+    deleteTempSous:
+    deleteNumber(resultatSoustraction);
+    deleteNumber(temp);
+    return NULL;
+}
+
+num* multiplication(num *nombre1, num *nombre2) { // Produit calculé sur les tranches en base 10^9 (Karatsuba)
+    tranches a, b, produit;
+    num *resultatMultiplication = NULL;
+    a.valeurs = b.valeurs = NULL;
+
+    if (numVersTranches(nombre1, &a) || numVersTranches(nombre2, &b) || multiplicationTranches(&a, &b, &produit))
+        goto deleteMultiplication;
+    resultatMultiplication = tranchesVersNum(&produit, nombre1->negatif ^ nombre2->negatif);
+    libererTranches(&produit);
+
+    deleteMultiplication:
+    libererTranches(&a);
+    libererTranches(&b);
+    return resultatMultiplication;
+}
+
+num* pgcd(num *nombre1, num *nombre2) { // pgcd des valeurs absolues, calculé sur les tranches en base 10^9
+    tranches a, b, temp, echange;
+    num *resultatPgcd = NULL;
+    a.valeurs = b.valeurs = temp.valeurs = NULL;
+
+    if (numVersTranches(nombre1, &a) || numVersTranches(nombre2, &b))
+        goto deletePgcd;
+    if (comparerTranches(&a, &b) < 0) { // On s'assure que a >= b
+        echange = a; a = b; b = echange;
+    }
+
+    while (b.longueur) {
+        if (calculInterrompu())
+            goto deletePgcd;
+        // Les deux nombres tiennent sur 2 tranches (< 10^18): on termine avec l'algorithme d'Euclide sur des entiers machine.
+        if (a.longueur <= 2) {
+            unsigned long long x = a.valeurs[0] + (a.longueur > 1 ? (unsigned long long) a.valeurs[1] * BASE_TRANCHE : 0);
+            unsigned long long y = b.valeurs[0] + (b.longueur > 1 ? (unsigned long long) b.valeurs[1] * BASE_TRANCHE : 0);
+            while (y) {
+                unsigned long long r = x % y;
+                x = y;
+                y = r;
+            }
+            a.valeurs[0] = (unsigned int) (x % BASE_TRANCHE);
+            if (a.longueur > 1)
+                a.valeurs[1] = (unsigned int) (x / BASE_TRANCHE);
+            normaliserTranches(&a);
+            break;
+        }
+
+        // Étape de Lehmer: on simule Euclide sur les deux tranches de poids fort de a (et les tranches de b au même rang)
+        // tant que le quotient est garanti identique à celui des nombres complets (condition de Knuth, algorithme L).
+        int n = a.longueur;
+        long long ah = (long long) a.valeurs[n - 1] * BASE_TRANCHE + a.valeurs[n - 2];
+        long long bh = (b.longueur >= n ? (long long) b.valeurs[n - 1] * BASE_TRANCHE : 0) + (b.longueur >= n - 1 ? b.valeurs[n - 2] : 0);
+        long long A = 1, B = 0, C = 0, D = 1, q, t;
+        while (bh + C != 0 && bh + D != 0) {
+            q = (ah + A) / (bh + C);
+            if (q != (ah + B) / (bh + D))
+                break;
+            t = A - q * C; A = C; C = t;
+            t = B - q * D; B = D; D = t;
+            t = ah - q * bh; ah = bh; bh = t;
+        }
+
+        if (!B) { // Aucun quotient sûr (b beaucoup plus petit que a): une étape d'Euclide complète par division.
+            if (divisionTranches(&a, &b, NULL, &temp))
+                goto deletePgcd;
+            echange = a; a = b; b = temp; temp = echange;
+            continue;
+        }
+
+        // Sinon a' = A*a + B*b et b' = C*a + D*b, les cofacteurs étant de signes alternés et les résultats positifs.
+        tranches nouveaux[2];
+        long long coefs[2][2] = {{A, B}, {C, D}};
+        if (allouerTranches(&nouveaux[0], n))
+            goto deletePgcd;
+        if (allouerTranches(&nouveaux[1], n)) {
+            libererTranches(&nouveaux[0]);
+            goto deletePgcd;
+        }
+        int k, i;
+        for (k = 0; k < 2; k++) {
+            __int128 retenue = 0;
+            for (i = 0; i < n; i++) {
+                __int128 s = retenue + (__int128) coefs[k][0] * a.valeurs[i] + (__int128) coefs[k][1] * (i < b.longueur ? b.valeurs[i] : 0);
+                retenue = s / BASE_TRANCHE;
+                s %= BASE_TRANCHE;
+                if (s < 0) {
+                    s += BASE_TRANCHE;
+                    retenue--;
+                }
+                nouveaux[k].valeurs[i] = (unsigned int) s;
+            }
+            normaliserTranches(&nouveaux[k]);
+        }
+        libererTranches(&a);
+        libererTranches(&b);
+        a = nouveaux[0];
+        b = nouveaux[1];
+    }
+
+    resultatPgcd = tranchesVersNum(&a, 0);
+
+    deletePgcd:
+    libererTranches(&a);
+    libererTranches(&b);
+    libererTranches(&temp);
+    return resultatPgcd;
+}
+
+int limiteFactorielle(num *nombre, unsigned int *n) {
+    cell *p;
+    unsigned int puissance = 1;
+    int signe;
+
+    if (findLenNum(nombre) > 9)
+        return 1; // n >= 10^9: le résultat aurait des milliards de chiffres.
+    *n = 0;
+    for (p = nombre->chiffres; p; p = p->suivant, puissance *= 10) // Du poids faible au poids fort.
+        *n += (unsigned int) (p->chiffre - '0') * puissance;
+
+    // Estimation de la taille du résultat: log10(n!) = lgamma(n + 1) / ln(10). lgamma_r n'écrit pas dans la variable
+    // globale signgam: les tâches de l'arbre (--parallel-expr) l'appellent en même temps.
+    return lgamma_r((double) *n + 1.0, &signe) / log(10.0) > CHIFFRES_MAX_FACTORIELLE;
+}
+
+num* factorielle(num *nombre) {
+    tranches produit;
+    num *resultatFactorielle;
+    unsigned int n;
+
+    if (limiteFactorielle(nombre, &n))
+        return NULL;
+
+    if (n < 2) {
+        if (allouerTranches(&produit, 1))
+            return NULL;
+        produit.valeurs[0] = 1;
+    }
+    else if (produitIntervalle(2, n, &produit))
+        return NULL;
+
+    resultatFactorielle = tranchesVersNum(&produit, 0);
+    libererTranches(&produit);
+    return resultatFactorielle;
+}
+
+num* racineCarree(num *nombre) {
+    tranches n, racine;
+    num *resultatRacine;
+    if (numVersTranches(nombre, &n))
+        return NULL;
+    if (racineTranches(&n, &racine)) {
+        libererTranches(&n);
+        return NULL;
+    }
+    resultatRacine = tranchesVersNum(&racine, 0);
+    libererTranches(&n);
+    libererTranches(&racine);
+    return resultatRacine;
+}
+
+num* tete(num *nombre, num *k) {
+    int longueur = findLenNum(nombre), garder = longueur, i;
+    if (findLenNum(k) <= 9) { // Au-delà, k dépasse la longueur de tout nombre.
+        long long valeur = 0, puissance = 1;
+        cell *p;
+        for (p = k->chiffres; p; p = p->suivant, puissance *= 10)
+            valeur += (p->chiffre - '0') * puissance;
+        if (valeur < longueur)
+            garder = (int) valeur;
+    }
+
+    num *resultatTete = malloc(sizeof(num));
+    if (!resultatTete)
+        return NULL;
+    resultatTete->compteurRef = 0;
+    resultatTete->negatif = nombre->negatif && garder;
+    resultatTete->chiffres = NULL;
+
+    cell *p = nombre->chiffres, **queue = &resultatTete->chiffres;
+    for (i = longueur - garder; i > 0; i--)
+        p = p->suivant; // Chiffres de poids faible écartés.
+    for (; p; p = p->suivant) {
+        cell *nouveau_chiffre = malloc(sizeof(cell));
+        if (!nouveau_chiffre) {
+            *queue = NULL;
+            deleteNumber(resultatTete);
+            return NULL;
+        }
+        nouveau_chiffre->chiffre = p->chiffre;
+        *queue = nouveau_chiffre;
+        queue = &nouveau_chiffre->suivant;
+    }
+    *queue = NULL;
+    return resultatTete;
+}
+
+void enleverPoidsForts0(num *nombre) {
+    cell* tail = checkTailNum(nombre);
+    while (tail  && tail->chiffre == '0') {
+        deleteTailNum(nombre);
+        tail = checkTailNum(nombre);
+    }
+}
+
+int allouerTranches(tranches *t, int longueur) {
+    t->longueur = longueur;
+    t->valeurs = calloc(longueur > 0 ? (size_t) longueur : 1, sizeof(unsigned int));
+    if (!t->valeurs)
+        return 1; // Out of memory
+    return 0;
+}
+
+void libererTranches(tranches *t) {
+    if (t->valeurs)
+        free(t->valeurs);
+    t->valeurs = NULL;
+    t->longueur = 0;
+}
+
+void normaliserTranches(tranches *t) {
+    while (t->longueur && !t->valeurs[t->longueur - 1])
+        t->longueur--;
+}
+
+int numVersTranches(num *nombre, tranches *t) {
+    int longueur = findLenNum(nombre);
+    if (allouerTranches(t, (longueur + CHIFFRES_TRANCHE - 1) / CHIFFRES_TRANCHE))
+        return 1;
+
+    cell *p = nombre->chiffres;
+    unsigned int puissance = 1;
+    int i = 0, rang = 0;
+    while (p) { // Les chiffres sont déjà du poids faible au poids fort: on les regroupe par 9.
+        t->valeurs[i] += (unsigned int) (p->chiffre - '0') * puissance;
+        puissance *= 10;
+        if (++rang == CHIFFRES_TRANCHE) {
+            rang = 0;
+            puissance = 1;
+            i++;
+        }
+        p = p->suivant;
+    }
+    normaliserTranches(t);
+    return 0;
+}
+
+num* tranchesVersNum(tranches *t, int negatif) {
+    num *nombre = malloc(sizeof(num));
+    if (!nombre)
+        return NULL;
+    nombre->compteurRef = 0;
+    nombre->chiffres = NULL;
+
+    cell **queue = &nombre->chiffres; // On garde la queue afin de construire le nombre en temps linéaire.
+    cell *dernierNonNul = NULL;
+    int i, j;
+    for (i = 0; i < t->longueur; i++) {
+        unsigned int valeur = t->valeurs[i];
+        for (j = 0; j < CHIFFRES_TRANCHE; j++) {
+            cell *nouveau_chiffre = malloc(sizeof(cell));
+            if (!nouveau_chiffre) {
+                *queue = NULL;
+                deleteNumber(nombre);
+                return NULL; // Out of memory
+            }
+            nouveau_chiffre->chiffre = (char) (valeur % 10 + '0');
+            if (valeur % 10)
+                dernierNonNul = nouveau_chiffre;
+            valeur /= 10;
+            *queue = nouveau_chiffre;
+            queue = &nouveau_chiffre->suivant;
+        }
+    }
+    *queue = NULL;
+
+    // On retire les zéros de poids fort de la dernière tranche.
+    if (!dernierNonNul) {
+        deleteChiffres(nombre);
+        nombre->chiffres = NULL;
+    }
+    else {
+        cell *p = dernierNonNul->suivant, *suivant;
+        dernierNonNul->suivant = NULL;
+        while (p) {
+            suivant = p->suivant;
+            free(p);
+            p = suivant;
+        }
+    }
+    nombre->negatif = nombre->chiffres ? negatif : 0;
+    return nombre;
+}
+
+int comparerTranches(tranches *a, tranches *b) {
+    if (a->longueur != b->longueur)
+        return a->longueur < b->longueur ? -1 : 1;
+    int i;
+    for (i = a->longueur - 1; i >= 0; i--)
+        if (a->valeurs[i] != b->valeurs[i])
+            return a->valeurs[i] < b->valeurs[i] ? -1 : 1;
+    return 0;
+}
+
+int divisionTranches(tranches *a, tranches *b, tranches *quotient, tranches *reste) {
+    tranches un, vn;
+    int n = b->longueur, m = a->longueur - b->longueur, i, j;
+    unsigned long long r;
+
+    if (comparerTranches(a, b) < 0) { // a < b: quotient nul et reste a.
+        if (quotient && allouerTranches(quotient, 1))
+            return 1;
+        if (quotient)
+            quotient->longueur = 0;
+        if (reste) {
+            if (reste->valeurs && reste->longueur < a->longueur + 1)
+                libererTranches(reste);
+            if (!reste->valeurs && allouerTranches(reste, a->longueur + 1))
+                return 1;
+            memcpy(reste->valeurs, a->valeurs, sizeof(unsigned int) * (size_t) a->longueur);
+            reste->longueur = a->longueur;
+        }
+        return 0;
+    }
+
+    if (quotient && allouerTranches(quotient, m + 1))
+        return 1;
+
+    if (n == 1) { // Division courte par une seule tranche.
+        r = 0;
+        for (i = a->longueur - 1; i >= 0; i--) {
+            r = r * BASE_TRANCHE + a->valeurs[i];
+            if (quotient)
+                quotient->valeurs[i] = (unsigned int) (r / b->valeurs[0]);
+            r %= b->valeurs[0];
+        }
+        if (quotient)
+            normaliserTranches(quotient);
+        if (reste) {
+            if (!reste->valeurs && allouerTranches(reste, 1))
+                return 1;
+            reste->valeurs[0] = (unsigned int) r;
+            reste->longueur = 1;
+            normaliserTranches(reste);
+        }
+        return 0;
+    }
+
+    // Normalisation: on multiplie a et b par d afin que la tranche de poids fort de b soit >= BASE / 2.
+    unsigned long long d = BASE_TRANCHE / ((unsigned long long) b->valeurs[n - 1] + 1);
+    if (allouerTranches(&un, a->longueur + 1)) {
+        if (quotient)
+            libererTranches(quotient);
+        return 1;
+    }
+    if (allouerTranches(&vn, n)) {
+        libererTranches(&un);
+        if (quotient)
+            libererTranches(quotient);
+        return 1;
+    }
+    r = 0;
+    for (i = 0; i < a->longueur; i++) {
+        r += a->valeurs[i] * d;
+        un.valeurs[i] = (unsigned int) (r % BASE_TRANCHE);
+        r /= BASE_TRANCHE;
+    }
+    un.valeurs[a->longueur] = (unsigned int) r;
+    r = 0;
+    for (i = 0; i < n; i++) {
+        r += b->valeurs[i] * d;
+        vn.valeurs[i] = (unsigned int) (r % BASE_TRANCHE);
+        r /= BASE_TRANCHE;
+    }
+
+    for (j = m; j >= 0; j--) {
+        if (!(j % 64) && calculInterrompu()) {
+            libererTranches(&un);
+            libererTranches(&vn);
+            if (quotient)
+                libererTranches(quotient);
+            return 1;
+        }
+        // Estimation du chiffre de quotient à partir des deux tranches de poids fort, corrigée au plus deux fois.
+        unsigned long long numerateur = (unsigned long long) un.valeurs[j + n] * BASE_TRANCHE + un.valeurs[j + n - 1];
+        unsigned long long qhat = numerateur / vn.valeurs[n - 1];
+        unsigned long long rhat = numerateur % vn.valeurs[n - 1];
+        while (qhat >= BASE_TRANCHE || qhat * vn.valeurs[n - 2] > rhat * BASE_TRANCHE + un.valeurs[j + n - 2]) {
+            qhat--;
+            rhat += vn.valeurs[n - 1];
+            if (rhat >= BASE_TRANCHE)
+                break;
+        }
+
+        // un[j..j+n] -= qhat * vn
+        unsigned long long retenue = 0;
+        long long emprunt = 0, t;
+        for (i = 0; i < n; i++) {
+            unsigned long long produit = qhat * vn.valeurs[i] + retenue;
+            retenue = produit / BASE_TRANCHE;
+            t = (long long) un.valeurs[i + j] - (long long) (produit % BASE_TRANCHE) + emprunt;
+            emprunt = t < 0 ? -1 : 0;
+            un.valeurs[i + j] = (unsigned int) (t < 0 ? t + BASE_TRANCHE : t);
+        }
+        t = (long long) un.valeurs[j + n] - (long long) retenue + emprunt;
+
+        if (t < 0) { // L'estimation était trop grande d'une unité: on rajoute vn.
+            un.valeurs[j + n] = (unsigned int) (t + BASE_TRANCHE);
+            qhat--;
+            retenue = 0;
+            for (i = 0; i < n; i++) {
+                unsigned long long s = (unsigned long long) un.valeurs[i + j] + vn.valeurs[i] + retenue;
+                un.valeurs[i + j] = (unsigned int) (s % BASE_TRANCHE);
+                retenue = s / BASE_TRANCHE;
+            }
+            un.valeurs[j + n] = (unsigned int) ((un.valeurs[j + n] + retenue) % BASE_TRANCHE);
+        }
+        else
+            un.valeurs[j + n] = (unsigned int) t;
+
+        if (quotient)
+            quotient->valeurs[j] = (unsigned int) qhat;
+    }
+
+    if (quotient)
+        normaliserTranches(quotient);
+    if (reste) { // Le reste est un[0..n-1] / d
+        if (reste->valeurs && reste->longueur < n)
+            libererTranches(reste);
+        if (!reste->valeurs && allouerTranches(reste, n)) {
+            libererTranches(&un);
+            libererTranches(&vn);
+            return 1;
+        }
+        r = 0;
+        for (i = n - 1; i >= 0; i--) {
+            r = r * BASE_TRANCHE + un.valeurs[i];
+            reste->valeurs[i] = (unsigned int) (r / d);
+            r %= d;
+        }
+        reste->longueur = n;
+        normaliserTranches(reste);
+    }
+    libererTranches(&un);
+    libererTranches(&vn);
+    return 0;
+}
+
+int inverseTranches(tranches *d, tranches *inverse) {
+    tranches a, haut, x, produit, ecart, correction;
+    unsigned int un = 1;
+    int k = d->longueur, h, i, capacite, excedent, erreur = 1;
+
+    if (k <= SEUIL_DIVISION) { // Petit diviseur: division directe de B^2k - 1.
+        if (allouerTranches(&a, 2 * k))
+            return 1;
+        for (i = 0; i < 2 * k; i++)
+            a.valeurs[i] = BASE_TRANCHE - 1;
+        erreur = divisionTranches(&a, d, inverse, NULL);
+        libererTranches(&a);
+        return erreur;
+    }
+    if (calculInterrompu())
+        return 1;
+
+    // L'inverse des h tranches de poids fort, décalé de k - h tranches, a une erreur relative inférieure à B^-(h - 1)
+    // (la tranche de poids fort de d peut valoir 1), que l'itération élève au carré: h dépasse k / 2 de deux tranches.
+    h = (k + 1) / 2 + 2;
+    haut.longueur = h;
+    haut.valeurs = d->valeurs + (k - h); // Simple vue sur les tranches de poids fort, sans copie.
+    if (inverseTranches(&haut, &a))
+        return 1;
+    produit.valeurs = ecart.valeurs = NULL;
+    capacite = a.longueur + k - h + 2;
+    if (allouerTranches(&x, capacite)) {
+        libererTranches(&a);
+        return 1;
+    }
+    memcpy(x.valeurs + (k - h), a.valeurs, sizeof(unsigned int) * (size_t) a.longueur);
+    libererTranches(&a);
+    normaliserTranches(&x);
+
+    // Itération de Newton: x +- x * |B^2k - d * x| / B^2k, qui double le nombre de tranches justes.
+    if (multiplicationTranches(d, &x, &produit))
+        goto deleteInverse;
+    excedent = produit.longueur > 2 * k; // d * x >= B^2k: la correction est retranchée.
+    if (allouerTranches(&ecart, (excedent ? produit.longueur : 2 * k) + 1))
+        goto deleteInverse;
+    if (excedent) {
+        memcpy(ecart.valeurs, produit.valeurs, sizeof(unsigned int) * (size_t) produit.longueur);
+        soustraireTableau(ecart.valeurs + 2 * k, ecart.longueur - 2 * k, &un, 1);
+    }
+    else {
+        ecart.valeurs[2 * k] = 1;
+        soustraireTableau(ecart.valeurs, ecart.longueur, produit.valeurs, produit.longueur);
+    }
+    normaliserTranches(&ecart);
+    libererTranches(&produit);
+    if (multiplicationTranches(&x, &ecart, &produit))
+        goto deleteInverse;
+    libererTranches(&ecart);
+    if (produit.longueur > 2 * k) {
+        correction.valeurs = produit.valeurs + 2 * k;
+        correction.longueur = produit.longueur - 2 * k;
+        if (excedent)
+            soustraireTableau(x.valeurs, x.longueur, correction.valeurs, correction.longueur);
+        else
+            ajouterTableau(x.valeurs, capacite, correction.valeurs, correction.longueur);
+        x.longueur = capacite;
+        normaliserTranches(&x);
+    }
+    libererTranches(&produit);
+
+    // Correction finale, de quelques unités au plus: d * x <= B^2k - 1 < d * (x + 1).
+    if (multiplicationTranches(d, &x, &produit))
+        goto deleteInverse;
+    while (produit.longueur > 2 * k) {
+        soustraireTableau(x.valeurs, x.longueur, &un, 1);
+        normaliserTranches(&x);
+        soustraireTableau(produit.valeurs, produit.longueur, d->valeurs, d->longueur);
+        normaliserTranches(&produit);
+    }
+    if (allouerTranches(&ecart, 2 * k))
+        goto deleteInverse;
+    for (i = 0; i < 2 * k; i++)
+        ecart.valeurs[i] = BASE_TRANCHE - 1;
+    soustraireTableau(ecart.valeurs, ecart.longueur, produit.valeurs, produit.longueur);
+    normaliserTranches(&ecart);
+    while (comparerTranches(&ecart, d) >= 0) {
+        soustraireTableau(ecart.valeurs, ecart.longueur, d->valeurs, d->longueur);
+        normaliserTranches(&ecart);
+        ajouterTableau(x.valeurs, capacite, &un, 1);
+        x.longueur = capacite;
+        normaliserTranches(&x);
+    }
+    *inverse = x;
+    x.valeurs = NULL;
+    erreur = 0;
+
+deleteInverse:
+    if (x.valeurs)
+        libererTranches(&x);
+    libererTranches(&produit);
+    libererTranches(&ecart);
+    return erreur;
+}
+
+int quotientTranches(tranches *a, tranches *b, tranches *quotient) {
+    tranches diviseur, inverse, produit, reste;
+    unsigned int un = 1;
+    int n = b->longueur, decalage, capacite, erreur = 1;
+
+    if (n <= SEUIL_DIVISION || a->longueur - n <= SEUIL_DIVISION) // Quotient ou diviseur court: algorithme D.
+        return divisionTranches(a, b, quotient, NULL);
+
+    // Avec s tranches nulles sous b, l'inverse a assez de tranches justes pour un quotient de a->longueur - n tranches.
+    decalage = a->longueur > 2 * n ? a->longueur - 2 * n : 0;
+    diviseur = *b;
+    inverse.valeurs = produit.valeurs = reste.valeurs = NULL;
+    if (decalage) {
+        if (allouerTranches(&diviseur, n + decalage))
+            return 1;
+        memcpy(diviseur.valeurs + decalage, b->valeurs, sizeof(unsigned int) * (size_t) n);
+    }
+    if (inverseTranches(&diviseur, &inverse) || multiplicationTranches(a, &inverse, &produit))
+        goto deleteQuotient;
+
+    // q = a * inverse / B^(2n + s) est une estimation par défaut, de deux unités au plus.
+    capacite = produit.longueur - (2 * n + decalage) > 0 ? produit.longueur - (2 * n + decalage) + 1 : 1;
+    if (allouerTranches(quotient, capacite))
+        goto deleteQuotient;
+    if (capacite > 1)
+        memcpy(quotient->valeurs, produit.valeurs + 2 * n + decalage, sizeof(unsigned int) * (size_t) (capacite - 1));
+    normaliserTranches(quotient);
+    libererTranches(&produit);
+    if (multiplicationTranches(quotient, b, &produit) || allouerTranches(&reste, a->longueur)) {
+        libererTranches(quotient);
+        goto deleteQuotient;
+    }
+    memcpy(reste.valeurs, a->valeurs, sizeof(unsigned int) * (size_t) a->longueur);
+    soustraireTableau(reste.valeurs, reste.longueur, produit.valeurs, produit.longueur);
+    normaliserTranches(&reste);
+    while (comparerTranches(&reste, b) >= 0) { // Correction: reste = a - q * b doit être < b.
+        soustraireTableau(reste.valeurs, reste.longueur, b->valeurs, n);
+        normaliserTranches(&reste);
+        ajouterTableau(quotient->valeurs, capacite, &un, 1);
+        quotient->longueur = capacite;
+        normaliserTranches(quotient);
+    }
+    erreur = 0;
+
+deleteQuotient:
+    if (decalage)
+        libererTranches(&diviseur);
+    libererTranches(&inverse);
+    libererTranches(&produit);
+    libererTranches(&reste);
+    return erreur;
+}
+
+int multiplicationTranches(tranches *a, tranches *b, tranches *resultat) {
+    if (allouerTranches(resultat, a->longueur + b->longueur))
+        return 1;
+    if (a->longueur && b->longueur && multiplicationTableaux(a->valeurs, a->longueur, b->valeurs, b->longueur, resultat->valeurs)) {
+        libererTranches(resultat);
+        return 1;
+    }
+    normaliserTranches(resultat);
+    return 0;
+}
+
+int multiplicationTableaux(unsigned int *a, int na, unsigned int *b, int nb, unsigned int *resultat) {
+    unsigned int *temp;
+    int i;
+
+    if (na < nb) { // a est toujours le plus long des deux
+        temp = a; a = b; b = temp;
+        i = na; na = nb; nb = i;
+    }
+    memset(resultat, 0, sizeof(unsigned int) * (size_t) (na + nb));
+    if (nb < SEUIL_KARATSUBA) {
+        multiplicationBasique(a, na, b, nb, resultat);
+        return 0;
+    }
+    if (na == nb)
+        return karatsuba(a, b, na, resultat);
+
+    // Longueurs déséquilibrées: on découpe a en blocs de nb tranches, chacun multiplié par b.
+    temp = malloc(sizeof(unsigned int) * 2 * (size_t) nb);
+    if (!temp)
+        return 1; // Out of memory
+    for (i = 0; i < na; i += nb) {
+        int longueurBloc = na - i < nb ? na - i : nb;
+        if ((longueurBloc == nb ? karatsuba(a + i, b, nb, temp) : multiplicationTableaux(a + i, longueurBloc, b, nb, temp))) {
+            free(temp);
+            return 1;
+        }
+        ajouterTableau(resultat + i, na + nb - i, temp, longueurBloc + nb);
+    }
+    free(temp);
+    return 0;
+}
+
+int karatsuba(unsigned int *a, unsigned int *b, int n, unsigned int *resultat) {
+    if (n < SEUIL_KARATSUBA) {
+        memset(resultat, 0, sizeof(unsigned int) * 2 * (size_t) n);
+        multiplicationBasique(a, n, b, n, resultat);
+        return 0;
+    }
+    if (calculInterrompu())
+        return 1;
+
+    // a = a1 * B^h + a0 et b = b1 * B^h + b0. On calcule z0 = a0 * b0, z2 = a1 * b1 et
+    // z1 = (a0 + a1)(b0 + b1) - z0 - z2, puis resultat = z2 * B^2h + z1 * B^h + z0.
+    int h = n / 2, m = n - h;
+    unsigned int *temp = malloc(sizeof(unsigned int) * 4 * (size_t) (m + 1));
+    if (!temp)
+        return 1; // Out of memory
+    unsigned int *sommeA = temp, *sommeB = temp + m + 1, *z1 = temp + 2 * (m + 1);
+
+    memset(sommeA, 0, sizeof(unsigned int) * 2 * (size_t) (m + 1));
+    memcpy(sommeA, a, sizeof(unsigned int) * (size_t) h);
+    memcpy(sommeB, b, sizeof(unsigned int) * (size_t) h);
+    ajouterTableau(sommeA, m + 1, a + h, m);
+    ajouterTableau(sommeB, m + 1, b + h, m);
+
+    int erreur;
+    if (n >= SEUIL_PARALLELE && threadsCalcul() > 1) {
+        // Les trois sous-produits écrivent dans des zones distinctes: z0 et z2 partent sur le groupe de threads.
+        argumentsKaratsuba k0 = {a, b, resultat, h, 0}, k2 = {a + h, b + h, resultat + 2 * h, m, 0};
+        tache t0 = {karatsubaTache, &k0, TACHE_EN_FILE, NULL, 0}, t2 = {karatsubaTache, &k2, TACHE_EN_FILE, NULL, 0};
+        soumettreTache(&t0);
+        soumettreTache(&t2);
+        erreur = karatsuba(sommeA, sommeB, m + 1, z1);
+        attendreTache(&t2);
+        attendreTache(&t0);
+        erreur |= k0.erreur | k2.erreur;
+    }
+    else
+        erreur = karatsuba(a, b, h, resultat) || karatsuba(a + h, b + h, m, resultat + 2 * h) || karatsuba(sommeA, sommeB, m + 1, z1);
+    if (erreur) {
+        free(temp);
+        return 1;
+    }
+    soustraireTableau(z1, 2 * (m + 1), resultat, 2 * h);
+    soustraireTableau(z1, 2 * (m + 1), resultat + 2 * h, 2 * m);
+    ajouterTableau(resultat + h, 2 * n - h, z1, 2 * (m + 1) < 2 * n - h ? 2 * (m + 1) : 2 * n - h);
+    free(temp);
+    return 0;
+}
+
+void karatsubaTache(void *argument) {
+    argumentsKaratsuba *k = argument;
+    k->erreur = karatsuba(k->a, k->b, k->n, k->resultat);
+}
+
+num* additionParallele(num *nombre1, num *nombre2, int soustraire, int negatif) {
+    tranches a, b, resultat;
+    argumentsBloc *blocs = NULL;
+    tache *taches = NULL;
+    num *resultatAddition = NULL;
+    a.valeurs = b.valeurs = resultat.valeurs = NULL;
+
+    if (numVersTranches(nombre1, &a) || numVersTranches(nombre2, &b))
+        goto deleteAdditionParallele;
+    if (a.longueur < b.longueur) { // Seulement pour l'addition: la soustraction reçoit déjà le plus grand en premier.
+        tranches echange = a;
+        a = b;
+        b = echange;
+    }
+    if (allouerTranches(&resultat, a.longueur + 1))
+        goto deleteAdditionParallele;
+
+    int nombreBlocs = threadsCalcul() * BLOCS_PAR_THREAD, i;
+    if (nombreBlocs > a.longueur / (SEUIL_ADDITION_PARALLELE / BLOCS_PAR_THREAD))
+        nombreBlocs = a.longueur / (SEUIL_ADDITION_PARALLELE / BLOCS_PAR_THREAD);
+    if (nombreBlocs < 1)
+        nombreBlocs = 1;
+    blocs = malloc(sizeof(argumentsBloc) * (size_t) nombreBlocs);
+    taches = malloc(sizeof(tache) * (size_t) nombreBlocs);
+    if (!blocs || !taches)
+        goto deleteAdditionParallele;
+
+    for (i = 0; i < nombreBlocs; i++) {
+        argumentsBloc bloc = {a.valeurs, b.valeurs, resultat.valeurs, (int) ((long long) a.longueur * i / nombreBlocs),
+                              (int) ((long long) a.longueur * (i + 1) / nombreBlocs), b.longueur, soustraire, 0, 0};
+        tache t = {blocTache, &blocs[i], TACHE_EN_FILE, NULL, 0};
+        blocs[i] = bloc;
+        taches[i] = t;
+        soumettreTache(&taches[i]);
+    }
+    for (i = nombreBlocs - 1; i >= 0; i--)
+        attendreTache(&taches[i]);
+
+    // Balayage des retenues: celle qui entre dans le bloc i + 1 est genere(i) ou (propage(i) et celle qui entre dans i).
+    int retenue = 0, corrections = 0;
+    for (i = 0; i < nombreBlocs; i++) {
+        int entrante = retenue;
+        retenue = blocs[i].genere | (blocs[i].propage & entrante);
+        if (entrante) {
+            tache t = {correctionBlocTache, &blocs[i], TACHE_EN_FILE, NULL, 0};
+            taches[corrections] = t;
+            soumettreTache(&taches[corrections++]);
+        }
+    }
+    for (i = corrections - 1; i >= 0; i--)
+        attendreTache(&taches[i]);
+    resultat.valeurs[a.longueur] = (unsigned int) retenue; // Toujours 0 pour une soustraction, |nombre1| >= |nombre2|.
+
+    normaliserTranches(&resultat);
+    resultatAddition = tranchesVersNum(&resultat, negatif);
+
+    deleteAdditionParallele:
+    free(blocs);
+    free(taches);
+    libererTranches(&a);
+    libererTranches(&b);
+    libererTranches(&resultat);
+    return resultatAddition;
+}
+
+void blocTache(void *argument) {
+    argumentsBloc *bloc = argument;
+    unsigned int retenue = 0, chiffre;
+    int i, propage = 1;
+    for (i = bloc->debut; i < bloc->fin; i++) {
+        unsigned int b = i < bloc->nb ? bloc->b[i] : 0;
+        if (bloc->soustraire) {
+            if (bloc->a[i] >= b + retenue) {
+                chiffre = bloc->a[i] - b - retenue;
+                retenue = 0;
+            }
+            else {
+                chiffre = bloc->a[i] + BASE_TRANCHE - b - retenue;
+                retenue = 1;
+            }
+            propage &= chiffre == 0;
+        }
+        else {
+            chiffre = bloc->a[i] + b + retenue; // Au plus 2 * 10^9 - 1: pas de débordement sur 32 bits.
+            retenue = chiffre >= BASE_TRANCHE;
+            if (retenue)
+                chiffre -= BASE_TRANCHE;
+            propage &= chiffre == BASE_TRANCHE - 1;
+        }
+        bloc->resultat[i] = chiffre;
+    }
+    bloc->genere = (int) retenue;
+    bloc->propage = propage;
+}
+
+void correctionBlocTache(void *argument) {
+    argumentsBloc *bloc = argument;
+    int i;
+    for (i = bloc->debut; i < bloc->fin; i++) { // S'arrête à la première tranche qui absorbe la retenue.
+        if (bloc->soustraire) {
+            if (bloc->resultat[i]--)
+                break;
+            bloc->resultat[i] = BASE_TRANCHE - 1;
+        }
+        else {
+            if (++bloc->resultat[i] < BASE_TRANCHE)
+                break;
+            bloc->resultat[i] = 0;
+        }
+    }
+}
+/* ARBRES D'EXPRESSION */
+
+num** precalculerLigne(memoire *mem, char **mots, int nombreMots) {
+    arbre a;
+    num **precalcules = NULL;
+    int i;
+
+    if (threadsCalcul() <= 1 || construireArbre(mem, mots, nombreMots, &a))
+        return NULL;
+    for (i = 0; i < a.nombreRacines && !a.noeuds[a.racines[i]].fourche; i++)
+        ;
+    // Rien à gagner si aucune opération n'a deux opérandes assez coûteux pour être calculés en parallèle.
+    if (i < a.nombreRacines && (precalcules = calloc((size_t) nombreMots, sizeof(num*)))) {
+        TRACE_DEBUT("arbre", -1, -1, NULL, NULL);
+        // Les noeuds partagés d'abord: les sous-arbres qui les relisent ne font ensuite que les lire.
+        for (i = 0; i < a.nombreNoeuds; i++)
+            if (a.noeuds[i].utilisations > 1)
+                calculerNoeud(&a, i);
+        for (i = 0; i < a.nombreRacines; i++)
+            calculerNoeud(&a, a.racines[i]);
+        TRACE_FIN("arbre");
+        for (i = 0; i < a.nombreNoeuds; i++) { // Les résultats passent à l'évaluation. len, qui ne coûte rien, est refait.
+            if (a.noeuds[i].operateur && a.noeuds[i].operateur != 'l') {
+                precalcules[a.noeuds[i].mot] = a.noeuds[i].valeur;
+                a.noeuds[i].valeur = NULL;
+            }
+        }
+    }
+    detruireArbre(&a);
+    return precalcules;
+}
+
+void libererPrecalcules(num **precalcules, int nombreMots) {
+    int i;
+    for (i = 0; i < nombreMots; i++)
+        if (precalcules[i])
+            deleteNumber(precalcules[i]);
+    free(precalcules);
+}
+
+int construireArbre(memoire *mem, char **mots, int nombreMots, arbre *a) {
+    size_t taille = (size_t) (nombreMots ? nombreMots : 1);
+    int hauteur = 0, nombreAffectes = 0, i, j;
+    // Pile des opérandes: noeud et premier noeud de son sous-arbre.
+    int *operandes = malloc(sizeof(int) * taille), *debuts = malloc(sizeof(int) * taille);
+    int *affectes = malloc(sizeof(int) * 2 * taille); // Mot =x et noeud affecté, par paire.
+    memoire vide; // Les littéraux sont lus comme par l'évaluation, sans buffer ni pile.
+    pile pileVide;
+    initMem(&vide);
+    initPile(&pileVide);
+
+    a->noeuds = malloc(sizeof(noeudArbre) * taille);
+    a->nombreNoeuds = a->nombreRacines = 0;
+    a->racines = operandes;
+    if (!operandes || !debuts || !affectes || !a->noeuds)
+        goto echecArbre;
+
+    for (i = 0; i < nombreMots; i++) {
+        char *mot = mots[i][0] == ':' ? mots[i] + 1 : mots[i]; // :=c s'évalue comme =c.
+        noeudArbre *n = &a->noeuds[a->nombreNoeuds];
+        n->operateur = 0;
+        n->gauche = n->droite = -1;
+        n->debut = a->nombreNoeuds;
+        n->mot = i;
+        n->utilisations = n->fait = n->fourche = 0;
+        n->valeur = NULL;
+        n->cout = 0;
+        if (mot[0] == '=' && validOpUn(mot)) { // Affectation: le noeud reste sur la pile, la suite peut le relire.
+            if (!hauteur)
+                goto echecArbre;
+            affectes[2 * nombreAffectes] = i;
+            affectes[2 * nombreAffectes++ + 1] = operandes[hauteur - 1];
+            continue;
+        }
+        if (validLiteral(mot)) {
+            if (mot[0] == '$')
+                n->valeur = resultatHistorique(mem, mot);
+            else if (mot[0] < '0' || mot[0] > '9') {
+                for (j = nombreAffectes - 1; j >= 0; j--) {
+                    char *affecte = mots[affectes[2 * j]];
+                    if (!strcmp(affecte + (affecte[0] == ':') + 1, mot))
+                        break;
+                }
+                if (j >= 0) { // Relue après =x dans la ligne: le noeud affecté, sans nouveau noeud.
+                    operandes[hauteur] = affectes[2 * j + 1];
+                    debuts[hauteur++] = a->nombreNoeuds;
+                    a->noeuds[affectes[2 * j + 1]].utilisations++;
+                    continue;
+                }
+                variable *var = rechercherVar(mem, mot, empreinteNom(mot));
+                if (!var || (var->formule && (formulesDifferees || var->formule->erreur)))
+                    goto echecArbre; // Erreur, ou formule qui serait réévaluée à sa lecture.
+                n->valeur = var->nombre;
+            }
+            else
+                n->valeur = transformationStructure(&vide, mem, &pileVide, mot);
+            if (!n->valeur)
+                goto echecArbre;
+            n->fait = 1;
+            n->chiffres = findLenNum(n->valeur);
+        }
+        else if (validOpBin(mot) || (validOpUn(mot) && mot[0] != '?')) {
+            int binaire = validOpBin(mot) != 0;
+            if (hauteur < 1 + binaire)
+                goto echecArbre;
+            n->operateur = mot[0];
+            if (binaire)
+                n->droite = operandes[--hauteur];
+            n->gauche = operandes[--hauteur];
+            n->debut = debuts[hauteur];
+            noeudArbre *g = &a->noeuds[n->gauche], *d = binaire ? &a->noeuds[n->droite] : NULL;
+            double cg = g->chiffres, cd = d ? d->chiffres : 0;
+            n->cout = g->cout + (d ? d->cout : 0);
+            switch (n->operateur) { // Ordres de grandeur: Karatsuba pour * et sqrt, Lehmer pour gcd.
+                case '+': n->chiffres = (cg > cd ? cg : cd) + 1; n->cout += cg + cd; break;
+                case '-': n->chiffres = cg > cd ? cg : cd; n->cout += cg + cd; break;
+                case '*': n->chiffres = cg + cd; n->cout += pow(cg + cd, 1.585); break;
+                case 'g': n->chiffres = cg < cd ? cg : cd; n->cout += (cg + cd) * (cg + cd) / 9; break;
+                case 'h': n->chiffres = cg; n->cout += cg; break;
+                case 's': n->chiffres = (cg + 1) / 2; n->cout += 4 * pow(cg, 1.585); break;
+                case 'l': n->chiffres = 10; n->cout += cg; break;
+                default: // !: n < 10^cg, soit au plus cg 10^cg chiffres, calculés par découpage binaire.
+                    n->chiffres = cg > 9 ? 1e18 : cg * pow(10, cg);
+                    n->cout += pow(n->chiffres, 1.585);
+                    break;
+            }
+            n->fourche = g->fourche || (d && (d->fourche || (g->cout >= SEUIL_ARBRE && d->cout >= SEUIL_ARBRE)));
+            g->utilisations++;
+            if (d)
+                d->utilisations++;
+        }
+        else
+            goto echecArbre; // Commande, ? (compteur de référence, qui dépend de l'ordre) ou mot invalide.
+        operandes[hauteur] = a->nombreNoeuds;
+        debuts[hauteur++] = a->nombreNoeuds++;
+    }
+    for (i = 0; i < hauteur; i++) // Les noeuds restés sur la pile: une racine, ou plusieurs si la ligne est fausse.
+        a->noeuds[operandes[i]].utilisations++;
+    a->nombreRacines = hauteur;
+    free(debuts);
+    free(affectes);
+    return 0;
+
+    echecArbre:
+    if (debuts)
+        free(debuts);
+    if (affectes)
+        free(affectes);
+    detruireArbre(a);
+    return 1;
+}
+
+void calculerNoeud(arbre *a, int indice) {
+    noeudArbre *n = &a->noeuds[indice];
+    int i;
+    if (n->fait)
+        return;
+    if (!n->fourche) { // Rien à partager dans ce sous-arbre: ses noeuds sont calculés dans l'ordre de la ligne.
+        for (i = n->debut; i <= indice; i++)
+            if (!a->noeuds[i].fait)
+                calculerValeur(a, i);
+        return;
+    }
+    noeudArbre *g = &a->noeuds[n->gauche], *d = n->droite >= 0 ? &a->noeuds[n->droite] : NULL;
+    if (d && !g->fait && !d->fait && g->cout >= SEUIL_ARBRE && d->cout >= SEUIL_ARBRE) {
+        // Le moins coûteux des deux est confié à une tâche, que prendra un thread libre ou ce thread en l'attendant.
+        tacheArbre argument = {a, g->cout < d->cout ? n->gauche : n->droite};
+        tache t = {noeudTache, &argument, 0, NULL, 0};
+        soumettreTache(&t);
+        calculerNoeud(a, g->cout < d->cout ? n->droite : n->gauche);
+        attendreTache(&t);
+    }
+    else {
+        calculerNoeud(a, n->gauche);
+        if (d)
+            calculerNoeud(a, n->droite);
+    }
+    calculerValeur(a, indice);
+}
+
+void calculerValeur(arbre *a, int indice) {
+    noeudArbre *n = &a->noeuds[indice];
+    num *gauche = a->noeuds[n->gauche].valeur, *droite = n->droite >= 0 ? a->noeuds[n->droite].valeur : NULL;
+    n->fait = 1;
+    if (!gauche || (n->droite >= 0 && !droite))
+        return; // Un opérande n'a pas pu être calculé: l'évaluation refera l'opération et trouvera l'erreur.
+    switch (n->operateur) {
+        case '!':
+        case 's':
+            if (!gauche->negatif || !gauche->chiffres)
+                n->valeur = n->operateur == '!' ? factorielle(gauche) : racineCarree(gauche);
+            break;
+        case 'l': { // Seul son nombre de chiffres compte pour la suite: la valeur est refaite par l'évaluation.
+            char str[16];
+            int chiffres = findLenNum(gauche);
+            memoire vide;
+            pile pileVide;
+            initMem(&vide);
+            initPile(&pileVide);
+            sprintf(str, "%d", chiffres ? chiffres : 1);
+            n->valeur = transformationStructure(&vide, &vide, &pileVide, str);
+            break;
+        }
+        case 'h':
+            if (droite->negatif && droite->chiffres)
+                break; // head: k négatif.
+            /* FALLTHROUGH */
+        default:
+            n->valeur = evaluerOpBin(gauche, droite, n->operateur);
+            break;
+    }
+}
+
+void noeudTache(void *argument) {
+    tacheArbre *t = argument;
+    calculerNoeud(t->a, t->noeud);
+}
+
+void detruireArbre(arbre *a) {
+    int i;
+    if (a->noeuds) {
+        for (i = 0; i < a->nombreNoeuds; i++)
+            if (a->noeuds[i].valeur && !a->noeuds[i].valeur->compteurRef)
+                deleteNumber(a->noeuds[i].valeur);
+        free(a->noeuds);
+    }
+    if (a->racines)
+        free(a->racines);
+}
+
+num* prendrePrecalcule(void) {
+    num *resultat = resultatPrecalcule;
+    resultatPrecalcule = NULL;
+    return resultat;
+}
+
+void multiplicationBasique(unsigned int *a, int na, unsigned int *b, int nb, unsigned int *resultat) {
+    int i, j;
+    for (i = 0; i < na; i++) {
+        unsigned long long retenue = 0, chiffreA = a[i];
+        if (!chiffreA)
+            continue;
+        for (j = 0; j < nb; j++) {
+            unsigned long long t = resultat[i + j] + chiffreA * b[j] + retenue;
+            resultat[i + j] = (unsigned int) (t % BASE_TRANCHE);
+            retenue = t / BASE_TRANCHE;
+        }
+        resultat[i + nb] = (unsigned int) retenue;
+    }
+}
+
+unsigned int ajouterTableau(unsigned int *r, int nr, unsigned int *a, int na) {
+    unsigned int retenue = 0;
+    int i;
+    for (i = 0; i < na; i++) {
+        unsigned int s = r[i] + a[i] + retenue;
+        retenue = s >= BASE_TRANCHE;
+        r[i] = retenue ? s - BASE_TRANCHE : s;
+    }
+    for (; retenue && i < nr; i++) { // Propagation de la retenue
+        r[i]++;
+        retenue = r[i] == BASE_TRANCHE;
+        if (retenue)
+            r[i] = 0;
+    }
+    return retenue;
+}
+
+unsigned int soustraireTableau(unsigned int *r, int nr, unsigned int *a, int na) {
+    unsigned int emprunt = 0;
+    int i;
+    for (i = 0; i < na; i++) {
+        unsigned int soustrait = a[i] + emprunt;
+        emprunt = r[i] < soustrait;
+        r[i] = emprunt ? r[i] + BASE_TRANCHE - soustrait : r[i] - soustrait;
+    }
+    for (; emprunt && i < nr; i++) { // Propagation de l'emprunt
+        emprunt = r[i] == 0;
+        r[i] = emprunt ? BASE_TRANCHE - 1 : r[i] - 1;
+    }
+    return emprunt;
+}
+
+int produitIntervalle(unsigned int debut, unsigned int fin, tranches *resultat) {
+    if (fin - debut < 16) { // Petits intervalles: multiplications successives par un entier < 10^9.
+        unsigned int k;
+        if (allouerTranches(resultat, (int) (fin - debut) + 2))
+            return 1;
+        resultat->valeurs[0] = 1;
+        resultat->longueur = 1;
+        for (k = debut; k <= fin; k++) {
+            unsigned long long retenue = 0;
+            int i;
+            for (i = 0; i < resultat->longueur; i++) {
+                retenue += (unsigned long long) resultat->valeurs[i] * k;
+                resultat->valeurs[i] = (unsigned int) (retenue % BASE_TRANCHE);
+                retenue /= BASE_TRANCHE;
+            }
+            if (retenue)
+                resultat->valeurs[resultat->longueur++] = (unsigned int) retenue;
+        }
+        return 0;
+    }
+
+    // Découpage binaire: les deux moitiés ont des tailles voisines, ce qui profite à Karatsuba.
+    tranches gauche, droite;
+    if (calculInterrompu())
+        return 1;
+    unsigned int milieu = debut + (fin - debut) / 2;
+    if (produitIntervalle(debut, milieu, &gauche))
+        return 1;
+    if (produitIntervalle(milieu + 1, fin, &droite)) {
+        libererTranches(&gauche);
+        return 1;
+    }
+    int erreur = multiplicationTranches(&gauche, &droite, resultat);
+    libererTranches(&gauche);
+    libererTranches(&droite);
+    return erreur;
+}
+
+int racineTranches(tranches *n, tranches *racine) {
+    tranches haut, x, y, quotient, carre;
+    unsigned int un = 1;
+    int k, i, fin;
+
+    if (n->longueur <= 2) { // n < 10^18: estimation en virgule flottante corrigée sur des entiers machine.
+        unsigned long long valeur = (n->longueur > 0 ? n->valeurs[0] : 0) + (n->longueur > 1 ? (unsigned long long) n->valeurs[1] * BASE_TRANCHE : 0);
+        unsigned long long r = (unsigned long long) sqrt((double) valeur);
+        while (r * r > valeur)
+            r--;
+        while ((r + 1) * (r + 1) <= valeur)
+            r++;
+        if (allouerTranches(racine, 2))
+            return 1;
+        racine->valeurs[0] = (unsigned int) (r % BASE_TRANCHE);
+        racine->valeurs[1] = (unsigned int) (r / BASE_TRANCHE);
+        normaliserTranches(racine);
+        return 0;
+    }
+
+    // On calcule r = racine(n / B^2k) sur les tranches de poids fort, puis x = (r + 1) * B^k est une estimation
+    // par excès de racine(n) dont la moitié des tranches est juste: une itération de Newton suffit le plus souvent.
+    k = n->longueur / 4 > 0 ? n->longueur / 4 : 1;
+    haut.longueur = n->longueur - 2 * k;
+    haut.valeurs = n->valeurs + 2 * k; // Simple vue sur les tranches de poids fort, sans copie.
+    if (racineTranches(&haut, &y))
+        return 1;
+    if (allouerTranches(&x, k + y.longueur + 1)) {
+        libererTranches(&y);
+        return 1;
+    }
+    memcpy(x.valeurs + k, y.valeurs, sizeof(unsigned int) * (size_t) y.longueur);
+    ajouterTableau(x.valeurs + k, y.longueur + 1, &un, 1);
+    normaliserTranches(&x);
+    libererTranches(&y);
+
+    while (1) { // Newton par excès: y = (x + n / x) / 2 décroît vers la partie entière de la racine, sans la dépasser.
+        if (calculInterrompu() || quotientTranches(n, &x, &quotient)) {
+            libererTranches(&x);
+            return 1;
+        }
+        if (allouerTranches(&y, (x.longueur > quotient.longueur ? x.longueur : quotient.longueur) + 1)) {
+            libererTranches(&x);
+            libererTranches(&quotient);
+            return 1;
+        }
+        memcpy(y.valeurs, x.valeurs, sizeof(unsigned int) * (size_t) x.longueur);
+        ajouterTableau(y.valeurs, y.longueur, quotient.valeurs, quotient.longueur);
+        libererTranches(&quotient);
+        unsigned long long reste = 0;
+        for (i = y.longueur - 1; i >= 0; i--) {
+            reste = reste * BASE_TRANCHE + y.valeurs[i];
+            y.valeurs[i] = (unsigned int) (reste / 2);
+            reste %= 2;
+        }
+        normaliserTranches(&y);
+        libererTranches(&x);
+        x = y;
+        // x ne descend pas sous la racine entière: il l'a atteinte dès que x * x <= n, ce qu'un carré vérifie pour bien
+        // moins cher qu'une division supplémentaire.
+        if (multiplicationTranches(&x, &x, &carre)) {
+            libererTranches(&x);
+            return 1;
+        }
+        fin = comparerTranches(&carre, n) <= 0;
+        libererTranches(&carre);
+        if (fin)
+            break;
+    }
+    *racine = x;
+    return 0;
+}
+
+int changerBase(tranches *source, int versMots, tranches *resultat) {
+    tranches puissances[32];
+    int nombre = 1, i, erreur = 1;
+    for (i = 0; i < 32; i++)
+        puissances[i].valeurs = NULL;
+
+    normaliserTranches(source);
+    if (allouerTranches(&puissances[0], 2))
+        return 1;
+    if (versMots) { // 10^9 en base 2^32
+        puissances[0].valeurs[0] = BASE_TRANCHE;
+        puissances[0].longueur = 1;
+    }
+    else { // 2^32 = 4 * 10^9 + 294967296 en base 10^9
+        puissances[0].valeurs[0] = 294967296u;
+        puissances[0].valeurs[1] = 4;
+    }
+    while (source->longueur > SEUIL_CONVERSION && (1 << nombre) < source->longueur) {
+        if (versMots ? multiplicationMots(&puissances[nombre - 1], &puissances[nombre - 1], &puissances[nombre])
+                     : multiplicationTranches(&puissances[nombre - 1], &puissances[nombre - 1], &puissances[nombre]))
+            goto deleteChangerBase;
+        nombre++;
+    }
+    erreur = convertirBase(source->valeurs, source->longueur, puissances, versMots, resultat);
+
+    deleteChangerBase:
+    for (i = 0; i < nombre; i++)
+        libererTranches(&puissances[i]);
+    return erreur;
+}
+
+int convertirBase(unsigned int *valeurs, int n, tranches *puissances, int versMots, tranches *resultat) {
+    int i, j;
+    while (n && !valeurs[n - 1])
+        n--;
+
+    if (n <= SEUIL_CONVERSION) {
+        // Horner: resultat = resultat * base d'origine + valeur, du poids fort au poids faible. Un mot de 32 bits tient
+        // dans deux tranches, et une tranche dans un mot.
+        if (allouerTranches(resultat, 2 * n + 1))
+            return 1;
+        int longueur = 0;
+        for (i = n - 1; i >= 0; i--) {
+            unsigned long long retenue = valeurs[i];
+            for (j = 0; j < longueur; j++) {
+                unsigned long long t;
+                if (versMots) {
+                    t = (unsigned long long) resultat->valeurs[j] * BASE_TRANCHE + retenue;
+                    resultat->valeurs[j] = (unsigned int) t;
+                    retenue = t >> 32;
+                }
+                else {
+                    t = ((unsigned long long) resultat->valeurs[j] << 32) + retenue;
+                    resultat->valeurs[j] = (unsigned int) (t % BASE_TRANCHE);
+                    retenue = t / BASE_TRANCHE;
+                }
+            }
+            for (; retenue; longueur++) {
+                resultat->valeurs[longueur] = versMots ? (unsigned int) retenue : (unsigned int) (retenue % BASE_TRANCHE);
+                retenue = versMots ? retenue >> 32 : retenue / BASE_TRANCHE;
+            }
+        }
+        resultat->longueur = longueur;
+        return 0;
+    }
+
+    // valeurs = haut * B^h + bas, avec h la plus grande puissance de 2 inférieure à n: B^h est puissances[j].
+    for (j = 0; (1 << (j + 1)) < n; j++);
+    int h = 1 << j;
+    tranches bas, haut, produit;
+    bas.valeurs = haut.valeurs = produit.valeurs = NULL;
+    if (convertirBase(valeurs, h, puissances, versMots, &bas) || convertirBase(valeurs + h, n - h, puissances, versMots, &haut)
+        || (versMots ? multiplicationMots(&haut, &puissances[j], &produit) : multiplicationTranches(&haut, &puissances[j], &produit))
+        || allouerTranches(resultat, produit.longueur + 1)) {
+        libererTranches(&bas);
+        libererTranches(&haut);
+        libererTranches(&produit);
+        return 1; // Out of memory
+    }
+    // haut n'est pas nul (n est normalisé) et B^h > bas: le produit a au moins autant de valeurs que bas.
+    memcpy(resultat->valeurs, produit.valeurs, sizeof(unsigned int) * (size_t) produit.longueur);
+    if (versMots)
+        ajouterMots(resultat->valeurs, resultat->longueur, bas.valeurs, bas.longueur);
+    else
+        ajouterTableau(resultat->valeurs, resultat->longueur, bas.valeurs, bas.longueur);
+    normaliserTranches(resultat);
+    libererTranches(&bas);
+    libererTranches(&haut);
+    libererTranches(&produit);
+    return 0;
+}
+
+int multiplicationMots(tranches *a, tranches *b, tranches *resultat) {
+    if (allouerTranches(resultat, a->longueur + b->longueur))
+        return 1;
+    if (a->longueur && b->longueur && multiplicationTableauxMots(a->valeurs, a->longueur, b->valeurs, b->longueur, resultat->valeurs)) {
+        libererTranches(resultat);
+        return 1;
+    }
+    normaliserTranches(resultat);
+    return 0;
+}
+
+int multiplicationTableauxMots(unsigned int *a, int na, unsigned int *b, int nb, unsigned int *resultat) {
+    unsigned int *temp;
+    int i;
+
+    if (na < nb) { // a est toujours le plus long des deux
+        temp = a; a = b; b = temp;
+        i = na; na = nb; nb = i;
+    }
+    memset(resultat, 0, sizeof(unsigned int) * (size_t) (na + nb));
+    if (nb < SEUIL_KARATSUBA) {
+        multiplicationBasiqueMots(a, na, b, nb, resultat);
+        return 0;
+    }
+    if (na == nb)
+        return karatsubaMots(a, b, na, resultat);
+
+    // Longueurs déséquilibrées: on découpe a en blocs de nb mots, chacun multiplié par b.
+    temp = malloc(sizeof(unsigned int) * 2 * (size_t) nb);
+    if (!temp)
+        return 1; // Out of memory
+    for (i = 0; i < na; i += nb) {
+        int longueurBloc = na - i < nb ? na - i : nb;
+        if ((longueurBloc == nb ? karatsubaMots(a + i, b, nb, temp) : multiplicationTableauxMots(a + i, longueurBloc, b, nb, temp))) {
+            free(temp);
+            return 1;
+        }
+        ajouterMots(resultat + i, na + nb - i, temp, longueurBloc + nb);
+    }
+    free(temp);
+    return 0;
+}
+
+int karatsubaMots(unsigned int *a, unsigned int *b, int n, unsigned int *resultat) {
+    if (n < SEUIL_KARATSUBA) {
+        memset(resultat, 0, sizeof(unsigned int) * 2 * (size_t) n);
+        multiplicationBasiqueMots(a, n, b, n, resultat);
+        return 0;
+    }
+    if (calculInterrompu())
+        return 1;
+
+    // Même découpage que karatsuba, en base 2^32.
+    int h = n / 2, m = n - h;
+    unsigned int *temp = malloc(sizeof(unsigned int) * 4 * (size_t) (m + 1));
+    if (!temp)
+        return 1; // Out of memory
+    unsigned int *sommeA = temp, *sommeB = temp + m + 1, *z1 = temp + 2 * (m + 1);
+
+    memset(sommeA, 0, sizeof(unsigned int) * 2 * (size_t) (m + 1));
+    memcpy(sommeA, a, sizeof(unsigned int) * (size_t) h);
+    memcpy(sommeB, b, sizeof(unsigned int) * (size_t) h);
+    ajouterMots(sommeA, m + 1, a + h, m);
+    ajouterMots(sommeB, m + 1, b + h, m);
+
+    if (karatsubaMots(a, b, h, resultat) || karatsubaMots(a + h, b + h, m, resultat + 2 * h) || karatsubaMots(sommeA, sommeB, m + 1, z1)) {
+        free(temp);
+        return 1;
+    }
+    soustraireMots(z1, 2 * (m + 1), resultat, 2 * h);
+    soustraireMots(z1, 2 * (m + 1), resultat + 2 * h, 2 * m);
+    ajouterMots(resultat + h, 2 * n - h, z1, 2 * (m + 1) < 2 * n - h ? 2 * (m + 1) : 2 * n - h);
+    free(temp);
+    return 0;
+}
+
+void multiplicationBasiqueMots(unsigned int *a, int na, unsigned int *b, int nb, unsigned int *resultat) {
+    int i, j;
+    for (i = 0; i < na; i++) {
+        unsigned long long retenue = 0, motA = a[i];
+        if (!motA)
+            continue;
+        for (j = 0; j < nb; j++) { // Au plus (2^32 - 1) + (2^32 - 1)^2 + (2^32 - 1) = 2^64 - 1.
+            unsigned long long t = resultat[i + j] + motA * b[j] + retenue;
+            resultat[i + j] = (unsigned int) t;
+            retenue = t >> 32;
+        }
+        resultat[i + nb] = (unsigned int) retenue;
+    }
+}
+
+unsigned int ajouterMots(unsigned int *r, int nr, unsigned int *a, int na) {
+    unsigned long long retenue = 0;
+    int i;
+    for (i = 0; i < na; i++) {
+        unsigned long long s = (unsigned long long) r[i] + a[i] + retenue;
+        r[i] = (unsigned int) s;
+        retenue = s >> 32;
+    }
+    for (; retenue && i < nr; i++) // Propagation de la retenue
+        retenue = ++r[i] == 0;
+    return (unsigned int) retenue;
+}
+
+unsigned int soustraireMots(unsigned int *r, int nr, unsigned int *a, int na) {
+    unsigned long long emprunt = 0;
+    int i;
+    for (i = 0; i < na; i++) {
+        unsigned long long d = (unsigned long long) r[i] - a[i] - emprunt;
+        r[i] = (unsigned int) d;
+        emprunt = d >> 63; // Un résultat négatif fait le tour et passe le bit de poids fort à 1.
+    }
+    for (; emprunt && i < nr; i++) // Propagation de l'emprunt
+        emprunt = r[i]-- == 0;
+    return (unsigned int) emprunt;
+}
+
+int literalBinaire(char *literal, num *nombre) {
+    int bits = literal[1] == 'x' ? 4 : 1, parMot = 32 / bits, chiffres = (int) strlen(literal + 2), i;
+    tranches mots, t;
+    num *converti;
+
+    // Les chiffres vont directement dans les mots, du poids faible (fin du littéral) au poids fort.
+    if (allouerTranches(&mots, (chiffres + parMot - 1) / parMot))
+        return 1;
+    for (i = 0; i < chiffres; i++) {
+        char c = literal[2 + chiffres - 1 - i];
+        unsigned int valeur = c <= '9' ? (unsigned int) (c - '0') : (unsigned int) ((c | 0x20) - 'a' + 10);
+        mots.valeurs[i / parMot] |= valeur << (i % parMot * bits);
+    }
+    int erreur = changerBase(&mots, 0, &t);
+    libererTranches(&mots);
+    if (erreur)
+        return 1;
+    converti = tranchesVersNum(&t, 0);
+    libererTranches(&t);
+    if (!converti)
+        return 1;
+    nombre->chiffres = converti->chiffres;
+    free(converti);
+    return 0;
+}
+
+int afficherNombre(FILE *sortie, num *nombre, int base) {
+    if (base == 10) {
+        printNumReverse(sortie, nombre);
+        return 0;
+    }
+
+    tranches t, mots;
+    int bits = base == 16 ? 4 : 1, parMot = 32 / bits, position = 0, premier = 1, i, k;
+    if (numVersTranches(nombre, &t))
+        return 1;
+    int erreur = changerBase(&t, 1, &mots);
+    libererTranches(&t);
+    char *tampon = erreur ? NULL : malloc(CHIFFRES_MORCEAU);
+    if (!tampon) {
+        if (!erreur)
+            libererTranches(&mots);
+        return 1;
+    }
+
+    if (nombre->chiffres && nombre->negatif)
+        fputc('-', sortie);
+    fputs(base == 16 ? "0x" : "0b", sortie);
+    if (!mots.longueur)
+        fputc('0', sortie);
+
+    // Chaque mot donne directement ses chiffres, du poids fort au poids faible, écrits par morceaux.
+    for (i = mots.longueur - 1; i >= 0; i--) {
+        for (k = parMot - 1; k >= 0; k--) {
+            unsigned int chiffre = (mots.valeurs[i] >> (k * bits)) & (unsigned int) (base - 1);
+            if (premier && !chiffre)
+                continue; // Zéros de poids fort du premier mot
+            premier = 0;
+            tampon[position++] = "0123456789abcdef"[chiffre];
+            if (position == CHIFFRES_MORCEAU) {
+                fwrite(tampon, 1, (size_t) position, sortie);
+                position = 0;
+            }
+        }
+    }
+    fwrite(tampon, 1, (size_t) position, sortie);
+    free(tampon);
+    libererTranches(&mots);
+    return 0;
+}
+
+void printRev(FILE *sortie, cell *chiffre) {
+    if (!chiffre)
+        return;
+    printRev(sortie, chiffre->suivant);
+    fputc(chiffre->chiffre, sortie);
+} // Méthode récursive afin d'imprimer un nombre du bits de poids le plus fort au plus faible (ex: 10000)
+
+void printNumReverse(FILE *sortie, num *nombre) {
+    if(!nombre->chiffres) {
+        fputc('0', sortie);
+        return;
+    }
+    if(nombre->negatif)
+        fputc('-', sortie);
+
+    // Pour les grands nombres, la récursion de printRev épuiserait la pile: on inverse les chiffres dans une chaîne.
+    int longueur = findLenNum(nombre);
+    if (longueur > CHIFFRES_MORCEAU && !ecrireParMorceaux(sortie, nombre, longueur))
+        return;
+    char *chaine = malloc((size_t) longueur);
+    if (!chaine) {
+        printRev(sortie, nombre->chiffres);
+        return;
+    }
+    cell *p = nombre->chiffres;
+    int i = longueur;
+    while (p) {
+        chaine[--i] = p->chiffre;
+        p = p->suivant;
+    }
+    fwrite(chaine, 1, (size_t) longueur, sortie);
+    free(chaine);
+} // Ajout du signe du nombre, et impression du poids le plus fort au plus faible.
+
+int ecrireParMorceaux(FILE *sortie, num *nombre, int longueur) {
+    int morceaux = (longueur + CHIFFRES_MORCEAU - 1) / CHIFFRES_MORCEAU, enAttente = 0, k, j;
+    cell **reperes = malloc(sizeof(cell *) * (size_t) morceaux);
+    char *tampon = malloc((size_t) CHIFFRES_MORCEAU * MORCEAUX_ECRITURE);
+    struct iovec vecteurs[MORCEAUX_ECRITURE];
+    if (!reperes || !tampon) {
+        if (reperes) free(reperes);
+        if (tampon) free(tampon);
+        return 1; // Out of memory
+    }
+
+    cell *p = nombre->chiffres;
+    for (k = 0, j = 0; p; p = p->suivant, j++)
+        if (j % CHIFFRES_MORCEAU == 0)
+            reperes[k++] = p;
+
+    // Sur un vrai fichier, ce qui est déjà dans le FILE (le signe, l'invite) part avant les chiffres écrits par writev.
+    int fd = fileno(sortie);
+    if (fd >= 0 && fflush(sortie))
+        fd = -1;
+
+    for (k = morceaux - 1; k >= 0; k--) {
+        int taille = k == morceaux - 1 ? longueur - k * CHIFFRES_MORCEAU : CHIFFRES_MORCEAU;
+        char *morceau = tampon + (size_t) enAttente * CHIFFRES_MORCEAU;
+        for (p = reperes[k], j = taille; j > 0; p = p->suivant)
+            morceau[--j] = p->chiffre;
+        vecteurs[enAttente].iov_base = morceau;
+        vecteurs[enAttente++].iov_len = (size_t) taille;
+        if (enAttente < MORCEAUX_ECRITURE && k)
+            continue;
+        if (fd >= 0) {
+            if (ecrireVecteurs(fd, vecteurs, enAttente))
+                break; // Sortie fermée: inutile de produire le reste.
+        }
+        else
+            for (j = 0; j < enAttente; j++)
+                fwrite(vecteurs[j].iov_base, 1, vecteurs[j].iov_len, sortie);
+        enAttente = 0;
+    }
+    free(reperes);
+    free(tampon);
+    return 0;
+}
+
+int ecrireVecteurs(int fd, struct iovec *vecteurs, int nombre) {
+    while (nombre) {
+        ssize_t ecrits = writev(fd, vecteurs, nombre);
+        if (ecrits < 0) {
+            if (errno == EINTR)
+                continue;
+            return 1;
+        }
+        while (nombre && (size_t) ecrits >= vecteurs->iov_len) {
+            ecrits -= (ssize_t) vecteurs->iov_len;
+            vecteurs++;
+            nombre--;
+        }
+        if (nombre) {
+            vecteurs->iov_base = (char *) vecteurs->iov_base + ecrits;
+            vecteurs->iov_len -= (size_t) ecrits;
+        }
+    }
+    return 0;
+}
+
+int findLenNum(num *nombre) {
+    int longueur = 0;
+    cell* p = nombre->chiffres;
+    while(p) {
+        longueur++;
+        p = p->suivant;
+    }
+    return longueur;
+} // Permet de trouve la longueur d'un nombre en terme de chiffres.
+
+int compareNum(num *nombre1, num *nombre2) { // Renvoie 0 si nombre1 < num2, ou 1 si nombre1 >= num2
+
+    cell* pointeur1 = nombre1->chiffres;
+    cell* pointeur2 = nombre2->chiffres;
+
+    if(!pointeur1 && !pointeur2)
+        return 1; // Cas 0 et 0
+    else if(pointeur1 && !pointeur2) { // cas -13 et 0 et 13 et 0;
+        if (nombre1->negatif)
+            return 0;
+        return 1;
+    }
+    else if(!pointeur1) { // Cas 0 et -13 OU 0 et 13
+        if(nombre2->negatif)
+            return 1;
+        return 0;
+    }
+
+    if(nombre1->negatif && !nombre2->negatif)
+        return 0; // -124 et 12 par exemple
+    else if (!nombre1->negatif && nombre2->negatif)
+        return 1; // 124 et -12 par exemple
+
+    int longueurNum1 = findLenNum(nombre1);
+    int longueurNum2 = findLenNum(nombre2);
+
+    if(longueurNum1 > longueurNum2 && nombre1->negatif && nombre2->negatif)
+        return 0; // Donc -1344 et -35, donc nombre1 < num2
+    else if(longueurNum1 > longueurNum2 && !nombre1->negatif && !nombre2->negatif)
+        return 1; // Donc 1344 et 35
+    else if (longueurNum1 < longueurNum2 && nombre1->negatif && nombre2->negatif)
+        return 1; // Donc -34 et -1344
+    else if (longueurNum1 < longueurNum2 && !nombre1->negatif && !nombre2->negatif)
+        return 0; // Donc 34 et 1344
+
+    // Les deux nombres sont donc de la même taille en longueur, et de même signe. Les chiffres vont du poids faible au
+    // poids fort: en un seul parcours, la dernière différence rencontrée est celle de poids le plus fort.
+    int difference = 0;
+    while(pointeur1) {
+        if (pointeur1->chiffre != pointeur2->chiffre)
+            difference = pointeur1->chiffre > pointeur2->chiffre ? 1 : -1;
+        pointeur1 = pointeur1->suivant;
+        pointeur2 = pointeur2->suivant;
+    }
+    if (!difference)
+        return 1; // Tout est égal, alors 1
+    if (nombre1->negatif)
+        return difference < 0;
+    return difference > 0;
+} // Renvoie 0 si nombre1 < nombre2, ou 1 si nombre1 >= nombre2
+
+int isEqual(num *nombre1, num *nombre2) {
+    if (!nombre1 || !nombre2)
+        return 0;
+    if (nombre1 == nombre2)
+        return 1;
+
+    cell* pointeur1 = nombre1->chiffres;
+    cell* pointeur2 = nombre2->chiffres;
+
+    if (pointeur1 && nombre1->negatif != nombre2->negatif)
+        return 0;
+
+    // L'égalité ne dépend pas de l'ordre de comparaison: un seul parcours du poids faible au poids fort suffit.
+    while (pointeur1 && pointeur2) {
+        if (pointeur1->chiffre != pointeur2->chiffre)
+            return 0;
+        pointeur1 = pointeur1->suivant;
+        pointeur2 = pointeur2->suivant;
+    }
+    return !pointeur1 && !pointeur2;
+} // Renvoie 1 si num1 == num2,
+
+cell* checkTailNum(num *nombre) {
+    cell* temp = nombre->chiffres;
+    if(!temp)
+        return NULL;
+    while(temp->suivant)
+        temp = temp->suivant;
+    return temp;
+} // checkTailNum retourne le bit de poids le plus fort d'un num.
+
+int addHeadNum(num *nombre, char chiffre) {
+    cell *nouveau_chiffre = malloc(sizeof(cell));
+    if (!nouveau_chiffre)
+        return 1;
+    nouveau_chiffre->chiffre = chiffre;
+    nouveau_chiffre->suivant = nombre->chiffres;
+    nombre->chiffres = nouveau_chiffre;
+    return 0;
+} // Ajoute un chiffre au poids le plus faible du nombre (dans le cas de la multiplication, 0)
+
+int addTailNum(num *nombre, char chiffre) {   // Ajouter un nombre au poid le plus fort.
+    cell *nouveau_chiffre = malloc(sizeof(cell));
+    if (!nouveau_chiffre)
+        return 1; // Out of memory
+
+    nouveau_chiffre->chiffre = chiffre;
+    if(!nombre->chiffres) {
+        nouveau_chiffre->suivant = nombre->chiffres;  // on pointe le noeud tête
+        nombre->chiffres = nouveau_chiffre; // Ajout du noeud dans la liste
+    }
+    else {
+        cell* p = nombre->chiffres;
+        while(p->suivant)
+            p = p->suivant;
+        p->suivant = nouveau_chiffre; // Suivant pointe sur le nouveau chiffre;
+        nouveau_chiffre->suivant = NULL;
+    }
+    return 0;
+} // Ajoute un chiffre de poids le plus fort au nombre. Utilisé dans les opérations.
+
+void deleteTailNum(num *nombre) {
+    cell* temp;
+    cell* p = nombre->chiffres;
+    if (!p)
+        return;
+    else if (!p->suivant) {
+        free(p);
+        nombre->chiffres = NULL;
+    }
+    else {
+        while(p->suivant->suivant)
+            p = p->suivant;
+        temp = p->suivant;
+        p->suivant = NULL;
+        free(temp);
+    }
+}
+
+void deleteNumber(num *nombre) {
+    if (!nombre) return;
+    cell* p = nombre->chiffres;
+    cell* suivant;
+    while (p)
+    {
+        suivant = p->suivant;
+        free(p);
+        p = suivant;
+    }
+    free(nombre);
+}
+
+void deleteChiffres(num *nombre) {
+    if (!nombre) return;
+    cell* p = nombre->chiffres;
+    cell* suivant;
+    while (p)
+    {
+        suivant = p->suivant;
+        free(p);
+        p = suivant;
+    }
+}
+
+int copyNum(num* srcNum, num* destNum) {
+    if (!srcNum)
+        return 1; // Out of memory
+
+    destNum->chiffres = NULL;
+    destNum->negatif = srcNum->negatif;
+    cell *p = srcNum->chiffres;
+    cell **queue = &destNum->chiffres; // On garde la queue: addTailNum reparcourrait tout le nombre à chaque chiffre.
+    while(p) {
+        cell *nouveau_chiffre = malloc(sizeof(cell));
+        if (!nouveau_chiffre)
+            return 1; // Out of memory
+        nouveau_chiffre->chiffre = p->chiffre;
+        nouveau_chiffre->suivant = NULL;
+        *queue = nouveau_chiffre;
+        queue = &nouveau_chiffre->suivant;
+        p = p->suivant;
+    }
+    return 0; // OK
+}
+
+num* checkMem(num *nombre, memoire* mem) {
+    STATS_COMPTER(stats.recherchesMem);
+    if (!mem->nombreValeurs)
+        return NULL;
+    TRACE_DEBUT("checkMem", findLenNum(nombre), -1, NULL, NULL);
+    unsigned long long empreinte = empreinteNombre(nombre);
+    int masque = mem->capaciteValeurs - 1, i = CASE_EMPREINTE(empreinte, mem->capaciteValeurs);
+    for (; mem->valeurs[i].nombre; i = (i + 1) & masque) {
+        if (mem->valeurs[i].empreinte == empreinte && isEqual(nombre, mem->valeurs[i].nombre)) {
+            STATS_COMPTER(stats.trouvesMem);
+            TRACE_FIN("checkMem");
+            return mem->valeurs[i].nombre; // On a trouvé un nombre égal à num1 dans la mémoire
+        }
+    }
+    TRACE_FIN("checkMem");
+    return NULL;
+}
+
+void initMem(memoire *mem) {
+    mem->entrees = NULL;
+    mem->nombreVariables = mem->capaciteEntrees = 0;
+    mem->indices = NULL;
+    mem->capaciteIndices = 0;
+    mem->valeurs = NULL;
+    mem->nombreValeurs = mem->capaciteValeurs = 0;
+    mem->baseSortie = 10;
+    mem->historique = NULL;
+    mem->debutHistorique = mem->nombreHistorique = mem->capaciteHistorique = 0;
+    mem->premierHistorique = 1;
+    mem->octetsHistorique = 0;
+    mem->limiteHistorique = LIMITE_HISTORIQUE;
+    mem->horloge = 0;
+    mem->nombreFormules = 0;
+}
+
+unsigned long long empreinteNom(const char *nom) {
+    unsigned long long empreinte = 0xcbf29ce484222325ULL;
+    while (*nom)
+        empreinte = (empreinte ^ (unsigned char) *nom++) * 0x100000001b3ULL;
+    return empreinte;
+}
+
+unsigned long long empreinteNombre(num *nombre) {
+    unsigned long long empreinte = 0xcbf29ce484222325ULL;
+    cell *p = nombre->chiffres;
+    if (p && nombre->negatif) // Comme isEqual, le signe de zéro ne compte pas.
+        empreinte = (empreinte ^ '-') * 0x100000001b3ULL;
+    for (; p; p = p->suivant)
+        empreinte = (empreinte ^ (unsigned char) p->chiffre) * 0x100000001b3ULL;
+    return empreinte;
+}
+
+variable* rechercherVar(memoire* mem, const char *nom, unsigned long long empreinte) { // Retourne la variable si présente
+    if (!mem->nombreVariables)
+        return NULL;
+    int masque = mem->capaciteIndices - 1, i = CASE_EMPREINTE(empreinte, mem->capaciteIndices);
+    for (; mem->indices[i]; i = (i + 1) & masque) {
+        variable *ptr = &mem->entrees[mem->indices[i] - 1];
+        if (ptr->empreinte == empreinte && !strcmp(ptr->nom, nom))
+            return ptr;
+    }
+    return NULL;
+}
+
+int reserverMem(memoire *mem, int supplementaires) {
+    int variables = mem->nombreVariables + supplementaires, valeurs = mem->nombreValeurs + supplementaires, i, j;
+    int capaciteEntrees = mem->capaciteEntrees, capaciteIndices = mem->capaciteIndices, capaciteValeurs = mem->capaciteValeurs;
+    while (capaciteEntrees < variables)
+        capaciteEntrees = capaciteEntrees ? 2 * capaciteEntrees : 4;
+    while (capaciteIndices < 2 * variables)
+        capaciteIndices = capaciteIndices ? 2 * capaciteIndices : 8;
+    while (capaciteValeurs < 2 * valeurs)
+        capaciteValeurs = capaciteValeurs ? 2 * capaciteValeurs : 8;
+
+    // Tout est alloué avant de toucher aux tables: en cas d'échec, la mémoire reste intacte.
+    variable *entrees = mem->entrees;
+    int *indices = mem->indices;
+    valeur *tableValeurs = mem->valeurs;
+    if (capaciteEntrees != mem->capaciteEntrees)
+        entrees = malloc(sizeof(variable) * (size_t) capaciteEntrees);
+    if (capaciteIndices != mem->capaciteIndices)
+        indices = calloc((size_t) capaciteIndices, sizeof(int));
+    if (capaciteValeurs != mem->capaciteValeurs)
+        tableValeurs = calloc((size_t) capaciteValeurs, sizeof(valeur));
+    if ((!entrees && capaciteEntrees) || (!indices && capaciteIndices) || (!tableValeurs && capaciteValeurs)) {
+        if (entrees != mem->entrees) free(entrees);
+        if (indices != mem->indices) free(indices);
+        if (tableValeurs != mem->valeurs) free(tableValeurs);
+        return 1; // Out of memory
+    }
+
+    if (entrees != mem->entrees) {
+        if (mem->nombreVariables)
+            memcpy(entrees, mem->entrees, sizeof(variable) * (size_t) mem->nombreVariables);
+        free(mem->entrees);
+        mem->entrees = entrees;
+        mem->capaciteEntrees = capaciteEntrees;
+    }
+    if (indices != mem->indices) { // Les empreintes sont conservées: rien n'est recalculé.
+        for (i = 0; i < mem->nombreVariables; i++) {
+            for (j = CASE_EMPREINTE(mem->entrees[i].empreinte, capaciteIndices); indices[j]; j = (j + 1) & (capaciteIndices - 1));
+            indices[j] = i + 1;
+        }
+        free(mem->indices);
+        mem->indices = indices;
+        mem->capaciteIndices = capaciteIndices;
+    }
+    if (tableValeurs != mem->valeurs) {
+        for (i = 0; i < mem->capaciteValeurs; i++) {
+            if (!mem->valeurs[i].nombre)
+                continue;
+            for (j = CASE_EMPREINTE(mem->valeurs[i].empreinte, capaciteValeurs); tableValeurs[j].nombre; j = (j + 1) & (capaciteValeurs - 1));
+            tableValeurs[j] = mem->valeurs[i];
+        }
+        free(mem->valeurs);
+        mem->valeurs = tableValeurs;
+        mem->capaciteValeurs = capaciteValeurs;
+    }
+    return 0;
+}
+
+int trouverValeur(memoire *mem, num *nombre, unsigned long long empreinte) {
+    if (!mem->capaciteValeurs)
+        return -1;
+    int masque = mem->capaciteValeurs - 1, i = CASE_EMPREINTE(empreinte, mem->capaciteValeurs);
+    for (; mem->valeurs[i].nombre; i = (i + 1) & masque)
+        if (mem->valeurs[i].nombre == nombre)
+            return i;
+    return -1;
+}
+
+void compterValeur(memoire *mem, num *nombre, unsigned long long empreinte, int variables) {
+    int masque = mem->capaciteValeurs - 1, i = trouverValeur(mem, nombre, empreinte), j, k;
+    if (i < 0) { // Premier détenteur: nouvelle case (la place a été réservée).
+        for (i = CASE_EMPREINTE(empreinte, mem->capaciteValeurs); mem->valeurs[i].nombre; i = (i + 1) & masque);
+        mem->valeurs[i].nombre = nombre;
+        mem->valeurs[i].empreinte = empreinte;
+        mem->valeurs[i].variables = 0;
+        mem->nombreValeurs++;
+    }
+    mem->valeurs[i].variables += variables;
+    if (mem->valeurs[i].variables)
+        return;
+
+    // Plus aucune variable: on retire la case en ramenant les suivantes de la même grappe (pas de case tombée).
+    mem->valeurs[i].nombre = NULL;
+    mem->nombreValeurs--;
+    for (j = (i + 1) & masque; mem->valeurs[j].nombre; j = (j + 1) & masque) {
+        k = CASE_EMPREINTE(mem->valeurs[j].empreinte, mem->capaciteValeurs);
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+            mem->valeurs[i] = mem->valeurs[j];
+            mem->valeurs[j].nombre = NULL;
+            i = j;
+        }
+    }
+}
+
+void ajouterVariable(memoire *mem, char *nom, unsigned long long empreinte, num *nombre, unsigned long long empreinteNombre) {
+    int masque = mem->capaciteIndices - 1, i;
+    variable *ptr = &mem->entrees[mem->nombreVariables++];
+    ptr->nom = nom;
+    ptr->empreinte = empreinte;
+    ptr->nombre = nombre;
+    ptr->empreinteNombre = empreinteNombre;
+    ptr->modifiee = ++mem->horloge;
+    ptr->formule = NULL;
+    ptr->nombre->compteurRef++;
+    for (i = CASE_EMPREINTE(empreinte, mem->capaciteIndices); mem->indices[i]; i = (i + 1) & masque);
+    mem->indices[i] = mem->nombreVariables;
+    compterValeur(mem, nombre, empreinteNombre, 1);
+}
+
+void remplacerNombre(memoire *mem, variable *var, num *nombre, unsigned long long empreinte) {
+    if (var->nombre == nombre)
+        return;
+    compterValeur(mem, var->nombre, var->empreinteNombre, -1);
+    var->nombre->compteurRef--;
+    if (!var->nombre->compteurRef)
+        deleteNumber(var->nombre);
+    var->nombre = nombre;
+    var->empreinteNombre = empreinte;
+    var->modifiee = ++mem->horloge;
+    var->nombre->compteurRef++;
+    compterValeur(mem, nombre, empreinte, 1);
+}
+
+int affecterVal(memoire* mem, const char *nom, num* nombre) { // Trouver la variable et met la valeur. Si non présente, on ajoute une nouvelle variable.
+    unsigned long long empreinte = empreinteNom(nom);
+    if (reserverMem(mem, 1))
+        return 1; // Out of memory
+    variable *ptr = rechercherVar(mem, nom, empreinte);
+    if (ptr) {
+        remplacerNombre(mem, ptr, nombre, empreinteNombre(nombre));
+        return 0; //OK
+    }
+    size_t longueur = strlen(nom);
+    char *copie = malloc(longueur + 1);
+    if (!copie)
+        return 1; // Out of memory
+    memcpy(copie, nom, longueur + 1);
+    ajouterVariable(mem, copie, empreinte, nombre, empreinteNombre(nombre));
+    return 0; //OK
+}
+
+int retablirValeurs(memoire* buf, memoire* mem) {  // Rétablir la valeur des variables en memoire a partir du buf si tout est OK.
+    int i;
+
+    // Afin d'être sûr que le rétablissement de la mémoire se fera sans problème.
+    // Si un échec appairaissait lors de l'affectation des valeurs à la mémoire principale, la mémoire principale contiendrait des valeurs
+    // issus du buffer, alors que l'on préfère garantir l'intégrite des données en mémoire principale.
+    // Ainsi on réserve d'abord la place de toutes les variables du buffer: la suite ne peut plus échouer.
+    if (reserverMem(mem, buf->nombreVariables))
+        return 1;
+
+    // Les nouvelles variables reprennent le nom alloué par le buffer, qui ne le libérera pas.
+    for (i = buf->nombreVariables - 1; i >= 0; i--) {
+        variable *ptr = &buf->entrees[i], *existante = rechercherVar(mem, ptr->nom, ptr->empreinte);
+        if (existante) {
+            if (existante->formule) { // Une affectation ordinaire remplace la formule par sa valeur.
+                free(existante->formule);
+                existante->formule = NULL;
+                mem->nombreFormules--;
+            }
+            remplacerNombre(mem, existante, ptr->nombre, ptr->empreinteNombre);
+        }
+        else {
+            ajouterVariable(mem, ptr->nom, ptr->empreinte, ptr->nombre, ptr->empreinteNombre);
+            ptr->nom = NULL;
+        }
+    }
+    return 0;
+}
+
+void deleteMem(memoire *mem, num *nombre) {
+    int i;
+    for (i = 0; i < mem->nombreVariables; i++) {
+        variable *ptr = &mem->entrees[i];
+        ptr->nombre->compteurRef--;
+        if (!ptr->nombre->compteurRef && !isEqual(ptr->nombre, nombre))
+            deleteNumber(ptr->nombre);
+        if (ptr->nom)
+            free(ptr->nom);
+        if (ptr->formule)
+            free(ptr->formule);
+    }
+    while (mem->nombreHistorique)
+        retirerHistorique(mem);
+    free(mem->historique);
+    free(mem->entrees);
+    free(mem->indices);
+    free(mem->valeurs);
+    free(mem);
+}
+
+
+/* CALCUL PARALLÈLE */
+
+void definirThreads(int nombre) {
+    if (nombre <= 0) {
+        long coeurs = sysconf(_SC_NPROCESSORS_ONLN);
+        nombre = coeurs > 0 ? (int) coeurs : 1;
+    }
+    atomic_store(&groupe.voulus, nombre < THREADS_MAX ? nombre : THREADS_MAX);
+    pthread_mutex_lock(&groupe.verrou);
+    pthread_cond_broadcast(&groupe.travail); // Les threads au-delà du nouveau nombre se mettent en attente.
+    pthread_mutex_unlock(&groupe.verrou);
+}
+
+int threadsCalcul(void) {
+    if (!atomic_load(&groupe.voulus))
+        definirThreads(0);
+    return atomic_load(&groupe.voulus);
+}
+
+void soumettreTache(tache *t) {
+    if (threadsCalcul() <= 1) {
+        t->fonction(t->argument);
+        t->etat = TACHE_FINIE;
+        return;
+    }
+    pthread_mutex_lock(&groupe.verrou);
+    // Les threads sont lancés à la demande, le thread qui soumet comptant pour un.
+    while (groupe.lances < atomic_load(&groupe.voulus) - 1
+           && !pthread_create(&groupe.threads[groupe.lances], NULL, threadCalcul, (void *) (long) groupe.lances))
+        groupe.lances++;
+    t->etat = TACHE_EN_FILE;
+    t->echeance = echeanceCalcul;
+    t->suivante = groupe.tete;
+    groupe.tete = t;
+    pthread_cond_broadcast(&groupe.travail); // Un signal seul pourrait réveiller un thread mis en attente par definirThreads.
+    pthread_mutex_unlock(&groupe.verrou);
+}
+
+void attendreTache(tache *t) {
+    tache *autre;
+    pthread_mutex_lock(&groupe.verrou);
+    while (t->etat != TACHE_FINIE) {
+        if (!groupe.tete) {
+            pthread_cond_wait(&groupe.fini, &groupe.verrou);
+            continue;
+        }
+        autre = groupe.tete; // Souvent la tâche attendue elle-même, soumise en dernier.
+        groupe.tete = autre->suivante;
+        autre->etat = TACHE_EN_COURS;
+        pthread_mutex_unlock(&groupe.verrou);
+        long long echeance = echeanceCalcul; // La tâche peut venir d'une autre ligne (serveur).
+        echeanceCalcul = autre->echeance;
+        autre->fonction(autre->argument);
+        echeanceCalcul = echeance;
+        pthread_mutex_lock(&groupe.verrou);
+        autre->etat = TACHE_FINIE;
+        pthread_cond_broadcast(&groupe.fini);
+    }
+    pthread_mutex_unlock(&groupe.verrou);
+}
+
+void* threadCalcul(void *argument) {
+    int indice = (int) (long) argument;
+    tache *t;
+    pthread_mutex_lock(&groupe.verrou);
+    while (1) {
+        while (!groupe.tete || indice >= atomic_load(&groupe.voulus) - 1)
+            pthread_cond_wait(&groupe.travail, &groupe.verrou);
+        t = groupe.tete;
+        groupe.tete = t->suivante;
+        t->etat = TACHE_EN_COURS;
+        pthread_mutex_unlock(&groupe.verrou);
+        echeanceCalcul = t->echeance;
+        t->fonction(t->argument);
+        echeanceCalcul = 0;
+        pthread_mutex_lock(&groupe.verrou);
+        t->etat = TACHE_FINIE;
+        pthread_cond_broadcast(&groupe.fini);
+    }
+    return NULL;
+}
+
+
+/* COMPTABILITÉ MÉMOIRE */
+
+void* allouer(size_t taille) {
+    if (allocationsDetachees) // Lecture d'avance: comptée par rattacherBloc quand la ligne est évaluée.
+        return (malloc)(taille); // Les parenthèses empêchent l'expansion de la macro.
+    if (echeanceCalcul && !(++allocationsVerifiees % VERIFICATIONS_ALLOCATION) && calculInterrompu())
+        return NULL; // Ctrl-C ou limite de temps: le calcul échoue comme un out of memory.
+    long long limite = atomic_load(&octetsMax);
+    long long total = atomic_fetch_add(&octetsUtilises, (long long) taille) + (long long) taille;
+    char *bloc = NULL;
+    if (!limite || total <= limite) { // La limite vaut aussi pour les blocs du fichier de débordement.
+        if (disque.actif && (taille <= TAILLE_CASE || taille >= TAILLE_BLOC_DEDIE)
+            && total - atomic_load(&disque.octets) > disque.seuil)
+            bloc = allouerDebordement(taille); // Au-delà du seuil résident
+        if (!bloc && !(bloc = (malloc)(taille)) && disque.actif)
+            bloc = allouerDebordement(taille); // Plus de mémoire: le disque prend le relais, quelle que soit la taille.
+    }
+    if (!bloc) {
+        atomic_fetch_sub(&octetsUtilises, (long long) taille);
+        return NULL; // Out of memory, ou limite atteinte.
+    }
+    // La taille demandée est remplacée par celle du bloc obtenu, qui doit tenir elle aussi dans la limite.
+    long long ecart = octetsBloc(bloc) - (long long) taille;
+    total = atomic_fetch_add(&octetsUtilises, ecart) + ecart;
+    if (limite && total > limite) {
+        liberer(bloc);
+        return NULL;
+    }
+#ifdef STATS
+    if (stats.actives) {
+        STATS_AJOUTER(stats.allocations, 1);
+        STATS_AJOUTER(stats.octets, taille);
+    }
+#endif
+    return bloc;
+}
+
+void* allouerZero(size_t nombre, size_t taille) {
+    if (taille && nombre > (size_t) -1 / taille)
+        return NULL;
+    void *bloc = allouer(nombre * taille);
+    if (bloc)
+        memset(bloc, 0, nombre * taille);
+    return bloc;
+}
+
+void liberer(void *ptr) {
+    if (!ptr)
+        return;
+    if (!allocationsDetachees)
+        atomic_fetch_sub(&octetsUtilises, octetsBloc(ptr));
+    if (DANS_DEBORDEMENT(ptr))
+        libererDebordement(ptr);
+    else
+        (free)(ptr);
+}
+
+long long octetsBloc(void *ptr) {
+    if (!ptr)
+        return 0;
+    if (!DANS_DEBORDEMENT(ptr))
+        return (long long) malloc_usable_size(ptr);
+    if ((char *) ptr < disque.zone + TAILLE_ZONE / 2)
+        return (long long) TAILLE_CASE;
+    return (long long) (((blocDedie *) ((char *) ptr - TAILLE_ENTETE))->taille + TAILLE_ENTETE);
+}
+
+char* allouerDebordement(size_t taille) {
+    size_t longueur = taille + TAILLE_ENTETE, page = (size_t) sysconf(_SC_PAGESIZE);
+    char *bloc = NULL;
+
+    pthread_mutex_lock(&disque.verrou);
+    if (disque.fd < 0) { // Premier débordement: le fichier est créé puis supprimé, il disparaît avec le processus.
+        size_t longueurChemin = strlen(disque.dossier) + 16;
+        char *chemin = (malloc)(longueurChemin);
+        if (chemin) {
+            snprintf(chemin, longueurChemin, "%s/calc-XXXXXX", disque.dossier);
+            disque.fd = mkstemp(chemin);
+            if (disque.fd >= 0)
+                unlink(chemin);
+            (free)(chemin);
+        }
+        if (disque.fd < 0)
+            goto finDebordement;
+    }
+
+    if (taille <= TAILLE_CASE) {
+        longueur = TAILLE_CASE;
+        if (disque.casesLibres) { // Une case rendue: son premier mot garde la suivante.
+            bloc = disque.casesLibres;
+            disque.casesLibres = *(void **) bloc;
+        }
+        else {
+            if (disque.resteArene < longueur) { // Nouvelle arène, à la suite dans le fichier et dans la zone.
+                void *arene = MAP_FAILED;
+                if (disque.finCases + TAILLE_ARENE <= TAILLE_ZONE / 2
+                    && !ftruncate(disque.fd, (off_t) (disque.fin + (long long) TAILLE_ARENE)))
+                    arene = mmap(disque.zone + disque.finCases, TAILLE_ARENE, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_FIXED, disque.fd, (off_t) disque.fin);
+                if (arene == MAP_FAILED)
+                    goto finDebordement;
+                disque.fin += (long long) TAILLE_ARENE;
+                disque.finCases += TAILLE_ARENE;
+                disque.arene = arene;
+                disque.resteArene = TAILLE_ARENE;
+            }
+            bloc = disque.arene;
+            disque.arene += longueur;
+            disque.resteArene -= longueur;
+        }
+    }
+    else { // Bloc dédié: une plage de pages précédée de son en-tête, reprise d'un bloc libéré ou projetée à la suite.
+        blocDedie **plage, *entete = NULL;
+        longueur = (longueur + page - 1) / page * page;
+        for (plage = &disque.blocsLibres; *plage; plage = &(*plage)->suivant)
+            if ((*plage)->longueur >= longueur) { // Déjà projetée sur sa place dans le fichier.
+                entete = *plage;
+                *plage = entete->suivant;
+                if (entete->longueur - longueur >= TAILLE_BLOC_DEDIE) { // Le reste redevient une plage libre.
+                    blocDedie *reste = (blocDedie *) ((char *) entete + longueur);
+                    reste->longueur = entete->longueur - longueur;
+                    reste->decalage = entete->decalage + (long long) longueur;
+                    reste->suivant = disque.blocsLibres;
+                    disque.blocsLibres = reste;
+                }
+                else
+                    longueur = entete->longueur; // Un reste trop court pour un bloc dédié suit le bloc.
+                break;
+            }
+        if (!entete) {
+            void *projection = MAP_FAILED;
+            if (disque.finBlocs + longueur <= TAILLE_ZONE / 2
+                && !ftruncate(disque.fd, (off_t) (disque.fin + (long long) longueur)))
+                projection = mmap(disque.zone + TAILLE_ZONE / 2 + disque.finBlocs, longueur, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_FIXED, disque.fd, (off_t) disque.fin);
+            if (projection == MAP_FAILED)
+                goto finDebordement;
+            entete = projection;
+            entete->decalage = disque.fin;
+            disque.fin += (long long) longueur;
+            disque.finBlocs += longueur;
+        }
+        entete->taille = taille;
+        entete->longueur = longueur;
+        bloc = (char *) entete + TAILLE_ENTETE;
+    }
+    atomic_fetch_add(&disque.octets, (long long) longueur);
+
+    finDebordement:
+    pthread_mutex_unlock(&disque.verrou);
+    return bloc;
+}
+
+void libererDebordement(char *ptr) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    if (ptr < disque.zone + TAILLE_ZONE / 2) { // Une case
+        atomic_fetch_sub(&disque.octets, (long long) TAILLE_CASE);
+        pthread_mutex_lock(&disque.verrou);
+        *(void **) ptr = disque.casesLibres;
+        disque.casesLibres = ptr;
+        pthread_mutex_unlock(&disque.verrou);
+        return;
+    }
+    blocDedie *entete = (blocDedie *) (ptr - TAILLE_ENTETE);
+    atomic_fetch_sub(&disque.octets, (long long) entete->longueur);
+    pthread_mutex_lock(&disque.verrou);
+    // La plage reste projetée pour être reprise. Sa place sur le disque est rendue, sauf la première page qui garde
+    // l'en-tête; le fichier garde sa taille, les décalages restent valides. Sans trous (système de fichiers qui ne les
+    // permet pas), la place n'est pas rendue mais sera reprise avec la plage.
+    if (fallocate(disque.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) (entete->decalage + (long long) page),
+                  (off_t) (entete->longueur - page)) && !disque.trousImpossibles) {
+        disque.trousImpossibles = 1;
+        fprintf(stderr, "Débordement: la place des blocs libérés n'est pas rendue au disque (%s).\n", strerror(errno));
+    }
+    entete->suivant = disque.blocsLibres;
+    disque.blocsLibres = entete;
+    pthread_mutex_unlock(&disque.verrou);
+}
+
+int activerDebordement(char *dossier, long long seuil) {
+    struct stat etat;
+    if (stat(dossier, &etat) || !S_ISDIR(etat.st_mode) || access(dossier, W_OK))
+        return 1;
+    if (!seuil)
+        seuil = (long long) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE) / 2;
+    void *zone = mmap(NULL, TAILLE_ZONE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (zone == MAP_FAILED)
+        return 1;
+    disque.zone = zone;
+    disque.dossier = dossier;
+    disque.seuil = seuil;
+    disque.actif = 1;
+    return 0;
+}
+
+int rattacherBloc(void *ptr) {
+    if (!ptr)
+        return 0;
+    long long taille = octetsBloc(ptr);
+    long long limite = atomic_load(&octetsMax), total = atomic_fetch_add(&octetsUtilises, taille) + taille;
+    return limite && total > limite;
+}
+
+long long octetsNombre(num *nombre) {
+    long long octets = octetsBloc(nombre);
+    cell *p;
+    for (p = nombre->chiffres; p; p = p->suivant)
+        octets += octetsBloc(p);
+    return octets;
+}
+
+void afficherMemoire(FILE *sortie, memoire *mem, pile *stack) {
+    long long octetsVariables, octetsNombres = 0, octetsPile = 0;
+    int distincts = 0, partages = 0, i, j;
+
+    // Les tables, puis un nom alloué par variable.
+    octetsVariables = octetsBloc(mem->entrees) + octetsBloc(mem->indices) + octetsBloc(mem->valeurs);
+    for (i = mem->nombreVariables - 1; i >= 0; i--) { // De la plus récente à la plus ancienne.
+        variable *ptr = &mem->entrees[i];
+        fprintf(sortie, "%s: %d chiffres, %lld octets, compteurRef %d%s", ptr->nom, findLenNum(ptr->nombre),
+                       octetsNombre(ptr->nombre), ptr->nombre->compteurRef, ptr->nombre->compteurRef > 1 ? " (partagé)" : "");
+        octetsVariables += octetsBloc(ptr->nom);
+        if (ptr->formule) { // Ses mots, tels qu'ils ont été écrits avant :=nom, sont dans le même bloc.
+            fprintf(sortie, ", formule%s:", ptr->formule->erreur ? " en erreur" : "");
+            octetsVariables += octetsBloc(ptr->formule);
+            for (j = 0; j < ptr->formule->nombreMots; j++)
+                fprintf(sortie, " %s", ptr->formule->mots[j]);
+        }
+        fprintf(sortie, "\n");
+    }
+
+    // Un nombre partagé par plusieurs variables n'est compté qu'une fois: l'index des valeurs les tient chacun une fois.
+    for (i = 0; i < mem->capaciteValeurs; i++) {
+        if (!mem->valeurs[i].nombre)
+            continue;
+        distincts++;
+        octetsNombres += octetsNombre(mem->valeurs[i].nombre);
+        if (mem->valeurs[i].nombre->compteurRef > 1)
+            partages++;
+    }
+    node *noeud;
+    for (noeud = stack->top; noeud; noeud = noeud->suivant)
+        octetsPile += octetsBloc(noeud) + octetsNombre(noeud->nombre);
+
+    fprintf(sortie, "variables: %d (%lld octets), nombres distincts: %d dont %d partagés (%lld octets)\n",
+                   mem->nombreVariables, octetsVariables, distincts, partages, octetsNombres);
+    fprintf(sortie, "pile: %d nombres (%lld octets)\n", stack->length, octetsPile);
+    if (mem->historique)
+        fprintf(sortie, "historique: %d résultats (%lld octets de nombres)\n", mem->nombreHistorique, mem->octetsHistorique);
+    if (disque.actif)
+        fprintf(sortie, "débordement: %lld octets sur disque (%s), seuil: %lld octets\n", atomic_load(&disque.octets),
+                       disque.dossier, disque.seuil);
+    if (atomic_load(&octetsMax))
+        fprintf(sortie, "total alloué: %lld octets, limite: %lld octets\n", atomic_load(&octetsUtilises), atomic_load(&octetsMax));
+    else
+        fprintf(sortie, "total alloué: %lld octets, limite: aucune\n", atomic_load(&octetsUtilises));
+}
+
+int estCommande(char *mot) {
+    return mot && (!strcmp(mot, "#mem") || !strcmp(mot, "#hist") || !strcmp(mot, "#time") || !strcmp(mot, "save")
+                   || !strcmp(mot, "load") || !strcmp(mot, "obase"));
+}
+
+long long lireTaille(char *texte) {
+    char *fin;
+    long long taille = strtoll(texte, &fin, 10);
+    if (fin == texte || taille < 0)
+        return -1;
+    switch (*fin) {
+        case 'K': taille <<= 10; fin++; break;
+        case 'M': taille <<= 20; fin++; break;
+        case 'G': taille <<= 30; fin++; break;
+        default: break;
+    }
+    return *fin ? -1 : taille;
+}
+
+int executerCommande(memoire *mem, pile *stack, char *commande, char **arguments, int nombreArguments, FILE *sortie) {
+    if (!strcmp(commande, "#mem")) {
+        if (!nombreArguments) {
+            afficherMemoire(sortie, mem, stack);
+            return 0;
+        }
+        if (nombreArguments == 2 && !strcmp(arguments[0], "max")) { // #mem max N: nouvelle limite, 0 pour aucune.
+            long long limite = lireTaille(arguments[1]);
+            if (limite < 0)
+                return 2;
+            atomic_store(&octetsMax, limite);
+            if (limite)
+                fprintf(sortie, "limite: %lld octets\n", limite);
+            else
+                fprintf(sortie, "limite: aucune\n");
+            return 0;
+        }
+    }
+    if (!strcmp(commande, "#hist")) {
+        if (!nombreArguments) {
+            afficherHistorique(sortie, mem);
+            return 0;
+        }
+        if (nombreArguments == 2 && !strcmp(arguments[0], "max")) { // #hist max N: nouvelle limite, 0 pour aucune.
+            long long limite = lireTaille(arguments[1]);
+            if (limite < 0)
+                return 2;
+            mem->limiteHistorique = limite;
+            while (limite && mem->octetsHistorique > limite)
+                retirerHistorique(mem);
+            if (limite)
+                fprintf(sortie, "limite de l'historique: %lld octets\n", limite);
+            else
+                fprintf(sortie, "limite de l'historique: aucune\n");
+            return 0;
+        }
+    }
+    if (!strcmp(commande, "#time") && (!nombreArguments || (nombreArguments == 2 && !strcmp(arguments[0], "max")))) {
+        if (nombreArguments) { // #time max S: nouvelle limite en secondes, 0 pour aucune.
+            long long limite = lireDuree(arguments[1]);
+            if (limite < 0)
+                return 2;
+            atomic_store(&tempsMax, limite);
+        }
+        if (atomic_load(&tempsMax))
+            fprintf(sortie, "limite de temps par ligne: %g s\n", (double) atomic_load(&tempsMax) / 1000);
+        else
+            fprintf(sortie, "limite de temps par ligne: aucune\n");
+        return 0;
+    }
+    if (!strcmp(commande, "save") && nombreArguments == 1) {
+        int exception = formulesDifferees ? actualiserFormules(mem) : 0; // Les valeurs sauvegardées sont à jour.
+        return exception ? exception : sauverVariables(mem, arguments[0], sortie);
+    }
+    if (!strcmp(commande, "load") && nombreArguments == 1)
+        return chargerVariables(mem, arguments[0], sortie);
+    if (!strcmp(commande, "obase")) { // obase: base en vigueur, obase 2, 10 ou 16: nouvelle base d'affichage.
+        if (nombreArguments == 1 && (!strcmp(arguments[0], "2") || !strcmp(arguments[0], "10") || !strcmp(arguments[0], "16")))
+            mem->baseSortie = atoi(arguments[0]);
+        else if (nombreArguments)
+            return 2;
+        fprintf(sortie, "obase: %d\n", mem->baseSortie);
+        return 0;
+    }
+    return 2; // Erreur de syntaxe
+}
+
+
+/* INTERRUPTION DES CALCULS */
+
+int calculInterrompu(void) {
+    if (!echeanceCalcul)
+        return 0;
+    if (atomic_load_explicit(&interruptionDemandee, memory_order_relaxed))
+        return 1;
+    return echeanceCalcul != ECHEANCE_AUCUNE && maintenantNs() >= echeanceCalcul;
+}
+
+long long debutCalcul(void) {
+    long long limite = atomic_load(&tempsMax);
+    atomic_fetch_add(&lignesEnCours, 1);
+    return limite ? maintenantNs() + limite * 1000000LL : ECHEANCE_AUCUNE;
+}
+
+void finCalcul(void) {
+    if (atomic_fetch_sub(&lignesEnCours, 1) == 1)
+        atomic_store(&interruptionDemandee, 0); // Un Ctrl-C ne vaut que pour les calculs en cours.
+}
+
+void signalInterruption(int numero) {
+    if (!atomic_load(&lignesEnCours)) { // À l'invite: le comportement par défaut, qui arrête le programme.
+        signal(numero, SIG_DFL);
+        raise(numero);
+        return;
+    }
+    atomic_store(&interruptionDemandee, 1);
+}
+
+long long lireDuree(char *texte) {
+    char *fin;
+    double secondes = strtod(texte, &fin);
+    if (fin == texte || *fin || !(secondes >= 0) || secondes > 1e9)
+        return -1;
+    return (long long) (secondes * 1000 + 0.5);
+}
+
+
+/* HISTORIQUE DES RÉSULTATS */
+
+int validHistorique(char *mot) {
+    char *p = mot + 1;
+    if (*p == '-')
+        p++;
+    if (*p < '1' || *p > '9' || strlen(p) > 18) // Pas de $0 ni de $01; 18 chiffres tiennent dans un long long.
+        return 0;
+    for (; *p; p++)
+        if (*p < '0' || *p > '9')
+            return 0;
+    return 1;
+}
+
+num* resultatHistorique(memoire *mem, char *mot) {
+    long long numero = atoll(mot + 1);
+    if (numero < 0)
+        numero += mem->premierHistorique + mem->nombreHistorique; // $-1: le dernier
+    if (numero < mem->premierHistorique || numero >= mem->premierHistorique + mem->nombreHistorique)
+        return NULL;
+    return mem->historique[(mem->debutHistorique + (int) (numero - mem->premierHistorique)) % mem->capaciteHistorique];
+}
+
+int reserverHistorique(memoire *mem) {
+    int i;
+    if (mem->nombreHistorique < mem->capaciteHistorique || mem->capaciteHistorique == TAILLE_HISTORIQUE)
+        return 0; // Place libre, ou anneau complet: le plus ancien résultat laissera sa case.
+    int capacite = mem->capaciteHistorique ? 2 * mem->capaciteHistorique : 8;
+    num **historique = malloc(sizeof(num*) * (size_t) capacite);
+    if (!historique)
+        return 1; // Out of memory
+    for (i = 0; i < mem->nombreHistorique; i++) // Du plus ancien au plus récent, à partir de la case 0.
+        historique[i] = mem->historique[(mem->debutHistorique + i) % mem->capaciteHistorique];
+    free(mem->historique);
+    mem->historique = historique;
+    mem->debutHistorique = 0;
+    mem->capaciteHistorique = capacite;
+    return 0;
+}
+
+void ajouterHistorique(memoire *mem, num *nombre) {
+    nombre->compteurRef++; // Tenu pendant l'ajout: le résultat abandonné peut être ce même nombre.
+    if (mem->nombreHistorique == TAILLE_HISTORIQUE)
+        retirerHistorique(mem);
+    // Un nombre gardé plusieurs fois n'est compté qu'une fois. Chaque case tient une référence: un nombre que seul
+    // l'ajout tient n'est dans aucune case, sans parcourir l'anneau.
+    if (nombre->compteurRef == 1 || !occurrencesHistorique(mem, nombre))
+        mem->octetsHistorique += octetsNombre(nombre);
+    mem->historique[(mem->debutHistorique + mem->nombreHistorique++) % mem->capaciteHistorique] = nombre;
+    nombre->compteurRef++;
+    while (mem->limiteHistorique && mem->octetsHistorique > mem->limiteHistorique)
+        retirerHistorique(mem); // Un résultat plus grand que la limite n'est pas gardé du tout.
+    nombre->compteurRef--;
+}
+
+void retirerHistorique(memoire *mem) {
+    num *nombre = mem->historique[mem->debutHistorique];
+    mem->debutHistorique = (mem->debutHistorique + 1) % mem->capaciteHistorique;
+    mem->nombreHistorique--;
+    mem->premierHistorique++;
+    if (nombre->compteurRef == 1 || !occurrencesHistorique(mem, nombre)) // Seule la case retirée le tenait.
+        mem->octetsHistorique -= octetsNombre(nombre);
+    nombre->compteurRef--;
+    if (!nombre->compteurRef)
+        deleteNumber(nombre);
+}
+
+int occurrencesHistorique(memoire *mem, num *nombre) {
+    int occurrences = 0, i;
+    for (i = 0; i < mem->nombreHistorique; i++)
+        if (mem->historique[(mem->debutHistorique + i) % mem->capaciteHistorique] == nombre)
+            occurrences++;
+    return occurrences;
+}
+
+void afficherHistorique(FILE *sortie, memoire *mem) {
+    int i;
+    for (i = 0; i < mem->nombreHistorique; i++) {
+        num *nombre = mem->historique[(mem->debutHistorique + i) % mem->capaciteHistorique];
+        fprintf(sortie, "$%lld: %d chiffres, compteurRef %d\n", mem->premierHistorique + i, findLenNum(nombre), nombre->compteurRef);
+    }
+    fprintf(sortie, "historique: %d résultats (%lld octets de nombres), ", mem->nombreHistorique, mem->octetsHistorique);
+    if (mem->limiteHistorique)
+        fprintf(sortie, "limite: %lld octets\n", mem->limiteHistorique);
+    else
+        fprintf(sortie, "limite: aucune\n");
+}
+
+
+/* FORMULES */
+
+int validFormule(const char *mot) {
+    return mot[0] == ':' && mot[1] == '=' && validNom(mot + 2);
+}
+
+formule* creerFormule(char **mots, int nombreMots) {
+    size_t taille = 0;
+    int i;
+    for (i = 0; i < nombreMots; i++)
+        taille += strlen(mots[i]) + 1;
+    // Un seul bloc: la structure, le tableau des mots, puis leur texte.
+    formule *nouvelle = malloc(sizeof(formule) + sizeof(char*) * (size_t) nombreMots + taille);
+    if (!nouvelle)
+        return NULL;
+    nouvelle->calculee = 0;
+    nouvelle->enCours = nouvelle->erreur = 0;
+    nouvelle->nombreMots = nombreMots;
+    nouvelle->mots = (char **) (nouvelle + 1);
+    char *texte = (char *) (nouvelle->mots + nombreMots);
+    for (i = 0; i < nombreMots; i++) {
+        size_t longueur = strlen(mots[i]) + 1;
+        memcpy(texte, mots[i], longueur);
+        nouvelle->mots[i] = texte;
+        texte += longueur;
+    }
+    return nouvelle;
+}
+
+int dependDe(memoire *mem, char **mots, int nombreMots, const char *nom) {
+    int i;
+    for (i = 0; i < nombreMots; i++) {
+        if (!validNom(mots[i]))
+            continue; // Littéral ou opérateur.
+        if (!strcmp(mots[i], nom))
+            return 1;
+        variable *var = rechercherVar(mem, mots[i], empreinteNom(mots[i]));
+        if (var && var->formule && dependDe(mem, var->formule->mots, var->formule->nombreMots, nom))
+            return 1;
+    }
+    return 0;
+}
+
+int actualiserFormule(memoire *mem, int indice) {
+    formule *f = mem->entrees[indice].formule;
+    long long derniere = 0;
+    int exception = 0, i;
+
+    if (!f || f->enCours)
+        return 0;
+    // Les formules lues d'abord. Les indices plutôt que des pointeurs: réserver une place peut déplacer les variables.
+    f->enCours = 1;
+    for (i = 0; !exception && i < f->nombreMots; i++) {
+        variable *var;
+        if (!validNom(f->mots[i]) || !(var = rechercherVar(mem, f->mots[i], empreinteNom(f->mots[i]))))
+            continue; // Littéral ou opérateur.
+        int lue = (int) (var - mem->entrees);
+        if (var->formule && actualiserFormule(mem, lue) == 1)
+            exception = 1; // Son erreur de syntaxe sera celle de cette formule, qui la lit.
+        if (mem->entrees[lue].modifiee > derniere)
+            derniere = mem->entrees[lue].modifiee;
+    }
+    f->enCours = 0;
+    if (exception || derniere <= f->calculee)
+        return exception; // Aucune variable lue n'a changé depuis le dernier calcul.
+
+    pile *stack = malloc(sizeof(pile));
+    memoire *buffer = malloc(sizeof(memoire)); // Reste vide: une formule n'affecte rien.
+    if (!stack || !buffer)
+        exception = 1;
+    else {
+        initPile(stack);
+        initMem(buffer);
+    }
+    TRACE_DEBUT("formule", -1, -1, NULL, mem->entrees[indice].nom);
+    for (i = 0; !exception && i < f->nombreMots; i++)
+        exception = POSTFIXE_EVALUATION(buffer, mem, stack, f->mots[i]);
+    if (!exception && stack->length != 1)
+        exception = 2;
+    if (!exception) {
+        num *resultat = pop(stack);
+        // Même valeur: le nombre et la date de la variable ne changent pas, les formules qui la lisent non plus.
+        if (!isEqual(resultat, mem->entrees[indice].nombre)) {
+            if (reserverMem(mem, 1))
+                exception = 1; // Out of memory
+            else
+                remplacerNombre(mem, &mem->entrees[indice], resultat, empreinteNombre(resultat));
+        }
+        if (!resultat->compteurRef)
+            deleteNumber(resultat);
+    }
+    if (exception != 1) { // Réussite ou erreur de syntaxe: calculée pour l'état actuel de ses variables.
+        if (f->erreur != exception)
+            mem->entrees[indice].modifiee = ++mem->horloge; // Les formules qui la lisent échouent ou réussissent aussi.
+        f->erreur = exception;
+        f->calculee = mem->horloge;
+    }
+    TRACE_FIN("formule");
+    if (stack) deletePile(stack);
+    if (buffer) deleteMem(buffer, NULL);
+    return exception;
+}
+
+int actualiserFormules(memoire *mem) {
+    int exception = 0, erreur, i;
+    for (i = 0; mem->nombreFormules && i < mem->nombreVariables; i++) {
+        if (mem->entrees[i].formule && (erreur = actualiserFormule(mem, i)) && !exception)
+            exception = erreur;
+    }
+    return exception;
+}
+
+
+/* SAUVEGARDE DES VARIABLES */
+
+unsigned long long sommeControle(unsigned long long somme, const unsigned int *mots, size_t nombre) {
+    size_t i;
+    for (i = 0; i < nombre; i++)
+        somme = (somme ^ mots[i]) * 0x100000001b3ULL;
+    return somme;
+}
+
+int sauverVariables(memoire *mem, const char *chemin, FILE *sortie) {
+    enteteSauvegarde entete;
+    tranches t;
+    unsigned int enregistrement[2];
+    size_t longueurChemin = strlen(chemin);
+    int i, exception = 0;
+    char *temporaire = malloc(longueurChemin + 5);
+    int *rangs = calloc(mem->capaciteValeurs ? (size_t) mem->capaciteValeurs : 1, sizeof(int)); // 1 + rang du nombre écrit.
+    FILE *fichier = NULL;
+
+    if (!temporaire || !rangs) {
+        free(temporaire);
+        free(rangs);
+        return 1;
+    }
+    memcpy(temporaire, chemin, longueurChemin);
+    strcpy(temporaire + longueurChemin, ".tmp"); // Écrit à côté puis renommé: une sauvegarde interrompue n'écrase rien.
+    fichier = fopen(temporaire, "wb");
+    if (!fichier) {
+        free(temporaire);
+        free(rangs);
+        return 3;
+    }
+    memset(&entete, 0, sizeof(entete));
+    memcpy(entete.magie, MAGIE_SAUVEGARDE, 8);
+    entete.somme = 0xcbf29ce484222325ULL;
+    if (fwrite(&entete, sizeof(entete), 1, fichier) != 1)
+        exception = 3;
+
+    // Les nombres distincts, chacun à sa première variable; l'index des valeurs donne leur rang.
+    for (i = 0; i < mem->nombreVariables && !exception; i++) {
+        variable *ptr = &mem->entrees[i];
+        int valeur = trouverValeur(mem, ptr->nombre, ptr->empreinteNombre);
+        if (rangs[valeur])
+            continue;
+        if (numVersTranches(ptr->nombre, &t)) {
+            exception = 1;
+            break;
+        }
+        enregistrement[0] = (unsigned int) ptr->nombre->negatif;
+        enregistrement[1] = (unsigned int) t.longueur;
+        entete.somme = sommeControle(entete.somme, enregistrement, 2);
+        entete.somme = sommeControle(entete.somme, t.valeurs, (size_t) t.longueur);
+        if (fwrite(enregistrement, sizeof(unsigned int), 2, fichier) != 2
+            || fwrite(t.valeurs, sizeof(unsigned int), (size_t) t.longueur, fichier) != (size_t) t.longueur)
+            exception = 3;
+        libererTranches(&t);
+        rangs[valeur] = (int) ++entete.nombres;
+    }
+
+    // Les variables: longueur du nom, indice du nombre, nom complété par des '\0' jusqu'à un multiple de 4 octets.
+    for (i = 0; i < mem->nombreVariables && !exception; i++) {
+        variable *ptr = &mem->entrees[i];
+        size_t longueur = strlen(ptr->nom), mots = (longueur + 3) / 4;
+        unsigned int *nom = calloc(mots, sizeof(unsigned int));
+        if (!nom) {
+            exception = 1;
+            break;
+        }
+        memcpy(nom, ptr->nom, longueur);
+        enregistrement[0] = (unsigned int) longueur;
+        enregistrement[1] = (unsigned int) rangs[trouverValeur(mem, ptr->nombre, ptr->empreinteNombre)] - 1;
+        entete.somme = sommeControle(entete.somme, enregistrement, 2);
+        entete.somme = sommeControle(entete.somme, nom, mots);
+        if (fwrite(enregistrement, sizeof(unsigned int), 2, fichier) != 2 || fwrite(nom, sizeof(unsigned int), mots, fichier) != mots)
+            exception = 3;
+        free(nom);
+        entete.variables++;
+    }
+
+    if (!exception && (fseek(fichier, 0, SEEK_SET) || fwrite(&entete, sizeof(entete), 1, fichier) != 1))
+        exception = 3;
+    if (fclose(fichier) && !exception)
+        exception = 3;
+    if (!exception && rename(temporaire, chemin))
+        exception = 3;
+    if (exception)
+        remove(temporaire);
+    else
+        fprintf(sortie, "sauvegarde: %u variables, %u nombres\n", entete.variables, entete.nombres);
+    free(temporaire);
+    free(rangs);
+    return exception;
+}
+
+int chargerVariables(memoire *mem, const char *chemin, FILE *sortie) {
+    enteteSauvegarde entete;
+    struct stat etat;
+    const unsigned int *mots, *fin, *p;
+    num **nombres = NULL;
+    memoire *chargees = NULL;
+    void *projection = MAP_FAILED;
+    unsigned int i;
+    int exception = 3;
+    int fd = open(chemin, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0 || fstat(fd, &etat) || (size_t) etat.st_size < sizeof(entete) || etat.st_size % 4)
+        goto fin;
+    projection = mmap(NULL, (size_t) etat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (projection == MAP_FAILED)
+        goto fin;
+    madvise(projection, (size_t) etat.st_size, MADV_SEQUENTIAL);
+    memcpy(&entete, projection, sizeof(entete));
+    mots = (const unsigned int *) ((char *) projection + sizeof(entete));
+    fin = (const unsigned int *) ((char *) projection + etat.st_size);
+    if (memcmp(entete.magie, MAGIE_SAUVEGARDE, 8)
+        || sommeControle(0xcbf29ce484222325ULL, mots, (size_t) (fin - mots)) != entete.somme)
+        goto fin;
+
+    exception = 1;
+    nombres = calloc(entete.nombres ? entete.nombres : 1, sizeof(num*));
+    chargees = malloc(sizeof(memoire));
+    if (!nombres || !chargees)
+        goto fin;
+    initMem(chargees);
+
+    // Chaque nombre est construit directement depuis ses tranches, lues dans la projection.
+    p = mots;
+    for (i = 0; i < entete.nombres; i++) {
+        tranches t;
+        exception = 3;
+        if (fin - p < 2 || p[0] > 1 || p[1] > (unsigned int) (fin - p - 2))
+            goto fin;
+        t.longueur = (int) p[1];
+        t.valeurs = (unsigned int *) (p + 2);
+        for (int j = 0; j < t.longueur; j++)
+            if (t.valeurs[j] >= BASE_TRANCHE)
+                goto fin;
+        exception = 1;
+        if (!(nombres[i] = tranchesVersNum(&t, (int) p[0])))
+            goto fin;
+        nombres[i]->compteurRef++; // Tenu par le tableau jusqu'à la fin du chargement.
+        p += 2 + t.longueur;
+    }
+    for (i = 0; i < entete.variables; i++) {
+        exception = 3;
+        if (fin - p < 2 || !p[0] || p[1] >= entete.nombres || (p[0] + 3) / 4 > (unsigned int) (fin - p - 2))
+            goto fin;
+        size_t longueur = p[0];
+        const char *texte = (const char *) (p + 2);
+        if (memchr(texte, '\0', longueur))
+            goto fin;
+        exception = 1;
+        char *nom = malloc(longueur + 1);
+        if (!nom)
+            goto fin;
+        memcpy(nom, texte, longueur);
+        nom[longueur] = '\0';
+        exception = validNom(nom) ? affecterVal(chargees, nom, nombres[p[1]]) : 3; // Même règle que les affectations.
+        free(nom);
+        if (exception)
+            goto fin;
+        p += 2 + (longueur + 3) / 4;
+    }
+    exception = 3;
+    if (p != fin)
+        goto fin;
+
+    // Tout est construit: on peut remplacer les variables, sans toucher à la mémoire si cela échoue.
+    exception = retablirValeurs(chargees, mem);
+    if (!exception)
+        fprintf(sortie, "chargement: %u variables, %u nombres\n", entete.variables, entete.nombres);
+
+    fin:
+    if (chargees)
+        deleteMem(chargees, NULL);
+    if (nombres) {
+        for (i = 0; i < entete.nombres; i++) {
+            if (nombres[i] && !--nombres[i]->compteurRef)
+                deleteNumber(nombres[i]);
+        }
+        free(nombres);
+    }
+    if (projection != MAP_FAILED)
+        munmap(projection, (size_t) etat.st_size);
+    if (fd >= 0)
+        close(fd);
+    return exception;
+}
+
+
+/* BIBLIOTHÈQUE */
+
+ssize_t ecrireContexte(void *cookie, const char *donnees, size_t taille) {
+    calc_ctx *ctx = cookie;
+    if (!ctx->courant || calc_buffer_append(ctx->courant, donnees, taille))
+        return 0; // Le FILE passe en erreur: calc_eval_line renverra out of memory.
+    return (ssize_t) taille;
+}
+
+calc_ctx* calc_new(void) {
+    cookie_io_functions_t fonctions = {NULL, ecrireContexte, NULL, NULL};
+    calc_ctx *ctx = malloc(sizeof(calc_ctx));
+    if (!ctx)
+        return NULL;
+    ctx->courant = NULL;
+    ctx->ligne = NULL;
+    ctx->capaciteLigne = 0;
+    ctx->mem = malloc(sizeof(memoire));
+    ctx->sortie = fopencookie(ctx, "w", fonctions);
+    if (!ctx->mem || !ctx->sortie) {
+        if (ctx->sortie)
+            fclose(ctx->sortie);
+        free(ctx->mem);
+        free(ctx);
+        return NULL;
+    }
+    initMem(ctx->mem);
+    return ctx;
+}
+
+void calc_free(calc_ctx *ctx) {
+    if (!ctx)
+        return;
+    ctx->courant = NULL;
+    fclose(ctx->sortie);
+    deleteMem(ctx->mem, NULL);
+    free(ctx->ligne);
+    free(ctx);
+}
+
+int copierLigne(calc_ctx *ctx, const char *buf, size_t len) {
+    if (len + 1 > ctx->capaciteLigne) { // evaluerLigne découpe une chaîne terminée par '\0'.
+        char *ligne = malloc(len + 1);
+        if (!ligne)
+            return 1;
+        free(ctx->ligne);
+        ctx->ligne = ligne;
+        ctx->capaciteLigne = len + 1;
+    }
+    memcpy(ctx->ligne, buf, len);
+    ctx->ligne[len] = '\0';
+    if (memchr(buf, '\0', len))
+        ctx->ligne[0] = ' '; // Un '\0' dans la ligne: erreur de syntaxe plutôt qu'une ligne tronquée en silence.
+    return 0;
+}
+
+int calc_eval_line(calc_ctx *ctx, const char *buf, size_t len, calc_buffer *out) {
+    int exception;
+
+    if (copierLigne(ctx, buf, len)) {
+        const char *message = "Out of Memory. Le programme n'a plus assez de mémoire pour fonctionner normalement.\n";
+        calc_buffer_append(out, message, strlen(message));
+        return CALC_ERR_NOMEM;
+    }
+    ctx->courant = out;
+    exception = evaluerLigne(ctx->mem, ctx->ligne, ctx->sortie);
+    if (fflush(ctx->sortie) || ferror(ctx->sortie)) {
+        clearerr(ctx->sortie);
+        exception = CALC_ERR_NOMEM; // Le résultat n'a pas pu être copié entièrement.
+    }
+    ctx->courant = NULL;
+    return exception;
+}
+
+int calc_eval_line_file(calc_ctx *ctx, const char *buf, size_t len, FILE *out) {
+    if (copierLigne(ctx, buf, len)) {
+        fprintf(out, "Out of Memory. Le programme n'a plus assez de mémoire pour fonctionner normalement.\n");
+        return CALC_ERR_NOMEM;
+    }
+    return evaluerLigne(ctx->mem, ctx->ligne, out); // Sans passer par ctx->sortie: rien n'est gardé.
+}
+
+int calc_save(calc_ctx *ctx, const char *path, calc_buffer *out) {
+    int exception;
+    ctx->courant = out;
+    exception = sauverVariables(ctx->mem, path, ctx->sortie);
+    afficherErreur(ctx->sortie, exception);
+    if (fflush(ctx->sortie) || ferror(ctx->sortie)) {
+        clearerr(ctx->sortie);
+        exception = exception ? exception : CALC_ERR_NOMEM;
+    }
+    ctx->courant = NULL;
+    return exception;
+}
+
+int calc_load(calc_ctx *ctx, const char *path, calc_buffer *out) {
+    int exception;
+    ctx->courant = out;
+    exception = chargerVariables(ctx->mem, path, ctx->sortie);
+    afficherErreur(ctx->sortie, exception);
+    if (fflush(ctx->sortie) || ferror(ctx->sortie)) {
+        clearerr(ctx->sortie);
+        exception = exception ? exception : CALC_ERR_NOMEM;
+    }
+    ctx->courant = NULL;
+    return exception;
+}
+
+void calc_set_threads(int threads) {
+    definirThreads(threads);
+}
+
+void calc_interrupt(void) {
+    atomic_store(&interruptionDemandee, 1);
+}
+
+void calc_buffer_init(calc_buffer *buffer) {
+    buffer->data = NULL;
+    buffer->len = buffer->cap = 0;
+}
+
+void calc_buffer_clear(calc_buffer *buffer) {
+    buffer->len = 0;
+}
+
+void calc_buffer_free(calc_buffer *buffer) {
+    free(buffer->data);
+    calc_buffer_init(buffer);
+}
+
+int calc_buffer_append(calc_buffer *buffer, const char *data, size_t len) {
+    if (buffer->cap - buffer->len < len) {
+        size_t capacite = buffer->cap ? buffer->cap : 256;
+        while (capacite - buffer->len < len)
+            capacite *= 2;
+        char *nouveau = malloc(capacite);
+        if (!nouveau)
+            return 1;
+        if (buffer->len)
+            memcpy(nouveau, buffer->data, buffer->len);
+        free(buffer->data);
+        buffer->data = nouveau;
+        buffer->cap = capacite;
+    }
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    return 0;
+}
+
+
+/* TRACE */
+
+_Thread_local tamponTrace *tamponTraceThread = NULL;
+atomic_int prochainTidTrace = 1;
+int premierEvenementTrace = 1;
+struct timespec origineTrace;
+
+int ouvrirTrace(const char *chemin) {
+    fichierTrace = fopen(chemin, "w");
+    if (!fichierTrace)
+        return 1;
+    clock_gettime(CLOCK_MONOTONIC, &origineTrace);
+    fprintf(fichierTrace, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    return 0;
+}
+
+void tracer(const char *nom, char phase, long long chiffres1, long long chiffres2, const char *niveau, const char *mot) {
+    if (!tamponTraceThread) {
+        tamponTraceThread = (malloc)(sizeof(tamponTrace)); // Hors comptabilité: la trace n'est pas une donnée du calcul.
+        if (!tamponTraceThread)
+            return; // Pas de mémoire pour la trace: l'événement est perdu, le calcul continue.
+        tamponTraceThread->longueur = 0;
+        tamponTraceThread->tid = atomic_fetch_add(&prochainTidTrace, 1);
+    }
+    if (tamponTraceThread->longueur == TAILLE_TAMPON_TRACE)
+        viderTrace();
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    evenementTrace *e = &tamponTraceThread->evenements[tamponTraceThread->longueur++];
+    e->nom = nom;
+    e->phase = phase;
+    e->ns = (long long) (t.tv_sec - origineTrace.tv_sec) * 1000000000LL + (t.tv_nsec - origineTrace.tv_nsec);
+    e->chiffres1 = chiffres1;
+    e->chiffres2 = chiffres2;
+    e->niveau = niveau;
+    e->mot[0] = '\0';
+    if (mot) { // Seul le début du mot est gardé: un littéral peut avoir des millions de chiffres.
+        strncpy(e->mot, mot, sizeof(e->mot) - 1);
+        e->mot[sizeof(e->mot) - 1] = '\0';
+    }
+}
+
+void viderTrace(void) {
+    int i;
+    if (!fichierTrace || !tamponTraceThread)
+        return;
+    flockfile(fichierTrace); // Les threads vident leurs tampons dans le même fichier.
+    for (i = 0; i < tamponTraceThread->longueur; i++) {
+        evenementTrace *e = &tamponTraceThread->evenements[i];
+        fprintf(fichierTrace, "%s\n{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %lld.%03lld, \"pid\": 1, \"tid\": %d",
+                premierEvenementTrace ? "" : ",", e->nom, e->phase, e->ns / 1000, e->ns % 1000, tamponTraceThread->tid);
+        premierEvenementTrace = 0;
+        if (e->chiffres1 >= 0 || e->chiffres2 >= 0 || e->niveau || e->mot[0]) {
+            int premierArgument = 1;
+            fprintf(fichierTrace, ", \"args\": {");
+            if (e->mot[0]) {
+                char *p;
+                fprintf(fichierTrace, "\"mot\": \"");
+                for (p = e->mot; *p; p++)
+                    fprintf(fichierTrace, (*p == '"' || *p == '\\') ? "\\%c" : "%c", *p);
+                fprintf(fichierTrace, "\"");
+                premierArgument = 0;
             }
-            if (!isEqual(val1, resultat) && !val1->compteurRef)
-                deleteNumber(val1);
-            if (push(stack, resultat)) {
-                if (!resultat->compteurRef)
-                    deleteNumber(resultat);
-                return 1; // Out of Memory
+            if (e->chiffres1 >= 0) {
+                fprintf(fichierTrace, "%s\"chiffres1\": %lld", premierArgument ? "" : ", ", e->chiffres1);
+                premierArgument = 0;
             }
-            return 0; // Tout s'est bien passé
+            if (e->chiffres2 >= 0) {
+                fprintf(fichierTrace, "%s\"chiffres2\": %lld", premierArgument ? "" : ", ", e->chiffres2);
+                premierArgument = 0;
+            }
+            if (e->niveau)
+                fprintf(fichierTrace, "%s\"niveau\": \"%s\"", premierArgument ? "" : ", ", e->niveau);
+            fprintf(fichierTrace, "}");
         }
-        return 2; // Erreur de Syntaxe: impossible de pop un opérande.
+        fprintf(fichierTrace, "}");
     }
-    return 2; // Ni literral, ni binaire, ni unaire ( ? et =a)
+    funlockfile(fichierTrace);
+    tamponTraceThread->longueur = 0;
 }
 
-num* evaluerOpBin(num *nombre1, num *nombre2, char operator) {
-    num* resultat = malloc(sizeof(num));
-    if (!resultat)
-        return NULL;
-    num *temp = NULL;
+void fermerTrace(void) {
+    if (!fichierTrace)
+        return;
+    viderTrace();
+    fprintf(fichierTrace, "\n]}\n");
+    fclose(fichierTrace);
+    fichierTrace = NULL;
+    (free)(tamponTraceThread);
+    tamponTraceThread = NULL;
+}
 
-    switch(operator) {
+const char* niveauNoyau(char *mot, int chiffres1, int chiffres2) {
+    if (!strcmp(mot, "gcd"))
+        return "tranches-lehmer";
+    if (!strcmp(mot, "sqrt"))
+        return "tranches-newton";
+    if (!strcmp(mot, "len") || !strcmp(mot, "head"))
+        return "liste";
+    switch (*mot) {
         case '+':
-            temp = addition(nombre1, nombre2); break;
-        case '-':
-            temp = soustraction(nombre1, nombre2); break;
-        case '*':
-            temp = multiplication(nombre1, nombre2); break;
+        case '-': // Comme addition et soustraction: sur des blocs de tranches si le plus long est assez grand.
+            if (threadsCalcul() > 1
+                && (chiffres1 > chiffres2 ? chiffres1 : chiffres2) >= SEUIL_ADDITION_PARALLELE * CHIFFRES_TRANCHE)
+                return "tranches-parallele";
+            return "liste";
+        case '*': // Comme multiplicationTableaux: scolaire tant que le plus court n'a pas SEUIL_KARATSUBA tranches.
+            if (((chiffres1 < chiffres2 ? chiffres1 : chiffres2) + CHIFFRES_TRANCHE - 1) / CHIFFRES_TRANCHE < SEUIL_KARATSUBA)
+                return "tranches-scolaire";
+            return "tranches-karatsuba";
+        case '!':
+            return "tranches-karatsuba";
         default:
-            free(resultat); return NULL;
+            return "memoire"; // ? et =x ne font aucun calcul sur les chiffres.
     }
+}
 
-    if (copyNum(temp, resultat)) {
-        if(resultat)
-            deleteNumber(resultat);
-        if (temp)
-            deleteNumber(temp);
-        return NULL;
+
+#ifdef STATS
+
+/* STATISTIQUES */
+
+const char *nomsCategories[NOMBRE_CATEGORIES] = {"+", "-", "*", "gcd", "!", "sqrt", "?", "=x", "litteral", "variable",
+                                                  "len", "head"};
+
+int categorieStats(char *mot) {
+    if (!mot)
+        return -1;
+    if (validLiteral(mot))
+        return (*mot >= '0' && *mot <= '9') ? 8 : 9;
+    if (!strcmp(mot, "gcd"))
+        return 3;
+    if (!strcmp(mot, "sqrt"))
+        return 5;
+    if (!strcmp(mot, "len"))
+        return 10;
+    if (!strcmp(mot, "head"))
+        return 11;
+    switch (*mot) {
+        case '+': return 0;
+        case '-': return 1;
+        case '*': return 2;
+        case '!': return 4;
+        case '?': return 6;
+        case '=': return 7;
+        default: return -1;
     }
+}
 
-    deleteNumber(temp);
-    return resultat;
+int postfixeEvaluationMesuree(memoire *buffer, memoire *mem, pile *stack, char *mot) {
+    int categorie = categorieStats(mot);
+    if (categorie < 0) // Mot hors langage: rien à mesurer.
+        return postfixeEvaluation(buffer, mem, stack, mot);
+
+    // Taille des opérandes: longueur du littéral, sinon le plus grand des nombres consommés sur la pile.
+    long long chiffres = 0;
+    if (categorie == 8)
+        chiffres = (long long) strlen(mot);
+    else if (categorie == 9) {
+        variable *ptr = rechercherVar(buffer, mot, empreinteNom(mot));
+        if (!ptr)
+            ptr = rechercherVar(mem, mot, empreinteNom(mot));
+        chiffres = ptr ? findLenNum(ptr->nombre) : 0;
+    }
+    else if (stack->top) {
+        chiffres = findLenNum(stack->top->nombre);
+        if (validOpBin(mot) && stack->top->suivant && findLenNum(stack->top->suivant->nombre) > chiffres)
+            chiffres = findLenNum(stack->top->suivant->nombre);
+    }
+
+    unsigned long long allocations = stats.allocations, octets = stats.octets;
+    struct timespec debut, fin;
+    clock_gettime(CLOCK_MONOTONIC, &debut);
+    int erreur = postfixeEvaluation(buffer, mem, stack, mot);
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+    unsigned long long duree = (unsigned long long) ((fin.tv_sec - debut.tv_sec) * 1000000000LL + (fin.tv_nsec - debut.tv_nsec));
+
+    // Les allocations du mot sont l'écart des compteurs globaux: celles de ses tâches sur les threads de calcul y sont,
+    // mais aussi, dans le serveur, celles des sessions évaluées au même moment.
+    statsOperateur *op = &stats.operateurs[categorie];
+    STATS_AJOUTER(op->appels, 1);
+    STATS_AJOUTER(op->nanosecondes, duree);
+    STATS_AJOUTER(op->allocations, stats.allocations - allocations);
+    STATS_AJOUTER(op->octets, stats.octets - octets);
+    unsigned long long latenceMax = atomic_load_explicit(&op->latenceMax, memory_order_relaxed);
+    while (duree > latenceMax && !atomic_compare_exchange_weak_explicit(&op->latenceMax, &latenceMax, duree,
+                                                                         memory_order_relaxed, memory_order_relaxed))
+        ; // latenceMax est relue par l'échec de l'échange.
+
+    int seau = (int) duree; // Seau HDR: linéaire sous SOUS_SEAUX, puis 8 sous-seaux par puissance de 2.
+    if (duree >= SOUS_SEAUX) {
+        int exposant = 63 - __builtin_clzll(duree);
+        seau = (exposant - 2) * SOUS_SEAUX + (int) ((duree >> (exposant - 3)) & (SOUS_SEAUX - 1));
+    }
+    STATS_AJOUTER(op->latence[seau < SEAUX_LATENCE ? seau : SEAUX_LATENCE - 1], 1);
+
+    int decade = 0;
+    while (chiffres >= 10 && decade < SEAUX_TAILLE - 1) {
+        chiffres /= 10;
+        decade++;
+    }
+    STATS_AJOUTER(op->taille[decade], 1);
+    return erreur;
 }
 
-int nombreChiffre(int n) {
-    if (n < 10)
-        return 1;
-    return 1 + nombreChiffre(n / 10);
-} // Compter le nombre de chiffres que prend le compteur de reference (p.e 4560 prend 4 chiffres en longueur)
+void ecrireStats(const char *texte) {
+    if (write(2, texte, strlen(texte)) < 0)
+        return;
+}
 
-num* evaluerOpUn(memoire *buffer, memoire *mem, pile *stack, num *nombre, char *opun) {
-    num *resultat, *num2, *num3, *num4;
-    char str[nombreChiffre(nombre->compteurRef)];
+void ecrireEntierStats(unsigned long long n) {
+    char chaine[24];
+    int i = 24;
+    do {
+        chaine[--i] = (char) ('0' + n % 10);
+        n /= 10;
+    } while (n);
+    if (write(2, chaine + i, (size_t) (24 - i)) < 0)
+        return;
+}
 
-    if (opun) {
-        int longueur = (int) strlen(opun);
-        switch(longueur) {
-            case 1: // Cas où l'on veut obtenir le compteur de référence d'un nombre.
-                if (sprintf(str, "%d", nombre->compteurRef) < 0)
-                    return NULL;
-                resultat = transformationStructure(buffer,mem, stack, str); // Fais la verif checkMem etc.
-                if (!resultat)
-                    return NULL;
-                if (isEqual(nombre, resultat)) {
-                    deleteNumber(resultat);
-                    resultat = nombre;
-                }
-                return resultat;
+unsigned long long percentileStats(statsOperateur *op, int pourcent) {
+    unsigned long long cumul = 0, rang = (op->appels * (unsigned long long) pourcent + 99) / 100;
+    int seau;
+    for (seau = 0; seau < SEAUX_LATENCE; seau++) {
+        cumul += op->latence[seau];
+        if (cumul >= rang && cumul) { // Borne inférieure du seau.
+            if (seau < SOUS_SEAUX)
+                return (unsigned long long) seau;
+            return (unsigned long long) (SOUS_SEAUX + seau % SOUS_SEAUX) << (seau / SOUS_SEAUX - 1);
+        }
+    }
+    return op->latenceMax;
+}
 
-            case 2:
-                if (affecterVal(buffer, opun[1], nombre))
-                    return NULL;
-                return nombre;
-            default:
-                break;
+void afficherStats(void) {
+    int i, j;
+    ecrireStats("=== Statistiques ===\nallocations: ");
+    ecrireEntierStats(stats.allocations);
+    ecrireStats(" (");
+    ecrireEntierStats(stats.octets);
+    ecrireStats(" octets)\ncheckPile: ");
+    ecrireEntierStats(stats.recherchesPile);
+    ecrireStats(" recherches, ");
+    ecrireEntierStats(stats.trouvesPile);
+    ecrireStats(" trouvés\ncheckMem: ");
+    ecrireEntierStats(stats.recherchesMem);
+    ecrireStats(" recherches, ");
+    ecrireEntierStats(stats.trouvesMem);
+    ecrireStats(" trouvés\n");
+
+    for (i = 0; i < NOMBRE_CATEGORIES; i++) {
+        statsOperateur *op = &stats.operateurs[i];
+        if (!op->appels)
+            continue;
+        ecrireStats(nomsCategories[i]);
+        ecrireStats(": appels ");
+        ecrireEntierStats(op->appels);
+        ecrireStats(", total ");
+        ecrireEntierStats(op->nanosecondes);
+        ecrireStats(" ns, p50 ");
+        ecrireEntierStats(percentileStats(op, 50));
+        ecrireStats(" ns, p90 ");
+        ecrireEntierStats(percentileStats(op, 90));
+        ecrireStats(" ns, p99 ");
+        ecrireEntierStats(percentileStats(op, 99));
+        ecrireStats(" ns, max ");
+        ecrireEntierStats(op->latenceMax);
+        ecrireStats(" ns, allocations ");
+        ecrireEntierStats(op->allocations);
+        ecrireStats(" (");
+        ecrireEntierStats(op->octets);
+        ecrireStats(" octets)\n    chiffres:");
+        unsigned long long borne = 1;
+        for (j = 0; j < SEAUX_TAILLE; j++, borne *= 10) {
+            if (!op->taille[j])
+                continue;
+            ecrireStats(" >=");
+            ecrireEntierStats(borne);
+            ecrireStats(":");
+            ecrireEntierStats(op->taille[j]);
         }
+        ecrireStats("\n");
     }
-    return NULL;
 }
 
-int validLiteral(char *nombre) {
-    if (!nombre)
-        return 0;
-    int longueurLiteral = (int) strlen(nombre);
-    if (longueurLiteral == 1 && *nombre >= 'a' && *nombre <= 'z')
-        return 1; // Accepter 'a', 'b', 'c'
-    if (longueurLiteral > 1 && *nombre == '0')
-        return 0; // Cas 0123 , 004324 mais on garde juste 0;
-    int i;
-    for(i = 0; i < longueurLiteral; i++)
-        if (!(*(nombre+i) >= '0' && *(nombre+i) <= '9'))
-            return 0;
-    return 1;
+void signalStats(int signal) {
+    (void) signal;
+    afficherStats();
 }
 
-int validOpBin(char *opbin) {
-    if (!opbin)
-        return 0;
-    int longueur = (int) strlen(opbin);
-    if (longueur > 1 || (*opbin != '+' && *opbin != '-' && *opbin != '*'))
-        return 0;
+#endif
+
+
+#ifndef LIBCALC
+
+/* PIPELINE */
+
+int pipeline(memoire *mem) {
+    ligneLue lignes[TAILLE_FILE], lue;
+    morceauSortie *pleins[TAILLE_FILE], *libres[TAILLE_FILE], *morceaux = NULL, *fin = NULL;
+    fileSPSC fileLignes, filePleins, fileLibres;
+    sortiePipeline etat = {&filePleins, &fileLibres, NULL};
+    cookie_io_functions_t fonctions = {NULL, ecrirePipeline, NULL, NULL};
+    pthread_t lecteur, ecrivain;
+    FILE *sortie = NULL;
+    int i;
+
+    initFile(&fileLignes, lignes, sizeof(ligneLue));
+    initFile(&filePleins, pleins, sizeof(morceauSortie*));
+    initFile(&fileLibres, libres, sizeof(morceauSortie*));
+    // Tampons de transit hors comptabilité, comme ceux de stdout: ils ne sont pas des données du calcul.
+    morceaux = (malloc)(sizeof(morceauSortie) * TAILLE_FILE);
+    if (!morceaux || !(sortie = fopencookie(&etat, "w", fonctions)))
+        goto deletePipeline;
+    for (i = 0; i < TAILLE_FILE; i++) {
+        morceauSortie *morceau = &morceaux[i];
+        deposerFile(&fileLibres, &morceau);
+    }
+    if (pthread_create(&ecrivain, NULL, threadEcrivain, &etat))
+        goto deletePipeline;
+    if (pthread_create(&lecteur, NULL, threadLecteur, &fileLignes)) {
+        deposerFile(&filePleins, &fin);
+        pthread_join(ecrivain, NULL);
+        goto deletePipeline;
+    }
+
+    while (1) {
+        fputs("> ", sortie);
+        if (fileVide(&fileLignes)) { // Rien à évaluer tout de suite: ce qui est prêt part avant l'attente.
+            fflush(sortie);
+            publierSortie(&etat);
+        }
+        retirerFile(&fileLignes, &lue);
+        if (lue.lecture == LIGNE_FIN_FICHIER)
+            break; // Fin de fichier, le programme peut s'arrêter.
+        // La ligne lue d'avance est comptée maintenant, comme si elle venait d'être lue.
+        if (lue.lecture == LIGNE_OUT_OF_MEMORY || (rattacherBloc(lue.ligne) | rattacherBloc(lue.decoupee.mots)))
+            afficherErreur(sortie, 1);
+        else
+            evaluerMots(mem, &lue.decoupee, sortie);
+        free(lue.decoupee.mots);
+        free(lue.ligne);
+        viderTrace(); // Entre deux lignes, hors du calcul.
+        if (lue.lecture == LIGNE_DERNIERE)
+            break; // Dernière ligne sans '\n'
+    }
+    fflush(sortie);
+    publierSortie(&etat);
+    deposerFile(&filePleins, &fin);
+    pthread_join(lecteur, NULL);
+    pthread_join(ecrivain, NULL);
+    fclose(sortie);
+    (free)(morceaux);
+    detruireFile(&fileLignes);
+    detruireFile(&filePleins);
+    detruireFile(&fileLibres);
+    return 0;
+
+    deletePipeline:
+    if (sortie)
+        fclose(sortie);
+    (free)(morceaux);
+    detruireFile(&fileLignes);
+    detruireFile(&filePleins);
+    detruireFile(&fileLibres);
     return 1;
 }
 
-int validOpUn(char *opun) {
-    if (!opun)
-        return 0;
+void initFile(fileSPSC *file, void *cases, size_t tailleElement) {
+    file->cases = cases;
+    file->tailleElement = tailleElement;
+    atomic_init(&file->tete, 0);
+    atomic_init(&file->queue, 0);
+    atomic_init(&file->enAttente, 0);
+    pthread_mutex_init(&file->verrou, NULL);
+    pthread_cond_init(&file->reveil, NULL);
+}
 
-    int longueur = (int) strlen(opun);
-    if (longueur == 1 && opun[0] == '?')
-        return 1;
-    else if (longueur == 2 && opun[0] == '=' && opun[1] >= 'a' && opun[1] <= 'z')
-        return 1;
-    return 0;
+void detruireFile(fileSPSC *file) {
+    pthread_mutex_destroy(&file->verrou);
+    pthread_cond_destroy(&file->reveil);
 }
 
-void initPile(pile *stack) {
-    stack->length = 0;
-    stack->top = NULL;
+void deposerFile(fileSPSC *file, const void *element) {
+    size_t queue = atomic_load_explicit(&file->queue, memory_order_relaxed);
+    if (queue - atomic_load(&file->tete) == TAILLE_FILE)
+        attendreFile(file, &file->tete, queue - TAILLE_FILE / 2);
+    memcpy(file->cases + (queue % TAILLE_FILE) * file->tailleElement, element, file->tailleElement);
+    atomic_store(&file->queue, queue + 1); // Publie la case remplie.
+    if (atomic_load(&file->enAttente))
+        reveillerFile(file);
 }
 
-int isEmpty(pile* stack) {
-    if (stack->top)
-        return 0;
-    return 1;
+void retirerFile(fileSPSC *file, void *element) {
+    size_t tete = atomic_load_explicit(&file->tete, memory_order_relaxed);
+    if (atomic_load(&file->queue) == tete)
+        attendreFile(file, &file->queue, tete + 1);
+    memcpy(element, file->cases + (tete % TAILLE_FILE) * file->tailleElement, file->tailleElement);
+    atomic_store(&file->tete, tete + 1); // Rend la case au producteur.
+    if (atomic_load(&file->enAttente) && atomic_load(&file->queue) - (tete + 1) <= TAILLE_FILE / 2)
+        reveillerFile(file);
 }
 
-int push(pile* stack, num *nombre) { // 1 si out of memory, 0 sinon
-    node *noeud = malloc(sizeof(node));
-    if(!noeud)
-        return 1;
-    else {
-        noeud->nombre = nombre;
-        noeud->nombre->compteurRef++;
-        noeud->suivant = stack->top;
-        stack->top = noeud;
-        stack->length++;
-        return 0;
-    }
+int fileVide(fileSPSC *file) {
+    return atomic_load(&file->queue) == atomic_load(&file->tete);
 }
 
-num* pop(pile* stack) {
-    node *noeud;
-    num *nombre;
+void attendreFile(fileSPSC *file, atomic_size_t *indice, size_t seuil) {
+    int essai;
+    for (essai = 0; essai < ESSAIS_ACTIFS; essai++)
+        if (atomic_load(indice) >= seuil)
+            return; // L'autre thread était sur le point de publier.
+    // enAttente est incrémenté avant de relire l'indice: l'autre thread, qui écrit l'indice avant de lire enAttente,
+    // voit donc l'attente s'il n'a pas vu sa propre écriture être relue ici.
+    pthread_mutex_lock(&file->verrou);
+    atomic_fetch_add(&file->enAttente, 1);
+    while (atomic_load(indice) < seuil)
+        pthread_cond_wait(&file->reveil, &file->verrou);
+    atomic_fetch_sub(&file->enAttente, 1);
+    pthread_mutex_unlock(&file->verrou);
+}
 
-    if(isEmpty(stack))
-        return NULL;
-    noeud = stack->top;
-    stack->top = noeud->suivant;
-    nombre = noeud->nombre;
-    free(noeud);
-    stack->length--;
+void reveillerFile(fileSPSC *file) {
+    pthread_mutex_lock(&file->verrou);
+    pthread_cond_broadcast(&file->reveil);
+    pthread_mutex_unlock(&file->verrou);
+}
 
-    if (!stack->length)
-        stack->top = NULL;
-    nombre->compteurRef--;
-    return nombre;
+void* threadLecteur(void *argument) {
+    fileSPSC *lignes = argument;
+    ligneLue lue;
+    allocationsDetachees = 1;
+    do {
+        lue.ligne = NULL;
+        lue.decoupee.mots = NULL;
+        lue.lecture = lireLigne(stdin, &lue.ligne);
+        if (lue.lecture == LIGNE_LUE || lue.lecture == LIGNE_DERNIERE)
+            decouperLigne(lue.ligne, &lue.decoupee);
+        deposerFile(lignes, &lue);
+    } while (lue.lecture == LIGNE_LUE || lue.lecture == LIGNE_OUT_OF_MEMORY);
+    return NULL;
 }
 
-num* checkPile(num *nombre, pile* stack) {
-    node *ptr = stack->top;
-    while(ptr) {
-        if (isEqual(nombre, ptr->nombre))
-            return ptr->nombre; // On a trouvé un nombre égal à nombre dans la pile
-        ptr = ptr->suivant;
+void* threadEcrivain(void *argument) {
+    sortiePipeline *sortie = argument;
+    morceauSortie *morceau;
+    while (1) {
+        retirerFile(sortie->pleins, &morceau);
+        if (!morceau)
+            break;
+        fwrite(morceau->donnees, 1, morceau->longueur, stdout);
+        if (fileVide(sortie->pleins))
+            fflush(stdout); // Plus rien en attente: le lecteur de la sortie voit la ligne sans attendre la suivante.
+        deposerFile(sortie->libres, &morceau);
     }
+    fflush(stdout);
     return NULL;
 }
 
-void deletePile(pile* stack) {
-    num *nombre = pop(stack);
-    while (nombre) {
-        if (!nombre->compteurRef)
-            deleteNumber(nombre);
-        nombre = pop(stack);
+ssize_t ecrirePipeline(void *cookie, const char *donnees, size_t taille) {
+    sortiePipeline *sortie = cookie;
+    size_t ecrits = 0;
+    while (ecrits < taille) {
+        if (!sortie->courant) {
+            retirerFile(sortie->libres, &sortie->courant);
+            sortie->courant->longueur = 0;
+        }
+        size_t place = TAILLE_MORCEAU_SORTIE - sortie->courant->longueur;
+        size_t n = taille - ecrits < place ? taille - ecrits : place;
+        memcpy(sortie->courant->donnees + sortie->courant->longueur, donnees + ecrits, n);
+        sortie->courant->longueur += n;
+        ecrits += n;
+        if (sortie->courant->longueur == TAILLE_MORCEAU_SORTIE)
+            publierSortie(sortie);
     }
-    free(stack);
+    return (ssize_t) taille;
 }
 
-num* addition(num *nombre1, num *nombre2) { // Addition de deux entiers positifs
-    num* temp;
-    num* resultatSomme = malloc(sizeof(num));
-    if (!resultatSomme)
-        return NULL;
+void publierSortie(sortiePipeline *sortie) {
+    if (!sortie->courant || !sortie->courant->longueur)
+        return;
+    deposerFile(sortie->pleins, &sortie->courant);
+    sortie->courant = NULL;
+}
 
-    // En cas d'addition avec 0
-    if (!nombre1->chiffres && nombre2->chiffres) { // 0 + (-1234) ou 0 + 1234, il suffit de renvoyer num2
-        if (copyNum(nombre2, resultatSomme))
-            goto deleteSomme;
-        return resultatSomme;
-    }
-    else if (nombre1->chiffres && !nombre2->chiffres) { // 1234 + 0 ou -1234 + 0.
-        if (copyNum(nombre1, resultatSomme))
-            goto deleteSomme;
-        return resultatSomme;
-    }
-    else if (!nombre1->chiffres && !nombre2->chiffres) { // 0 + 0
-        resultatSomme->negatif = 0;
-        resultatSomme->chiffres = NULL;
-        return resultatSomme;
+
+/* LOTS */
+
+int lots(memoire *mem) {
+    // Tableaux de travail hors comptabilité, comme les tampons du pipeline: les lignes et les nombres restent comptés.
+    ligneLot *lignes = (malloc)(sizeof(ligneLot) * TAILLE_LOT);
+    long long *valeurs = (malloc)(sizeof(long long) * TAILLE_LOT * MOTS_LOT), *colonnes;
+    formeLot *formes = (malloc)(sizeof(formeLot) * FORMES_LOT);
+    attenteLot *attente = (malloc)(sizeof(attenteLot));
+    char motif[MOTS_LOT + 1], tampon[32] = "> ";
+    int nombreLignes, nombreFormes, operandes, fin = 0, finFichier = 0, i, j, k;
+
+    if (!lignes || !valeurs || !formes || !attente) {
+        (free)(lignes);
+        (free)(valeurs);
+        (free)(formes);
+        (free)(attente);
+        return 1;
     }
+    attente->debut = attente->nombre = 0;
+
+    while (!fin) {
+        // Lecture du lot. Chaque ligne simple rejoint sa forme, et ses littéraux la suite de ceux du lot. Comme dans le
+        // pipeline, les lignes lues d'avance ne sont comptées qu'au moment de leur évaluation.
+        nombreLignes = nombreFormes = operandes = 0;
+        allocationsDetachees = 1;
+        while (!fin && nombreLignes < TAILLE_LOT) {
+            ligneLot *l = &lignes[nombreLignes];
+            l->ligne = NULL;
+            l->forme = -1;
+            l->lecture = lireLigne(stdin, &l->ligne);
+            if (l->lecture == LIGNE_FIN_FICHIER) {
+                fin = finFichier = 1;
+                break;
+            }
+            nombreLignes++;
+            fin = l->lecture == LIGNE_DERNIERE;
+            if (l->lecture == LIGNE_OUT_OF_MEMORY || (k = classerLigneLot(l->ligne, motif, valeurs + operandes, &l->silencieuse)) < 0)
+                continue;
+            for (j = 0; j < nombreFormes && strcmp(formes[j].motif, motif); j++)
+                ;
+            if (j == nombreFormes) {
+                if (nombreFormes == FORMES_LOT)
+                    continue;
+                strcpy(formes[j].motif, motif);
+                formes[j].operandes = k;
+                formes[j].lignes = 0;
+                nombreFormes++;
+            }
+            l->forme = j;
+            l->rang = formes[j].lignes++;
+            l->debut = operandes;
+            operandes += k;
+        }
+        allocationsDetachees = 0;
 
-    // En cas d'addition de nombre négatifs
-    if(nombre1->negatif && nombre2->negatif)
-        resultatSomme->negatif = 1; // Si on fait (-1234) + (-1234) = - (1234 + 1234)
-    else if (!nombre1->negatif && nombre2->negatif) { // Si on fait 1234 + (-1234) = 1234 - 1234
-        nombre2->negatif = 0;
-        temp= soustraction(nombre1,nombre2);
-        if (!temp)
-            goto deleteSomme;
-        if (copyNum(temp, resultatSomme))
-            goto deleteTempSomme;
-        deleteNumber(temp);
-        nombre2->negatif = 1;
-        return resultatSomme;
+        // Rangement en colonnes, puis évaluation forme par forme. Sans mémoire, tout le lot passe par evaluerLigne.
+        colonnes = operandes ? (malloc)(sizeof(long long) * (size_t) operandes) : NULL;
+        if (operandes && !colonnes) {
+            for (i = 0; i < nombreLignes; i++)
+                lignes[i].forme = -1;
+        }
+        else {
+            for (j = 0, k = 0; j < nombreFormes; j++) {
+                formes[j].colonnes = colonnes + k;
+                k += formes[j].operandes * formes[j].lignes;
+            }
+            for (i = 0; i < nombreLignes; i++) {
+                formeLot *forme = &formes[lignes[i].forme < 0 ? 0 : lignes[i].forme];
+                for (k = 0; lignes[i].forme >= 0 && k < forme->operandes; k++)
+                    forme->colonnes[(size_t) k * forme->lignes + lignes[i].rang] = valeurs[lignes[i].debut + k];
+            }
+            for (j = 0; j < nombreFormes; j++)
+                evaluerFormeLot(&formes[j]);
+        }
+
+        // Affichage dans l'ordre des lignes, avec l'invite de la console avant chacune.
+        for (i = 0; i < nombreLignes; i++) {
+            ligneLot *l = &lignes[i];
+            if (l->lecture == LIGNE_OUT_OF_MEMORY || rattacherBloc(l->ligne))
+                printf("> Out of Memory. Le programme n'a plus assez de mémoire pour fonctionner normalement.\n");
+            else if (l->forme < 0 || mem->baseSortie != 10) { // obase change l'affichage: afficherNombre s'en charge.
+                garderResultatsLot(mem, attente); // La ligne peut lire l'historique ($-1, #hist).
+                printf("> ");
+                evaluerLigne(mem, l->ligne, stdout);
+                viderTrace(); // Entre deux lignes, hors du calcul.
+            }
+            else if (l->silencieuse)
+                fputs("> ", stdout);
+            else {
+                long long valeur = formes[l->forme].colonnes[l->rang];
+                int longueur = 2 + ecrireEntierLot(tampon + 2, valeur);
+                tampon[longueur++] = '\n';
+                fwrite(tampon, 1, (size_t) longueur, stdout);
+                attendreResultatLot(mem, attente, valeur);
+            }
+            free(l->ligne);
+        }
+        (free)(colonnes);
     }
-    else if (nombre1->negatif && !nombre2->negatif) { // Si on fait -1234 + 33
-        nombre1->negatif = 0;
-        temp= soustraction(nombre2,nombre1);
-        if (!temp)
-            goto deleteSomme;
-        if (copyNum(temp, resultatSomme))
-            goto deleteTempSomme;
-        deleteNumber(temp);
-        nombre1->negatif = 1;
-        return resultatSomme;
+    if (finFichier)
+        printf("> "); // Invite laissée par la console avant de lire la fin de fichier.
+    // Les résultats encore en attente ne sont pas gardés: plus aucune ligne ne peut les lire.
+
+    (free)(lignes);
+    (free)(valeurs);
+    (free)(formes);
+    (free)(attente);
+    return 0;
+}
+
+int classerLigneLot(const char *ligne, char *motif, long long *valeurs, int *silencieuse) {
+    int chiffres[MOTS_LOT], hauteur = 0, mots = 0, operandes = 0;
+    size_t longueur = strlen(ligne), debut, i = 0, j;
+
+    *silencieuse = longueur && ligne[longueur - 1] == ';';
+    if (*silencieuse && --longueur && ligne[longueur - 1] == ' ')
+        longueur--; // "a b +;" ou "a b + ;", comme decouperLigne.
+    if (!longueur || ligne[longueur - 1] == ' ')
+        return -1; // Ligne vide ou espace final: erreur de syntaxe, affichée par evaluerLigne.
+    for (debut = 0; debut < longueur; debut = i + 1) {
+        for (i = debut; i < longueur && ligne[i] != ' '; i++)
+            ;
+        if (i == debut || mots == MOTS_LOT)
+            return -1;
+        char mot = ligne[debut];
+        if (i - debut == 1 && (mot == '+' || mot == '-' || mot == '*')) {
+            if (hauteur < 2)
+                return -1;
+            hauteur--;
+            int a = chiffres[hauteur - 1], b = chiffres[hauteur];
+            chiffres[hauteur - 1] = mot == '*' ? a + b : (a > b ? a : b) + 1;
+            if (chiffres[hauteur - 1] > CHIFFRES_LOT)
+                return -1;
+        }
+        else {
+            if (i - debut > CHIFFRES_LOT || (i - debut > 1 && mot == '0'))
+                return -1; // Trop grand, ou zéro initial (erreur de syntaxe, ou littéral 0x, 0b).
+            long long valeur = 0;
+            for (j = debut; j < i; j++) {
+                if (ligne[j] < '0' || ligne[j] > '9')
+                    return -1; // Variable, historique, commande ou opérateur d'une autre sorte.
+                valeur = valeur * 10 + (ligne[j] - '0');
+            }
+            valeurs[operandes++] = valeur;
+            chiffres[hauteur++] = (int) (i - debut);
+            mot = 'n';
+        }
+        motif[mots++] = mot;
     }
-    else
-        resultatSomme->negatif = 0;
+    if (hauteur != 1)
+        return -1;
+    motif[mots] = '\0';
+    return operandes;
+}
 
-    // Sinon on fait l'addition
-    int sommeIntermediaire;
-    int reste = 0;
+void evaluerFormeLot(formeLot *forme) {
+    long long *pile[MOTS_LOT];
+    int hauteur = 0, k = 0;
+    const char *mot;
+    // Le premier mot est un littéral: sa colonne reste au fond de la pile et reçoit le résultat.
+    for (mot = forme->motif; *mot; mot++) {
+        if (*mot == 'n')
+            pile[hauteur++] = forme->colonnes + (size_t) k++ * forme->lignes;
+        else {
+            hauteur--;
+            operationLot(pile[hauteur - 1], pile[hauteur], forme->lignes, *mot);
+        }
+    }
+}
 
-    resultatSomme->chiffres = NULL;
-    cell *chiffre1 = nombre1->chiffres; // Pointeur sur le premier chiffre de num1
-    cell *chiffre2 = nombre2->chiffres; // Pointeur sur le premier chiffre de num2
+// Boucle vectorielle de operationLot: les colonnes ne sont pas alignées, memcpy donne des chargements non alignés.
+#define BOUCLE_LOT(a, b, n, i, operation) do { \
+    voiesLot x, y; \
+    for (; i + VOIES_LOT <= n; i += VOIES_LOT) { \
+        memcpy(&x, a + i, sizeof(x)); \
+        memcpy(&y, b + i, sizeof(y)); \
+        x operation y; \
+        memcpy(a + i, &x, sizeof(x)); \
+    } \
+    for (; i < n; i++) \
+        a[i] operation b[i]; \
+} while (0)
+
+void operationLot(long long *a, const long long *b, int n, char operateur) {
+    int i = 0;
+    switch (operateur) {
+        case '+':
+            BOUCLE_LOT(a, b, n, i, +=);
+            break;
+        case '-':
+            BOUCLE_LOT(a, b, n, i, -=);
+            break;
+        default:
+            BOUCLE_LOT(a, b, n, i, *=);
+            break;
+    }
+}
 
-    while(chiffre1 && chiffre2) {
-        sommeIntermediaire = (chiffre1->chiffre - '0') + (chiffre2->chiffre - '0') + reste;
-        reste = sommeIntermediaire / 10;
-        if (addTailNum(resultatSomme, (char) (sommeIntermediaire % 10 + '0')))
-            goto deleteSomme;
-        chiffre1 = chiffre1->suivant;
-        chiffre2 = chiffre2->suivant;
+int ecrireEntierLot(char *tampon, long long valeur) {
+    char chiffres[20];
+    int nombreChiffres = 0, longueur = 0;
+    unsigned long long reste = valeur < 0 ? 0ULL - (unsigned long long) valeur : (unsigned long long) valeur;
+    do {
+        chiffres[nombreChiffres++] = (char) ('0' + reste % 10);
+        reste /= 10;
+    } while (reste);
+    if (valeur < 0)
+        tampon[longueur++] = '-';
+    while (nombreChiffres)
+        tampon[longueur++] = chiffres[--nombreChiffres];
+    return longueur;
+}
+
+void attendreResultatLot(memoire *mem, attenteLot *attente, long long valeur) {
+    if (attente->nombre == TAILLE_HISTORIQUE) {
+        sauterHistorique(mem);
+        attente->debut = (attente->debut + 1) % TAILLE_HISTORIQUE;
+        attente->nombre--;
     }
+    attente->valeurs[(attente->debut + attente->nombre++) % TAILLE_HISTORIQUE] = valeur;
+}
 
-    while(chiffre1) {
-        sommeIntermediaire = (chiffre1->chiffre - '0') + reste;
-        reste = sommeIntermediaire / 10;
-        if (addTailNum(resultatSomme, (char) (sommeIntermediaire % 10 + '0')))
-            goto deleteSomme;
-        chiffre1 = chiffre1->suivant;
+void garderResultatsLot(memoire *mem, attenteLot *attente) {
+    for (; attente->nombre; attente->nombre--) {
+        // Out of memory: le résultat est perdu avec les plus anciens, comme un résultat plus grand que #hist max.
+        if (garderResultatLot(mem, attente->valeurs[attente->debut]))
+            sauterHistorique(mem);
+        attente->debut = (attente->debut + 1) % TAILLE_HISTORIQUE;
     }
+}
 
-    while(chiffre2) {
-        sommeIntermediaire = (chiffre2->chiffre - '0') + reste;
-        reste = sommeIntermediaire / 10;
-        if (addTailNum(resultatSomme, (char) (sommeIntermediaire % 10 + '0')))
-            goto deleteSomme;
-        chiffre2 = chiffre2->suivant;
+int garderResultatLot(memoire *mem, long long valeur) {
+    unsigned long long reste = valeur < 0 ? 0ULL - (unsigned long long) valeur : (unsigned long long) valeur;
+    num *nombre = malloc(sizeof(num)), *egal;
+    if (!nombre)
+        return 1; // Out of memory
+    nombre->compteurRef = 0;
+    nombre->negatif = valeur < 0;
+    nombre->chiffres = NULL;
+    cell **queue = &nombre->chiffres;
+    for (; reste; reste /= 10) {
+        cell *chiffre = malloc(sizeof(cell));
+        if (!chiffre) {
+            deleteNumber(nombre);
+            return 1;
+        }
+        chiffre->chiffre = (char) ('0' + reste % 10);
+        chiffre->suivant = NULL;
+        *queue = chiffre;
+        queue = &chiffre->suivant;
+    }
+    if ((egal = checkMem(nombre, mem))) { // La valeur d'une variable: même nombre, comme pour evaluerLigne.
+        deleteNumber(nombre);
+        nombre = egal;
+    }
+    if (reserverHistorique(mem)) {
+        if (!nombre->compteurRef)
+            deleteNumber(nombre);
+        return 1;
     }
+    ajouterHistorique(mem, nombre);
+    if (!nombre->compteurRef)
+        deleteNumber(nombre); // Plus grand que #hist max.
+    return 0;
+}
 
-    if (reste > 0 && addTailNum(resultatSomme, (char) (reste + '0')))
-        goto deleteSomme;
-    return resultatSomme;
+void sauterHistorique(memoire *mem) {
+    while (mem->nombreHistorique)
+        retirerHistorique(mem);
+    mem->premierHistorique++;
+}
 
-    deleteSomme:
-    deleteNumber(resultatSomme);
-    return NULL;
+#endif
 
-    deleteTempSomme:
-    deleteNumber(resultatSomme);
-    deleteNumber(temp);
-    return NULL;
+
+/* SERVEUR */
+
+long long maintenantNs(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long) t.tv_sec * 1000000000LL + t.tv_nsec;
 }
 
-num* soustraction(num *nombre1, num *nombre2) {
-    int soustractionIntermediaire;
-    int reste = 0;
-    cell* chiffre1, *chiffre2;
-    num *temp;
+int comparerDurees(const void *a, const void *b) {
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
 
-    num* resultatSoustraction = malloc(sizeof(num));
-    if (!resultatSoustraction)
-        return NULL;
+#ifndef LIBCALC
 
-    // En cas de soustraction avec 0
-    if (!nombre1->chiffres && nombre2->chiffres) { // 0 - 1234 ou 0 - (-1234)
-        if (copyNum(nombre2, resultatSoustraction))
-            goto deleteSous;
-        if (nombre2->negatif)
-            resultatSoustraction->negatif = 0; // 0 - (-1234) si num2 negatif, alors le resultat est positif.
-        else
-            resultatSoustraction->negatif = 1; // 0 - 1234 si c'est 1234, alors ca devient négatif
-        return resultatSoustraction;
+void signalArret(int signal) {
+    (void) signal;
+    arretServeur = 1;
+}
+
+int serveur(const char *chemin, int nombreTravailleurs) {
+    struct sockaddr_un adresse;
+    struct epoll_event evenement, evenements[EVENEMENTS_MAX];
+    struct stat etat;
+    pthread_t *threads = NULL;
+    session *s, *faites;
+    int ecoute = -1, epoll = -1, lances = 0, erreur = 1, reponsesPretes, i, n;
+    unsigned long long compteur;
+
+    if (strlen(chemin) >= sizeof(adresse.sun_path)) {
+        fprintf(stderr, "Chemin de socket trop long: %s\n", chemin);
+        return 1;
     }
-    else if (nombre1->chiffres && !nombre2->chiffres) { // 1234 - 0 ou -1234 - 0; On garde num1 seulement
-        if (copyNum(nombre1, resultatSoustraction))
-            goto deleteSous;
-        return resultatSoustraction;
+    memset(&adresse, 0, sizeof(adresse));
+    adresse.sun_family = AF_UNIX;
+    strcpy(adresse.sun_path, chemin);
+    if (!stat(chemin, &etat) && S_ISSOCK(etat.st_mode))
+        unlink(chemin); // Socket laissé par une exécution précédente. Un autre fichier n'est jamais écrasé.
+
+    ecoute = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ecoute < 0 || bind(ecoute, (struct sockaddr *) &adresse, sizeof(adresse)) || listen(ecoute, SOMAXCONN)) {
+        perror(chemin);
+        goto fin;
     }
-    else if (!nombre1->chiffres && !nombre2->chiffres) { // Cas 0 - 0
-        resultatSoustraction->negatif = 0;
-        resultatSoustraction->chiffres = NULL;
-        return resultatSoustraction;
+    travaux.reveil = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (travaux.reveil < 0 || epoll < 0) {
+        perror("epoll");
+        goto fin;
     }
-
-
-    // Traitement des cas négatifs
-    if(nombre1->negatif && nombre2->negatif) { // (-12) - (-11) =  11 - 12
-        nombre1->negatif = 0;
-        nombre2->negatif = 0;
-        temp = soustraction(nombre2, nombre1);
-        if (!temp)
-            goto deleteSous;
-        if (copyNum(temp, resultatSoustraction))
-            goto deleteTempSous;
-        deleteNumber(temp);
-        nombre1->negatif = 1;
-        nombre2->negatif = 1;
-        return resultatSoustraction;
+    evenement.events = EPOLLIN;
+    evenement.data.ptr = NULL; // Le socket d'écoute.
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, ecoute, &evenement)) {
+        perror("epoll_ctl");
+        goto fin;
     }
-    else if(nombre1->negatif && !nombre2->negatif) { // (-12) - (11) => - 12 - 11 = - (12+11) => addition(12,11) puis je prends le négatif
-        nombre1->negatif = 0;
-        temp = addition(nombre1, nombre2);
-        if (!temp)
-            goto deleteSous;
-        if (copyNum(temp, resultatSoustraction))
-            goto deleteTempSous;
-        deleteNumber(temp);
-        nombre1->negatif = 1;
-        resultatSoustraction->negatif = 1;
-        return resultatSoustraction;
+    evenement.data.ptr = &travaux; // L'eventfd des réponses.
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, travaux.reveil, &evenement)) {
+        perror("epoll_ctl");
+        goto fin;
     }
-    else if (!nombre1->negatif && nombre2->negatif) { // (12) - (-11) => addition(12,11) SEULEMENT
-        nombre2->negatif = 0;
-        temp = addition(nombre1, nombre2);
-        if (!temp)
-            goto deleteSous;
-        if (copyNum(temp, resultatSoustraction))
-            goto deleteTempSous;
-        deleteNumber(temp);
-        nombre2->negatif = 1;
-        return resultatSoustraction;
+
+    threads = malloc(sizeof(pthread_t) * (size_t) nombreTravailleurs);
+    if (!threads) {
+        fprintf(stderr, "Out of Memory.\n");
+        goto fin;
     }
+    for (lances = 0; lances < nombreTravailleurs; lances++) {
+        if (pthread_create(&threads[lances], NULL, travailleur, NULL)) {
+            fprintf(stderr, "Impossible de lancer les travailleurs.\n");
+            goto fin;
+        }
+    }
+    signal(SIGINT, signalArret);
+    signal(SIGTERM, signalArret);
+    erreur = 0;
+
+    while (!arretServeur) {
+        n = epoll_wait(epoll, evenements, EVENEMENTS_MAX, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            erreur = 1;
+            break;
+        }
+        reponsesPretes = 0;
+        for (i = 0; i < n; i++) {
+            if (!evenements[i].data.ptr)
+                accepterClients(epoll, ecoute);
+            else if (evenements[i].data.ptr == &travaux)
+                reponsesPretes = 1;
+            else {
+                s = evenements[i].data.ptr;
+                if (evenements[i].events & (EPOLLERR | EPOLLHUP))
+                    s->perdue = 1; // On lit quand même ce qui reste, mais aucune réponse ne pourra partir.
+                if (evenements[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR) && lireSession(s))
+                    s->perdue = 1; // Out of memory: la session est abandonnée, les autres continuent.
+                if (evenements[i].events & EPOLLOUT)
+                    envoyerSession(s);
+                avancerSession(epoll, s);
+            }
+        }
 
-    // Si num2 plus grand que num1, par exemple 11 - 12
-    if (!compareNum(nombre1, nombre2)) { // Si num1 < num2
-        temp = soustraction(nombre2, nombre1);
-        if (!temp)
-            goto deleteSous;
-        if (copyNum(temp, resultatSoustraction))
-            goto deleteTempSous;
-        deleteNumber(temp);
-        resultatSoustraction->negatif = 1;
-        return resultatSoustraction;
+        /* Les réponses sont traitées après les événements: une session ne peut être fermée que par son propre
+           événement ou par sa réponse, jamais pendant qu'un événement la concernant reste à traiter. */
+        if (reponsesPretes) {
+            if (read(travaux.reveil, &compteur, sizeof(compteur)) < 0 && errno != EAGAIN)
+                perror("eventfd");
+            pthread_mutex_lock(&travaux.verrou);
+            faites = travaux.faites;
+            travaux.faites = NULL;
+            pthread_mutex_unlock(&travaux.verrou);
+            while (faites) {
+                s = faites;
+                faites = s->suivante;
+                s->occupee = 0;
+                free(s->ligne);
+                s->ligne = NULL;
+                if (!s->reponse.len) {
+                    const char *message = "Out of Memory. Le programme n'a plus assez de mémoire pour fonctionner normalement.\n> ";
+                    if (ecrireSession(s, message, strlen(message)))
+                        s->perdue = 1;
+                }
+                else if (ecrireSession(s, s->reponse.data, s->reponse.len))
+                    s->perdue = 1;
+                envoyerSession(s);
+                avancerSession(epoll, s);
+            }
+        }
     }
 
-    resultatSoustraction->chiffres = NULL;
-    chiffre1 = nombre1->chiffres; // Pointeur sur le premier chiffre de num1
-    chiffre2 = nombre2->chiffres; // Pointeur sur le premier chiffre de num2
+    fin:
+    pthread_mutex_lock(&travaux.verrou);
+    travaux.arret = 1;
+    pthread_cond_broadcast(&travaux.signal);
+    pthread_mutex_unlock(&travaux.verrou);
+    for (i = 0; i < lances; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    while (sessions)
+        fermerSession(sessions);
+    if (epoll >= 0)
+        close(epoll);
+    if (travaux.reveil >= 0)
+        close(travaux.reveil);
+    if (ecoute >= 0) {
+        close(ecoute);
+        unlink(chemin);
+    }
+    fermerTrace();
+    return erreur;
+}
 
-    while(chiffre2) {
+void* travailleur(void *argument) {
+    session *s;
+    unsigned long long un = 1;
+    (void) argument;
 
-        // Je fais la soustraction entre les deux chiffres.
-        soustractionIntermediaire = (chiffre1->chiffre - '0') - ((chiffre2->chiffre - '0') + reste);
-        if (soustractionIntermediaire < 0) {
-            soustractionIntermediaire += 10;
-            reste = 1;
+    while (1) {
+        pthread_mutex_lock(&travaux.verrou);
+        while (!travaux.tete && !travaux.arret)
+            pthread_cond_wait(&travaux.signal, &travaux.verrou);
+        if (travaux.arret) {
+            pthread_mutex_unlock(&travaux.verrou);
+            return NULL;
         }
-        else
-            reste = 0;
-
-        if (addTailNum(resultatSoustraction, (char) (soustractionIntermediaire + '0')))
-            goto deleteSous;
-        chiffre1 = chiffre1->suivant;
-        chiffre2 = chiffre2->suivant;
+        s = travaux.tete;
+        travaux.tete = s->suivante;
+        if (!travaux.tete)
+            travaux.queue = NULL;
+        pthread_mutex_unlock(&travaux.verrou);
+
+        // La réponse est rendue en mémoire puis envoyée par la boucle epoll, qui seule touche aux sockets.
+        calc_buffer_clear(&s->reponse);
+        calc_eval_line(s->calc, s->ligne, strlen(s->ligne), &s->reponse);
+        if (calc_buffer_append(&s->reponse, "> ", 2))
+            calc_buffer_clear(&s->reponse);
+        viderTrace();
+
+        pthread_mutex_lock(&travaux.verrou);
+        s->suivante = travaux.faites;
+        travaux.faites = s;
+        pthread_mutex_unlock(&travaux.verrou);
+        if (write(travaux.reveil, &un, sizeof(un)) < 0)
+            perror("eventfd");
     }
+}
 
-    while(chiffre1) {
-        soustractionIntermediaire = (chiffre1->chiffre - '0') - reste;
-        if (soustractionIntermediaire < 0) {
-            soustractionIntermediaire += 10;
-            reste = 1;
+void accepterClients(int epoll, int ecoute) {
+    struct epoll_event evenement;
+    session *s;
+    int client;
+
+    while ((client = accept(ecoute, NULL, NULL)) >= 0) {
+        fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+        s = calloc(1, sizeof(session));
+        calc_ctx *calc = calc_new();
+        if (!s || !calc) {
+            close(client);
+            free(s);
+            calc_free(calc);
+            continue;
         }
-        else
-            reste = 0;
-
-        if (addTailNum(resultatSoustraction, (char) (soustractionIntermediaire + '0')))
-            goto deleteSous;
-        chiffre1 = chiffre1->suivant;
+        s->fd = client;
+        s->calc = calc;
+        s->evenements = EPOLLIN;
+        evenement.events = EPOLLIN;
+        evenement.data.ptr = s;
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, client, &evenement)) {
+            close(client);
+            free(s);
+            calc_free(calc);
+            continue;
+        }
+        s->apres = sessions;
+        if (sessions)
+            sessions->avant = s;
+        sessions = s;
+        if (ecrireSession(s, "> ", 2)) // Invite, comme la console.
+            s->perdue = 1;
+        envoyerSession(s);
+        avancerSession(epoll, s);
     }
+}
 
-    resultatSoustraction->negatif = 0;
-    enleverPoidsForts0(resultatSoustraction);
-    return resultatSoustraction;
-
-    deleteSous:
-    deleteNumber(resultatSoustraction);
-    return NULL;
+int lireSession(session *s) {
+    ssize_t lus;
 
-    deleteTempSous:
-    deleteNumber(resultatSoustraction);
-    deleteNumber(temp);
-    return NULL;
+    while (!s->finEntree) {
+        if (s->capaciteEntree - s->longueurEntree < TAILLE_LECTURE) {
+            if (s->debutEntree) { // Les lignes déjà confiées ne servent plus: on récupère leur place.
+                memmove(s->entree, s->entree + s->debutEntree, s->longueurEntree - s->debutEntree);
+                s->longueurEntree -= s->debutEntree;
+                s->debutEntree = 0;
+            }
+            if (s->capaciteEntree - s->longueurEntree < TAILLE_LECTURE) {
+                size_t capacite = s->capaciteEntree ? s->capaciteEntree * 2 : TAILLE_LECTURE * 2;
+                char *entree = malloc(capacite);
+                if (!entree)
+                    return 1;
+                if (s->entree) {
+                    memcpy(entree, s->entree, s->longueurEntree);
+                    free(s->entree);
+                }
+                s->entree = entree;
+                s->capaciteEntree = capacite;
+            }
+        }
+        lus = read(s->fd, s->entree + s->longueurEntree, s->capaciteEntree - s->longueurEntree);
+        if (lus > 0)
+            s->longueurEntree += (size_t) lus;
+        else if (lus == 0 || (errno != EAGAIN && errno != EINTR))
+            s->finEntree = 1; // Fin de l'envoi du client: ses dernières lignes seront quand même évaluées.
+        else if (errno == EAGAIN)
+            break;
+    }
+    return 0;
 }
 
-num* multiplication(num *nombre1, num *nombre2) {
-    num* resultatMultiplication = malloc(sizeof(num));
-    if (!resultatMultiplication)
-        return NULL;
+void avancerSession(int epoll, session *s) {
+    char *debut, *finLigne;
+    size_t longueur;
 
-    num *temp;
+    if (s->occupee)
+        return abonnerSession(epoll, s);
+    if (s->perdue || (s->finEntree && s->debutEntree == s->longueurEntree && s->debutSortie == s->longueurSortie)) {
+        fermerSession(s);
+        return;
+    }
+    if (s->longueurSortie - s->debutSortie > SORTIE_MAX_EN_ATTENTE)
+        return abonnerSession(epoll, s);
+
+    debut = s->entree + s->debutEntree;
+    longueur = s->longueurEntree - s->debutEntree;
+    finLigne = longueur ? memchr(debut, '\n', longueur) : NULL;
+    if (finLigne)
+        longueur = (size_t) (finLigne - debut);
+    else if (!s->finEntree || !longueur)
+        return abonnerSession(epoll, s); // Ligne incomplète: on attend la suite.
+
+    // Comme la console, une dernière ligne sans '\n' est évaluée quand le client a fini d'envoyer.
+    s->debutEntree += longueur + (finLigne ? 1 : 0);
+    s->ligne = malloc(longueur + 1);
+    if (!s->ligne) {
+        const char *message = "Out of Memory. Le programme n'a plus assez de mémoire pour fonctionner normalement.\n> ";
+        if (ecrireSession(s, message, strlen(message)))
+            s->perdue = 1;
+        envoyerSession(s);
+        return abonnerSession(epoll, s);
+    }
+    memcpy(s->ligne, debut, longueur);
+    s->ligne[longueur] = '\0';
+    s->occupee = 1;
+    s->suivante = NULL;
+    pthread_mutex_lock(&travaux.verrou);
+    if (travaux.queue)
+        travaux.queue->suivante = s;
+    else
+        travaux.tete = s;
+    travaux.queue = s;
+    pthread_cond_signal(&travaux.signal);
+    pthread_mutex_unlock(&travaux.verrou);
+    abonnerSession(epoll, s);
+}
+
+int ecrireSession(session *s, const char *texte, size_t longueur) {
+    if (s->perdue)
+        return 0;
+    if (s->capaciteSortie - s->longueurSortie < longueur) {
+        if (s->debutSortie) {
+            memmove(s->sortie, s->sortie + s->debutSortie, s->longueurSortie - s->debutSortie);
+            s->longueurSortie -= s->debutSortie;
+            s->debutSortie = 0;
+        }
+        if (s->capaciteSortie - s->longueurSortie < longueur) {
+            size_t capacite = s->capaciteSortie ? s->capaciteSortie : 4096;
+            while (capacite - s->longueurSortie < longueur)
+                capacite *= 2;
+            char *sortie = malloc(capacite);
+            if (!sortie)
+                return 1;
+            if (s->sortie) {
+                memcpy(sortie, s->sortie, s->longueurSortie);
+                free(s->sortie);
+            }
+            s->sortie = sortie;
+            s->capaciteSortie = capacite;
+        }
+    }
+    memcpy(s->sortie + s->longueurSortie, texte, longueur);
+    s->longueurSortie += longueur;
+    return 0;
+}
 
-    if (!nombre1->chiffres || !nombre2->chiffres) {
-        resultatMultiplication->negatif = 0;
-        resultatMultiplication->chiffres = NULL;
-        return resultatMultiplication;
+void envoyerSession(session *s) {
+    ssize_t envoyes;
+
+    while (!s->perdue && s->debutSortie < s->longueurSortie) {
+        envoyes = send(s->fd, s->sortie + s->debutSortie, s->longueurSortie - s->debutSortie, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (envoyes >= 0)
+            s->debutSortie += (size_t) envoyes;
+        else if (errno == EAGAIN)
+            return; // Le reste partira sur EPOLLOUT.
+        else if (errno != EINTR)
+            s->perdue = 1;
     }
+    s->debutSortie = s->longueurSortie = 0;
+}
 
-    if (findLenNum(nombre2) > findLenNum(nombre1)) {  // Afin de s'assurer que ce soit toujours mon nombre le plus grand en premier.
-        temp = multiplication(nombre2, nombre1);
-        if (!temp)
-            goto deleteResultat;
-        if (copyNum(temp, resultatMultiplication))
-            goto deleteTempRes;
-        deleteNumber(temp);
-        return resultatMultiplication;
+void abonnerSession(int epoll, session *s) {
+    struct epoll_event evenement;
+    unsigned int voulus = 0;
+
+    if (!s->perdue && !s->finEntree && !(s->occupee && s->longueurEntree - s->debutEntree > ENTREE_MAX_EN_ATTENTE))
+        voulus |= EPOLLIN;
+    if (!s->perdue && s->debutSortie < s->longueurSortie)
+        voulus |= EPOLLOUT;
+    if (s->perdue && s->evenements != ~0u) {
+        epoll_ctl(epoll, EPOLL_CTL_DEL, s->fd, NULL); // Sinon EPOLLHUP reviendrait sans cesse pendant le calcul.
+        s->evenements = ~0u;
+    }
+    else if (!s->perdue && voulus != s->evenements) {
+        evenement.events = voulus;
+        evenement.data.ptr = s;
+        epoll_ctl(epoll, EPOLL_CTL_MOD, s->fd, &evenement);
+        s->evenements = voulus;
     }
+}
+
+void fermerSession(session *s) {
+    close(s->fd);
+    if (s->avant)
+        s->avant->apres = s->apres;
+    else
+        sessions = s->apres;
+    if (s->apres)
+        s->apres->avant = s->avant;
+    calc_free(s->calc);
+    calc_buffer_free(&s->reponse);
+    free(s->entree);
+    free(s->sortie);
+    free(s->ligne);
+    free(s);
+}
 
-    resultatMultiplication->negatif = 0;
-    resultatMultiplication->chiffres = NULL;
-    num* resultatInter = malloc(sizeof(num));
-    if (!resultatInter)
-        goto deleteResultat;
+int generateurCharge(const char *chemin, int clients, int requetes, const char *ligne) {
+    pthread_t *threads = malloc(sizeof(pthread_t) * (size_t) clients);
+    contexteClient *contextes = calloc((size_t) clients, sizeof(contexteClient));
+    long long *latences = malloc(sizeof(long long) * (size_t) clients * (size_t) requetes);
+    long long debut, duree, total = (long long) clients * requetes;
+    int lances, erreur = 0, i;
+
+    if (!threads || !contextes || !latences) {
+        fprintf(stderr, "Out of Memory.\n");
+        free(threads);
+        free(contextes);
+        free(latences);
+        return 1;
+    }
+    debut = maintenantNs();
+    for (lances = 0; lances < clients; lances++) {
+        contextes[lances].chemin = chemin;
+        contextes[lances].ligne = ligne;
+        contextes[lances].requetes = requetes;
+        contextes[lances].latences = latences + (size_t) lances * (size_t) requetes;
+        if (pthread_create(&threads[lances], NULL, clientCharge, &contextes[lances]))
+            break;
+    }
+    for (i = 0; i < lances; i++) {
+        pthread_join(threads[i], NULL);
+        erreur |= contextes[i].erreur;
+    }
+    duree = maintenantNs() - debut;
 
-    cell* chiffre2 = nombre2->chiffres;
-    int compteur = -1;
+    if (lances < clients || erreur)
+        fprintf(stderr, "Connexion à %s impossible ou perdue.\n", chemin);
+    else {
+        // Boucle fermée: chaque client attend la réponse avant d'envoyer sa requête suivante.
+        qsort(latences, (size_t) total, sizeof(long long), comparerDurees);
+        printf("clients: %d, requêtes: %lld, durée: %.3f s, débit: %.0f requêtes/s\n",
+               clients, total, duree / 1e9, total / (duree / 1e9));
+        printf("latence (µs): p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n", latences[total / 2] / 1e3,
+               latences[total * 99 / 100] / 1e3, latences[total * 999 / 1000] / 1e3, latences[total - 1] / 1e3);
+    }
+    free(threads);
+    free(contextes);
+    free(latences);
+    return lances < clients || erreur;
+}
 
-    while(chiffre2) {
-        resultatInter->negatif = 0;
-        resultatInter->chiffres = NULL;
-        int i;
-        for(i = 0; i < chiffre2->chiffre - '0'; i++) { // On fait des additions successives
-            temp = addition(resultatInter, nombre1);
-            if (!temp)
-                goto deleteInterResultat;
-            deleteChiffres(resultatInter);
-            if (copyNum(temp, resultatInter))
-                goto deleteTempInterRes;
-            deleteNumber(temp);
+void* clientCharge(void *argument) {
+    contexteClient *client = argument;
+    struct sockaddr_un adresse;
+    size_t longueur = strlen(client->ligne), envoye;
+    ssize_t n;
+    long long debut;
+    int fd, i;
+    char *requete = malloc(longueur + 1);
+
+    memset(&adresse, 0, sizeof(adresse));
+    adresse.sun_family = AF_UNIX;
+    strncpy(adresse.sun_path, client->chemin, sizeof(adresse.sun_path) - 1);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (!requete || fd < 0 || connect(fd, (struct sockaddr *) &adresse, sizeof(adresse)) || attendreInvite(fd)) {
+        client->erreur = 1;
+        goto fin;
+    }
+    memcpy(requete, client->ligne, longueur);
+    requete[longueur] = '\n';
+
+    for (i = 0; i < client->requetes; i++) {
+        debut = maintenantNs();
+        for (envoye = 0; envoye < longueur + 1; envoye += (size_t) n) {
+            n = send(fd, requete + envoye, longueur + 1 - envoye, MSG_NOSIGNAL);
+            if (n < 0) {
+                client->erreur = 1;
+                goto fin;
+            }
+        }
+        if (attendreInvite(fd)) {
+            client->erreur = 1;
+            goto fin;
         }
-        compteur++;
-        for(i = 0; i < compteur; i++)
-            if(addHeadNum(resultatInter, '0'))
-                return NULL; // A chaque fois que l'on passe au nombre suivant, on rajoute un 0 en poids faible de plus
+        client->latences[i] = maintenantNs() - debut;
+    }
 
-        temp = addition(resultatMultiplication, resultatInter); // Addition du résultat intermédiaire obtenu avec le résultat final
-        if (!temp)
-            goto deleteInterResultat;
-        deleteChiffres(resultatMultiplication);
+    fin:
+    if (fd >= 0)
+        close(fd);
+    free(requete);
+    return NULL;
+}
 
-        if (copyNum(temp, resultatMultiplication))
-            goto deleteTempInterRes;
-        deleteChiffres(resultatInter);
-        deleteNumber(temp);
-        chiffre2 = chiffre2->suivant;
-    }
-    free(resultatInter);
+int attendreInvite(int fd) {
+    char tampon[TAILLE_LECTURE], precedent = 0;
+    ssize_t n;
 
-    if (nombre1->negatif^nombre2->negatif)
-        resultatMultiplication->negatif = 1; // Dans le cas ou l'un des nombre serait négatif
-    else
-        resultatMultiplication->negatif = 0;
-    return resultatMultiplication;
+    while ((n = read(fd, tampon, sizeof(tampon))) > 0) {
+        // Aucune réponse ne contient "> " ailleurs qu'à sa fin.
+        if (tampon[n - 1] == ' ' && (n > 1 ? tampon[n - 2] : precedent) == '>')
+            return 0;
+        precedent = tampon[n - 1];
+    }
+    return 1;
+}
 
+#endif
 
-    deleteResultat:
-    deleteNumber(resultatMultiplication);
-    return NULL;
 
-    deleteTempRes:
-    deleteNumber(resultatMultiplication);
-    deleteNumber(temp);
-    return NULL;
+#ifdef BENCH
 
-    deleteInterResultat:
-    deleteNumber(resultatMultiplication);
-    deleteNumber(resultatInter);
-    return NULL;
+/* BANC D'ESSAI
+   Compilé seulement avec -DBENCH: le programme mesure alors chaque noyau pour des opérandes de 10 à 10^7 chiffres
+   au lieu de lancer la calculatrice. Les résultats sont écrits en JSON (un objet par noyau et par taille). */
 
-    deleteTempInterRes:
-    deleteNumber(resultatMultiplication);
-    deleteNumber(temp);
-    deleteNumber(resultatInter);
-    return NULL;
+const char *nomsNoyaux[NOMBRE_NOYAUX] = {"addition", "soustraction", "multiplication", "compareNum", "isEqual",
+                                         "transformationStructure", "printNumReverse", "postfixeEvaluation", "calc_eval_line"};
 
+num* nombreAleatoire(char *chaine, int chiffres) {
+    num *nombre = malloc(sizeof(num));
+    if (!nombre)
+        return NULL;
+    nombre->compteurRef = 0;
+    nombre->negatif = 0;
+    nombre->chiffres = NULL;
 
+    cell **queue = &nombre->chiffres; // Construction en temps linéaire, contrairement à addTailNum.
+    int i;
+    for (i = chiffres - 1; i >= 0; i--) {
+        cell *nouveau_chiffre = malloc(sizeof(cell));
+        if (!nouveau_chiffre) {
+            *queue = NULL;
+            deleteNumber(nombre);
+            return NULL;
+        }
+        nouveau_chiffre->chiffre = chaine[i];
+        *queue = nouveau_chiffre;
+        queue = &nouveau_chiffre->suivant;
+    }
+    *queue = NULL;
+    return nombre;
 }
 
-void enleverPoidsForts0(num *nombre) {
-    cell* tail = checkTailNum(nombre);
-    while (tail  && tail->chiffre == '0') {
-        deleteTailNum(nombre);
-        tail = checkTailNum(nombre);
+int executerNoyau(int noyau, contexteBench *ctx) {
+    num *resultat = NULL;
+    pile *stack;
+    memoire *buffer;
+
+    switch (noyau) {
+        case 0:
+            resultat = addition(ctx->nombre1, ctx->nombre2); break;
+        case 1:
+            resultat = soustraction(ctx->nombre2, ctx->nombre1); break;
+        case 2:
+            resultat = multiplication(ctx->nombre1, ctx->nombre2); break;
+        case 3: // nombre1 et nombreProche ne diffèrent que par le chiffre de poids fort, que compareNum et isEqual
+                // (du poids faible au poids fort) n'atteignent qu'au bout de la liste: les deux parcours sont complets.
+            ctx->puits += compareNum(ctx->nombre1, ctx->nombreProche);
+            return 0;
+        case 4:
+            ctx->puits += isEqual(ctx->nombre1, ctx->nombreProche);
+            return 0;
+        case 5:
+            resultat = transformationStructure(ctx->buffer, ctx->mem, ctx->stack, ctx->chaine1);
+            break;
+        case 6:
+            printNumReverse(stdout, ctx->nombre1);
+            fflush(stdout);
+            return 0;
+        case 7: // Ligne complète "chaine1 chaine2 +" évaluée mot par mot comme dans main.
+            stack = malloc(sizeof(pile));
+            buffer = malloc(sizeof(memoire));
+            if (!stack || !buffer) {
+                free(stack);
+                free(buffer);
+                return 1;
+            }
+            initPile(stack);
+            initMem(buffer);
+            int erreur = postfixeEvaluation(buffer, ctx->mem, stack, ctx->chaine1)
+                         || postfixeEvaluation(buffer, ctx->mem, stack, ctx->chaine2)
+                         || postfixeEvaluation(buffer, ctx->mem, stack, "+");
+            deletePile(stack);
+            deleteMem(buffer, NULL);
+            return erreur;
+        case 8: // La même ligne par la bibliothèque: copie de la ligne, découpage, rendu du résultat dans un tampon.
+            calc_buffer_clear(&ctx->resultat);
+            return calc_eval_line(ctx->calc, ctx->ligne, ctx->longueurLigne, &ctx->resultat) != CALC_OK;
+        default:
+            return 1;
     }
+    if (!resultat)
+        return 1; // Out of memory
+    deleteNumber(resultat);
+    return 0;
 }
 
-void printRev(cell *chiffre) {
-    if (!chiffre)
-        return;
-    printRev(chiffre->suivant);
-    printf("%c", chiffre->chiffre);
-} // Méthode récursive afin d'imprimer un nombre du bits de poids le plus fort au plus faible (ex: 10000)
-
-void printNumReverse(num *nombre) {
-    if(!nombre->chiffres) {
-        printf("0");
-        return;
+int benchmark(int argc, char *argv[]) {
+    long long chiffresMin = 10, chiffresMax = 10000000, chiffres;
+    int repetitions = 15, echauffement = 3, noyau, i, k;
+    int threads[CONFIGURATIONS_MAX] = {0}, configurations = 1, echelle = 0;
+    double budget = 5.0; // Secondes par noyau et par taille. Au-delà, les tailles supérieures sont sautées.
+    const char *fichierJson = NULL, *filtre = NULL;
+    FILE *json = stdout;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--min") && i + 1 < argc)
+            chiffresMin = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--max") && i + 1 < argc)
+            chiffresMax = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--repetitions") && i + 1 < argc)
+            repetitions = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--echauffement") && i + 1 < argc)
+            echauffement = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--budget") && i + 1 < argc)
+            budget = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+            fichierJson = argv[++i];
+        else if (!strcmp(argv[i], "--noyau") && i + 1 < argc)
+            filtre = argv[++i];
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads[0] = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--echelle") && i + 1 < argc)
+            echelle = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--min N] [--max N] [--repetitions R] [--echauffement W] [--budget secondes]"
+                            " [--json fichier] [--noyau nom] [--threads N] [--echelle N]\n", argv[0]);
+            return 1;
+        }
     }
-    if(nombre->negatif)
-        printf("-");
-    printRev(nombre->chiffres);
-} // Ajout du signe du nombre, et appel à printRev pour imprimer le nombre.
-
-int findLenNum(num *nombre) {
-    int longueur = 0;
-    cell* p = nombre->chiffres;
-    while(p) {
-        longueur++;
-        p = p->suivant;
+    if (repetitions < 1 || chiffresMin < 1 || chiffresMax < chiffresMin || echelle < 0 || echelle > THREADS_MAX) {
+        fprintf(stderr, "Paramètres invalides.\n");
+        return 1;
     }
-    return longueur;
-} // Permet de trouve la longueur d'un nombre en terme de chiffres.
-
-int compareNum(num *nombre1, num *nombre2) { // Renvoie 0 si nombre1 < num2, ou 1 si nombre1 >= num2
-
-    cell* pointeur1 = nombre1->chiffres;
-    cell* pointeur2 = nombre2->chiffres;
-
-    if(!pointeur1 && !pointeur2)
-        return 1; // Cas 0 et 0
-    else if(pointeur1 && !pointeur2) { // cas -13 et 0 et 13 et 0;
-        if (nombre1->negatif)
-            return 0;
+    if (echelle) { // Mise à l'échelle: la multiplication (par défaut) avec 1, 2, 4, ... puis echelle threads.
+        for (configurations = 0; (1 << configurations) < echelle; configurations++)
+            threads[configurations] = 1 << configurations;
+        threads[configurations++] = echelle;
+        if (!filtre)
+            filtre = "multiplication";
+    }
+    if (fichierJson && !(json = fopen(fichierJson, "w"))) {
+        fprintf(stderr, "Impossible d'ouvrir %s\n", fichierJson);
         return 1;
     }
-    else if(!pointeur1) { // Cas 0 et -13 OU 0 et 13
-        if(nombre2->negatif)
+    if (json == stdout) { // printNumReverse écrit sur stdout: le JSON part alors sur un duplicata de stdout.
+        json = fdopen(dup(fileno(stdout)), "w");
+        if (!json)
             return 1;
-        return 0;
     }
+    if (!freopen("/dev/null", "w", stdout))
+        return 1;
 
-    if(nombre1->negatif && !nombre2->negatif)
-        return 0; // -124 et 12 par exemple
-    else if (!nombre1->negatif && nombre2->negatif)
-        return 1; // 124 et -12 par exemple
-
-    int longueurNum1 = findLenNum(nombre1);
-    int longueurNum2 = findLenNum(nombre2);
-
-    if(longueurNum1 > longueurNum2 && nombre1->negatif && nombre2->negatif)
-        return 0; // Donc -1344 et -35, donc nombre1 < num2
-    else if(longueurNum1 > longueurNum2 && !nombre1->negatif && !nombre2->negatif)
-        return 1; // Donc 1344 et 35
-    else if (longueurNum1 < longueurNum2 && nombre1->negatif && nombre2->negatif)
-        return 1; // Donc -34 et -1344
-    else if (longueurNum1 < longueurNum2 && !nombre1->negatif && !nombre2->negatif)
-        return 0; // Donc 34 et 1344
-
-    int compteur = 0;
-    int i = 0;
-
-    // Les deux nombres sont donc de la même taille en longueur, et de même signe
-    while(1) {
-        pointeur1 = nombre1->chiffres;
-        pointeur2 = nombre2->chiffres;
-        while(i < longueurNum1 - 1 - compteur) { // Sinon on a deux chiffres de même longueur. On compare les chiffres 1 à 1 du poids le plus fort au plus faible.
-            pointeur1 = pointeur1->suivant;
-            pointeur2 = pointeur2->suivant;
-            i++;
+    long long *durees = malloc(sizeof(long long) * (size_t) repetitions);
+    contexteBench ctx;
+    int sauter[NOMBRE_NOYAUX][CONFIGURATIONS_MAX] = {{0}}, premier = 1;
+    long long precedente[NOMBRE_NOYAUX][CONFIGURATIONS_MAX] = {{0}}; // Médiane à la taille précédente, pour extrapoler la suivante.
+    long long reference = 0; // Médiane avec threads[0], pour l'accélération.
+    ctx.mem = malloc(sizeof(memoire));
+    ctx.buffer = malloc(sizeof(memoire));
+    ctx.stack = malloc(sizeof(pile));
+    ctx.calc = calc_new();
+    calc_buffer_init(&ctx.resultat);
+    if (!durees || !ctx.mem || !ctx.buffer || !ctx.stack || !ctx.calc) {
+        fprintf(stderr, "Out of Memory.\n");
+        return 1;
+    }
+    initMem(ctx.mem);
+    initMem(ctx.buffer);
+    initPile(ctx.stack);
+    ctx.puits = 0;
+    srand(42);
+
+    fprintf(json, "{\n  \"repetitions\": %d,\n  \"echauffement\": %d,\n  \"budget_s\": %g,\n  \"resultats\": [", repetitions, echauffement, budget);
+    fprintf(stderr, "%-24s %10s %7s %6s %14s %14s %14s\n", "noyau", "chiffres", "threads", "rep", "mediane (ns)", "p99 (ns)", "min (ns)");
+
+    for (chiffres = chiffresMin; chiffres <= chiffresMax; chiffres *= 10) {
+        // Deux opérandes aléatoires de la même taille, sans 0 de poids fort, et une copie du premier qui ne
+        // diffère que par le chiffre de poids fort.
+        int n = (int) chiffres;
+        ctx.chaine1 = malloc((size_t) n + 1);
+        ctx.chaine2 = malloc((size_t) n + 1);
+        if (!ctx.chaine1 || !ctx.chaine2) {
+            fprintf(stderr, "Out of Memory pour %lld chiffres.\n", chiffres);
+            break;
         }
-        if (pointeur1->chiffre - '0' == pointeur2->chiffre - '0') {
-            compteur++;
-            i = 0;
-            if(compteur == longueurNum1)
-                return 1; // On atteint la début de notre chaîne et tout est égal, alors 1
+        for (i = 0; i < n; i++) {
+            ctx.chaine1[i] = (char) ('0' + (i ? rand() % 10 : 1 + rand() % 9));
+            ctx.chaine2[i] = (char) ('0' + (i ? rand() % 10 : 1 + rand() % 9));
         }
-        else if (pointeur1->chiffre - '0' > pointeur2->chiffre - '0') {
-            if(nombre1->negatif)
-                return 0;
-            return 1;
+        ctx.chaine1[n] = ctx.chaine2[n] = '\0';
+        ctx.longueurLigne = 2 * (size_t) n + 3;
+        ctx.ligne = malloc(ctx.longueurLigne + 1);
+        if (!ctx.ligne) {
+            fprintf(stderr, "Out of Memory pour %lld chiffres.\n", chiffres);
+            break;
         }
-        else if (pointeur1->chiffre - '0' < pointeur2->chiffre - '0') {
-            if(nombre1->negatif)
-                return 1;
-            return 0;
+        sprintf(ctx.ligne, "%s %s +", ctx.chaine1, ctx.chaine2);
+        ctx.nombre1 = nombreAleatoire(ctx.chaine1, n);
+        ctx.nombre2 = nombreAleatoire(ctx.chaine2, n);
+        char original = ctx.chaine1[0]; // Chiffre de poids fort: les parcours du poids faible le voient en dernier.
+        ctx.chaine1[0] = (char) (original == '9' ? '8' : original + 1);
+        ctx.nombreProche = nombreAleatoire(ctx.chaine1, n);
+        ctx.chaine1[0] = original;
+        if (!ctx.nombre1 || !ctx.nombre2 || !ctx.nombreProche) {
+            fprintf(stderr, "Out of Memory pour %lld chiffres.\n", chiffres);
+            break;
         }
-    }
 
-} // Renvoie 0 si nombre1 < nombre2, ou 1 si nombre1 >= nombre2
+        for (noyau = 0; noyau < NOMBRE_NOYAUX; noyau++) {
+            if (filtre && strcmp(filtre, nomsNoyaux[noyau]))
+                continue;
+            for (k = 0; k < configurations; k++) {
+                definirThreads(threads[k]);
+                fprintf(json, "%s\n    {\"noyau\": \"%s\", \"chiffres\": %lld, \"threads\": %d, ", premier ? "" : ",",
+                        nomsNoyaux[noyau], chiffres, threadsCalcul());
+                premier = 0;
+                if (sauter[noyau][k]) {
+                    fprintf(json, "\"saute\": true}");
+                    fprintf(stderr, "%-24s %10lld %7d %6s %14s\n", nomsNoyaux[noyau], chiffres, threadsCalcul(), "-", "sauté (budget)");
+                    continue;
+                }
 
-int isEqual(num *nombre1, num *nombre2) {
-    if (!nombre1 || !nombre2)
-        return 0;
+                long long debutMesure = maintenantNs();
+                int faites = 0, erreur = 0;
+                for (i = 0; i < echauffement && !erreur; i++) {
+                    erreur = executerNoyau(noyau, &ctx);
+                    if ((maintenantNs() - debutMesure) / 1e9 > budget)
+                        break; // Un seul passage dépasse déjà le budget: pas d'autre échauffement.
+                }
+                for (i = 0; i < repetitions && !erreur; i++) {
+                    long long t = maintenantNs();
+                    erreur = executerNoyau(noyau, &ctx);
+                    durees[faites++] = maintenantNs() - t;
+                    if ((maintenantNs() - debutMesure) / 1e9 > budget)
+                        break;
+                }
+                if (erreur) {
+                    fprintf(json, "\"erreur\": \"out of memory\"}");
+                    fprintf(stderr, "%-24s %10lld %7d %6s %14s\n", nomsNoyaux[noyau], chiffres, threadsCalcul(), "-", "out of memory");
+                    sauter[noyau][k] = 1;
+                    continue;
+                }
+                qsort(durees, (size_t) faites, sizeof(long long), comparerDurees);
+                long long somme = 0;
+                for (i = 0; i < faites; i++)
+                    somme += durees[i];
+                long long mediane = durees[faites / 2];
+
+                // On saute les tailles suivantes si le budget est dépassé, ou si un seul passage à la taille suivante
+                // le dépasserait d'après la croissance observée entre les deux dernières tailles.
+                if ((maintenantNs() - debutMesure) / 1e9 > budget)
+                    sauter[noyau][k] = 1;
+                else if (precedente[noyau][k] > 0 && (double) mediane * ((double) mediane / (double) precedente[noyau][k]) / 1e9 > budget)
+                    sauter[noyau][k] = 1;
+                precedente[noyau][k] = mediane;
+                if (!k)
+                    reference = mediane;
+                long long p99 = durees[(faites * 99 + 99) / 100 - 1];
+                fprintf(json, "\"repetitions\": %d, \"mediane_ns\": %lld, \"p99_ns\": %lld, \"min_ns\": %lld, \"moyenne_ns\": %lld",
+                        faites, mediane, p99, durees[0], somme / faites);
+                if (echelle)
+                    fprintf(json, ", \"acceleration\": %.2f", (double) reference / (double) mediane);
+                fprintf(json, "}");
+                fprintf(stderr, "%-24s %10lld %7d %6d %14lld %14lld %14lld", nomsNoyaux[noyau], chiffres, threadsCalcul(), faites, mediane, p99, durees[0]);
+                if (echelle)
+                    fprintf(stderr, "   x%.2f", (double) reference / (double) mediane);
+                fprintf(stderr, "\n");
+            }
+        }
 
-    cell* pointeur1 = nombre1->chiffres;
-    cell* pointeur2 = nombre2->chiffres;
-    int compteur = 0;
-    int i = 0;
+        deleteNumber(ctx.nombre1);
+        deleteNumber(ctx.nombre2);
+        deleteNumber(ctx.nombreProche);
+        free(ctx.chaine1);
+        free(ctx.chaine2);
+        free(ctx.ligne);
+    }
 
-    if(!pointeur1 && !pointeur2)
-        return 1; // Cas 0 et 0
-    else if (!pointeur1 || !pointeur2)
-        return 0;
+    fprintf(json, "\n  ]\n}\n");
+    fclose(json);
+    free(durees);
+    deletePile(ctx.stack);
+    deleteMem(ctx.buffer, NULL);
+    deleteMem(ctx.mem, NULL);
+    calc_buffer_free(&ctx.resultat);
+    calc_free(ctx.calc);
+    return ctx.puits < 0; // puits empêche le compilateur d'éliminer les comparaisons mesurées.
+}
 
-    if (nombre1->negatif != nombre2->negatif)
-        return 0;
+#endif
 
-    int longueurNum1 = findLenNum(nombre1);
-    int longueurNum2 = findLenNum(nombre2);
 
-    if (longueurNum1 != longueurNum2)
-        return 0;
+#ifdef ORACLE
 
-    while(1) {
-        pointeur1 = nombre1->chiffres;
-        pointeur2 = nombre2->chiffres;
-        while(i < longueurNum1 - 1 - compteur) { // Sinon on a deux chiffres de même longueur. On compare les chiffres 1 à 1 du poids le plus fort au plus faible.
-            pointeur1 = pointeur1->suivant;
-            pointeur2 = pointeur2->suivant;
-            i++;
-        }
-        if (pointeur1->chiffre - '0' == pointeur2->chiffre - '0') {
-            compteur++;
-            i = 0;
-            if(compteur == longueurNum1)
-                return 1; // On atteint la début de notre chaîne et tout est égal, alors 1
-        }
-        else if (pointeur1->chiffre - '0' != pointeur2->chiffre - '0')
-            return 0;
-    }
-} // Renvoie 1 si num1 == num2,
+/* ORACLE GMP
+   Compilé seulement avec -DORACLE (et -lgmp): le programme génère des lignes postfixes aléatoires, reproductibles à
+   partir de la graine, les évalue mot par mot avec postfixeEvaluation et avec GMP, compare les résultats octet par
+   octet et rapporte, pour chaque opération et chaque taille d'opérande, le temps de la calculatrice rapporté à celui
+   de GMP. */
 
-cell* checkTailNum(num *nombre) {
-    cell* temp = nombre->chiffres;
-    if(!temp)
-        return NULL;
-    while(temp->suivant)
-        temp = temp->suivant;
-    return temp;
-} // checkTailNum retourne le bit de poids le plus fort d'un num.
+const char *nomsOperationsOracle[OPERATIONS_ORACLE] = {"+", "-", "*", "gcd", "head", "!", "sqrt", "len", "=x", "littéral",
+                                                      "variable"};
 
-int addHeadNum(num *nombre, char chiffre) {
-    cell *nouveau_chiffre = malloc(sizeof(cell));
-    if (!nouveau_chiffre)
-        return 1;
-    nouveau_chiffre->chiffre = chiffre;
-    nouveau_chiffre->suivant = nombre->chiffres;
-    nombre->chiffres = nouveau_chiffre;
-    return 0;
-} // Ajoute un chiffre au poids le plus faible du nombre (dans le cas de la multiplication, 0)
+const char *nomsVariablesOracle[NOMS_ORACLE] = {"a", "b", "c", "x", "y", "Z", "_t", "total", "acc2"};
 
-int addTailNum(num *nombre, char chiffre) {   // Ajouter un nombre au poid le plus fort.
-    cell *nouveau_chiffre = malloc(sizeof(cell));
-    if (!nouveau_chiffre)
-        return 1; // Out of memory
+unsigned long long aleatoireOracle(unsigned long long *graine) {
+    unsigned long long z = (*graine += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
 
-    nouveau_chiffre->chiffre = chiffre;
-    if(!nombre->chiffres) {
-        nouveau_chiffre->suivant = nombre->chiffres;  // on pointe le noeud tête
-        nombre->chiffres = nouveau_chiffre; // Ajout du noeud dans la liste
+int operationOracle(const char *mot) {
+    int i;
+    for (i = 0; i < 8; i++)
+        if (!strcmp(mot, nomsOperationsOracle[i]))
+            return i;
+    if (mot[0] == '=')
+        return 8;
+    return mot[0] >= '0' && mot[0] <= '9' ? 9 : 10;
+}
+
+int seauOracle(long long chiffres) {
+    int seau = 0;
+    for (; chiffres >= 10 && seau < SEAUX_ORACLE - 1; chiffres /= 10)
+        seau++;
+    return seau;
+}
+
+size_t chiffresGmp(mpz_t x) {
+    size_t chiffres = mpz_sizeinbase(x, 10); // Exact, ou un de trop.
+    if (chiffres > 1) {
+        mpz_t puissance;
+        mpz_init(puissance);
+        mpz_ui_pow_ui(puissance, 10, chiffres - 1);
+        if (mpz_cmpabs(x, puissance) < 0)
+            chiffres--;
+        mpz_clear(puissance);
     }
-    else {
-        cell* p = nombre->chiffres;
-        while(p->suivant)
-            p = p->suivant;
-        p->suivant = nouveau_chiffre; // Suivant pointe sur le nouveau chiffre;
-        nouveau_chiffre->suivant = NULL;
+    return chiffres;
+}
+
+int appliquerGmp(generateurOracle *gen, const char *mot) {
+    int operation = operationOracle(mot), i, erreur = 0;
+    mpz_t *sommet = gen->pile + gen->longueur - 1;
+
+    if (gen->nombreMots == gen->capaciteMots || (operation <= 4 && gen->longueur < 2)
+        || (operation >= 5 && operation <= 8 && !gen->longueur) || (operation >= 9 && gen->longueur == gen->capacite))
+        return 2;
+    for (i = 0; (operation == 8 || operation == 10) && i < NOMS_ORACLE; i++)
+        if (!strcmp(mot + (operation == 8), nomsVariablesOracle[i]))
+            break;
+    if ((operation == 8 && i == NOMS_ORACLE) || (operation == 10 && (i == NOMS_ORACLE || !gen->affectees[i])))
+        return 2; // Variable inconnue
+    if ((operation == 4 && mpz_sgn(*sommet) < 0)
+        || (operation == 5 && (mpz_sgn(*sommet) < 0 || mpz_cmp_ui(*sommet, FACTORIELLE_ORACLE) > 0))
+        || (operation == 6 && mpz_sgn(*sommet) < 0))
+        return 2;
+
+    long long debut = maintenantNs();
+    switch (operation) {
+        case 0:
+            mpz_add(sommet[-1], sommet[-1], sommet[0]); break;
+        case 1:
+            mpz_sub(sommet[-1], sommet[-1], sommet[0]); break;
+        case 2:
+            mpz_mul(sommet[-1], sommet[-1], sommet[0]); break;
+        case 3:
+            mpz_gcd(sommet[-1], sommet[-1], sommet[0]); break;
+        case 4: { // head: quotient tronqué par 10^(chiffres - k), qui garde le signe.
+            size_t chiffres = chiffresGmp(sommet[-1]);
+            if (mpz_cmp_ui(sommet[0], chiffres) < 0) {
+                mpz_ui_pow_ui(sommet[0], 10, chiffres - mpz_get_ui(sommet[0]));
+                mpz_tdiv_q(sommet[-1], sommet[-1], sommet[0]);
+            }
+            break;
+        }
+        case 5:
+            mpz_fac_ui(*sommet, mpz_get_ui(*sommet)); break;
+        case 6:
+            mpz_sqrt(*sommet, *sommet); break;
+        case 7:
+            mpz_set_ui(*sommet, chiffresGmp(*sommet)); break;
+        case 8: // L'affectation laisse la valeur sur la pile.
+            mpz_set(gen->variables[i], *sommet);
+            gen->affectees[i] = 1;
+            break;
+        case 9:
+            if (mot[0] == '0' && (mot[1] == 'x' || mot[1] == 'b'))
+                erreur = mpz_set_str(sommet[1], mot + 2, mot[1] == 'x' ? 16 : 2);
+            else
+                erreur = mpz_set_str(sommet[1], mot, 10);
+            break;
+        default:
+            mpz_set(sommet[1], gen->variables[i]); break;
     }
+    gen->durees[gen->nombreMots++] = maintenantNs() - debut;
+    if (erreur)
+        return 2;
+    if (operation <= 4)
+        gen->longueur--;
+    else if (operation >= 9)
+        gen->longueur++;
     return 0;
-} // Ajoute un chiffre de poids le plus fort au nombre. Utilisé dans les opérations.
+}
 
-void deleteTailNum(num *nombre) {
-    cell* temp;
-    cell* p = nombre->chiffres;
-    if (!p)
+void genererOperande(generateurOracle *gen) {
+    unsigned long long *graine = &gen->graine;
+    int choix = (int) (aleatoireOracle(graine) % 20), affectees = 0, i;
+    long long chiffres, n;
+    char *p = gen->mot;
+
+    for (i = 0; i < NOMS_ORACLE; i++)
+        affectees += gen->affectees[i];
+    if (choix < 4 && affectees) {
+        int rang = (int) (aleatoireOracle(graine) % (unsigned) affectees);
+        for (i = 0; i < NOMS_ORACLE; i++)
+            if (gen->affectees[i] && !rang--)
+                break;
+        strcpy(gen->mot, nomsVariablesOracle[i]);
         return;
-    else if (!p->suivant) {
-        free(p);
-        nombre->chiffres = NULL;
+    }
+    if (choix < 6) // Petits nombres, pour que ! ait des opérandes.
+        chiffres = 1 + (long long) (aleatoireOracle(graine) % 3);
+    else { // Taille log-uniforme entre 1 et chiffresMax chiffres.
+        double u = (double) (aleatoireOracle(graine) >> 11) / 9007199254740992.0;
+        chiffres = (long long) pow((double) gen->chiffresMax, u);
+        if (chiffres < 1)
+            chiffres = 1;
+        if (chiffres > gen->chiffresMax)
+            chiffres = gen->chiffresMax;
+    }
+
+    if (choix == 6) { // Hexadécimal, casse mélangée et zéros de poids fort admis.
+        *p++ = '0';
+        *p++ = 'x';
+        for (n = chiffres * 5 / 6 + 1; n > 0; n--)
+            *p++ = "0123456789abcdefABCDEF"[aleatoireOracle(graine) % 22];
+    }
+    else if (choix == 7 && chiffres <= 1000) { // Binaire, environ 3.32 bits par chiffre décimal.
+        *p++ = '0';
+        *p++ = 'b';
+        for (n = chiffres * 10 / 3 + 1; n > 0; n--)
+            *p++ = (char) ('0' + aleatoireOracle(graine) % 2);
     }
     else {
-        while(p->suivant->suivant)
-            p = p->suivant;
-        temp = p->suivant;
-        p->suivant = NULL;
-        free(temp);
+        *p++ = (char) ('0' + (chiffres == 1 ? aleatoireOracle(graine) % 10 : 1 + aleatoireOracle(graine) % 9));
+        for (n = chiffres - 1; n > 0; n--)
+            *p++ = (char) ('0' + aleatoireOracle(graine) % 10);
     }
+    *p = '\0';
 }
 
-void deleteNumber(num *nombre) {
-    if (!nombre) return;
-    cell* p = nombre->chiffres;
-    cell* suivant;
-    while (p)
-    {
-        suivant = p->suivant;
-        free(p);
-        p = suivant;
-    }
-    free(nombre);
+int emettreMot(generateurOracle *gen, FILE *ligne, const char *mot) {
+    if (gen->nombreMots)
+        fputc(' ', ligne);
+    fputs(mot, ligne);
+    return appliquerGmp(gen, mot);
 }
 
-void deleteChiffres(num *nombre) {
-    if (!nombre) return;
-    cell* p = nombre->chiffres;
-    cell* suivant;
-    while (p)
-    {
-        suivant = p->suivant;
-        free(p);
-        p = suivant;
+int genererLigne(generateurOracle *gen, FILE *ligne, char **attendu) {
+    static const char *binaires[] = {"+", "+", "+", "-", "-", "-", "*", "*", "gcd"};
+    unsigned long long *graine = &gen->graine;
+    // Une ligne sur huit empile jusqu'à profondeurMax opérandes, les autres restent peu profondes.
+    int profondeur = aleatoireOracle(graine) % 8 ? 2 + (int) (aleatoireOracle(graine) % 3) : gen->profondeurMax;
+    int operandes = 1 + (int) (aleatoireOracle(graine) % (unsigned) (2 * profondeur)), empiles = 0, erreur = 0;
+
+    gen->nombreMots = 0;
+    while (!erreur && (empiles < operandes || gen->longueur > 1)) {
+        if (empiles < operandes && (gen->longueur < 2 || (gen->longueur < profondeur && aleatoireOracle(graine) % 2))) {
+            genererOperande(gen);
+            erreur = emettreMot(gen, ligne, gen->mot);
+            empiles++;
+        }
+        else {
+            const char *operateur = binaires[aleatoireOracle(graine) % 9];
+            mpz_t *sommet = gen->pile + gen->longueur - 1;
+            if (*operateur == '*' && (long long) (mpz_sizeinbase(sommet[0], 10) + mpz_sizeinbase(sommet[-1], 10)) > 2 * gen->chiffresMax)
+                operateur = "+"; // Les produits en chaîne resteraient sinon au-delà des tailles demandées.
+            erreur = emettreMot(gen, ligne, operateur);
+        }
+        if (erreur)
+            break;
+
+        // Parfois, un opérateur unaire ou une affectation sur le sommet.
+        mpz_t *sommet = gen->pile + gen->longueur - 1;
+        int choix = (int) (aleatoireOracle(graine) % 16);
+        if (choix < 4 && mpz_sgn(*sommet) >= 0 && mpz_cmp_ui(*sommet, FACTORIELLE_ORACLE) <= 0)
+            erreur = emettreMot(gen, ligne, "!");
+        else if (choix == 4 && mpz_sgn(*sommet) >= 0)
+            erreur = emettreMot(gen, ligne, "sqrt");
+        else if (choix == 5 || choix == 6) {
+            sprintf(gen->mot, "=%s", nomsVariablesOracle[aleatoireOracle(graine) % NOMS_ORACLE]);
+            erreur = emettreMot(gen, ligne, gen->mot);
+        }
+        else if (choix == 7)
+            erreur = emettreMot(gen, ligne, "len");
+        else if (choix == 8) { // k entre 0 et un peu plus que la longueur du sommet.
+            sprintf(gen->mot, "%llu", aleatoireOracle(graine) % (chiffresGmp(*sommet) + 2));
+            erreur = emettreMot(gen, ligne, gen->mot) || emettreMot(gen, ligne, "head");
+        }
+    }
+    if (erreur) {
+        fprintf(stderr, "Mot généré invalide pour GMP.\n");
+        return 1;
     }
+    gen->longueur = 0;
+    return !(*attendu = mpz_get_str(NULL, 10, gen->pile[0]));
 }
 
-int copyNum(num* srcNum, num* destNum) {
-    if (!srcNum)
-        return 1; // Out of memory
+int evaluerOracle(memoire *mem, ligneDecoupee *decoupee, long long *durees, int *seaux, char **texte) {
+    int exception = decoupee->exception, i;
+    size_t longueur;
+    *texte = NULL;
 
-    destNum->chiffres = NULL;
-    destNum->negatif = srcNum->negatif;
-    cell *p = srcNum->chiffres;
-    while(p) {
-        if (addTailNum(destNum, p->chiffre))
-            return 1; // Out of memory
-        p = p->suivant;
+    pile *stack = malloc(sizeof(pile));
+    memoire *buffer = malloc(sizeof(memoire));
+    if (!stack || !buffer) {
+        free(stack);
+        free(buffer);
+        return 1;
     }
-    return 0; // OK
-}
-
-num* checkMem(num *nombre, memoire* mem) {
-    variable *ptr = mem->tete;
-    while(ptr) {
-        if (isEqual(nombre, ptr->nombre))
-            return ptr->nombre; // On a trouvé un nombre égal à num1 dans la pile
-        ptr = ptr->suivant;
+    initPile(stack);
+    initMem(buffer);
+
+    for (i = 0; !exception && i < decoupee->nombreMots; i++) {
+        char *mot = decoupee->mots[i];
+        int operation = operationOracle(mot), chiffres = 0;
+        if (operation <= 4 && stack->length >= 2) { // Taille du plus grand opérande.
+            chiffres = findLenNum(stack->top->nombre);
+            int autre = findLenNum(stack->top->suivant->nombre);
+            if (autre > chiffres)
+                chiffres = autre;
+        }
+        else if (operation <= 8 && stack->length)
+            chiffres = findLenNum(stack->top->nombre);
+        long long debut = maintenantNs();
+        exception = postfixeEvaluation(buffer, mem, stack, mot);
+        durees[i] = maintenantNs() - debut;
+        if (!exception && operation >= 9) // Littéral ou variable: la taille du nombre empilé.
+            chiffres = findLenNum(stack->top->nombre);
+        seaux[i] = seauOracle(chiffres);
     }
-    return NULL;
-}
 
-variable* rechercherVar(memoire* mem, char var) { // Retourne le noeud contenant la variable si présent
-    variable* ptr = mem->tete;
-    while (ptr) {
-        if (ptr->var == var)
-            return ptr;
-        ptr = ptr->suivant;
+    if (!exception && stack->length == 1) {
+        num *val1 = pop(stack);
+        val1->compteurRef++; // Tenu pendant retablirValeurs, comme dans evaluerMots.
+        if (retablirValeurs(buffer, mem))
+            exception = 1; // Out of memory
+        else {
+            deleteMem(buffer, val1);
+            buffer = NULL;
+        }
+        val1->compteurRef--;
+        if (!exception) {
+            FILE *sortie = open_memstream(texte, &longueur);
+            if (!sortie || afficherNombre(sortie, val1, 10))
+                exception = 1;
+            if (sortie)
+                fclose(sortie);
+        }
+        if (!val1->compteurRef)
+            deleteNumber(val1);
     }
-    return ptr;
+    else if (!exception)
+        exception = 2;
+
+    deletePile(stack);
+    if (buffer)
+        deleteMem(buffer, NULL);
+    return exception;
 }
 
-int affecterVal(memoire* mem, char var, num* nombre) { // Trouver la variable 'x' et met la valeur. Si non présente, on ajoute une nouvelle valeur.
-    variable *ptr = rechercherVar(mem, var);
-    if (ptr) {
-        ptr->nombre->compteurRef--;
-        if (!ptr->nombre->compteurRef)
-            deleteNumber(ptr->nombre);
-        ptr->nombre = nombre;
-        ptr->nombre->compteurRef++;
-        return 0; //OK
+int oracle(int argc, char *argv[]) {
+    unsigned long long graine = 1;
+    long long chiffresMax = 10000, totalMots = 0;
+    int lignes = 1000, profondeurMax = 32, threads = 0, continuer = 0, differences = 0, numero, i, k;
+    const char *fichierJson = NULL, *fichierRejeu = NULL;
+    FILE *json = NULL, *rejeu = NULL;
+    mesureOracle mesures[OPERATIONS_ORACLE][SEAUX_ORACLE] = {{{0, 0, 0}}};
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--graine") && i + 1 < argc)
+            graine = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--lignes") && i + 1 < argc)
+            lignes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--max") && i + 1 < argc)
+            chiffresMax = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--profondeur") && i + 1 < argc)
+            profondeurMax = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+            fichierJson = argv[++i];
+        else if (!strcmp(argv[i], "--rejeu") && i + 1 < argc)
+            fichierRejeu = argv[++i];
+        else if (!strcmp(argv[i], "--continuer"))
+            continuer = 1;
+        else {
+            fprintf(stderr, "Usage: %s [--graine S] [--lignes N] [--max chiffres] [--profondeur P] [--threads N]"
+                            " [--json fichier] [--rejeu fichier] [--continuer]\n", argv[0]);
+            return 1;
+        }
     }
-    else {
-        ptr = malloc(sizeof(variable));
-        if (!ptr)
-            return 1; // Out of memory
-
-        ptr->var = var;
-        ptr->nombre = nombre;
-        ptr->nombre->compteurRef++;
-        if (!mem->tete) {
-            mem->tete = ptr;
-            ptr->suivant = NULL;
+    if (lignes < 0 || chiffresMax < 1 || chiffresMax > 100000000 || profondeurMax < 2 || profondeurMax > 100000) {
+        fprintf(stderr, "Paramètres invalides.\n");
+        return 1;
+    }
+    if ((fichierJson && !(json = fopen(fichierJson, "w"))) || (fichierRejeu && !(rejeu = fopen(fichierRejeu, "w")))) {
+        fprintf(stderr, "Impossible d'ouvrir %s\n", json || !fichierJson ? fichierRejeu : fichierJson);
+        return 1;
+    }
+    if (threads)
+        definirThreads(threads);
+
+    generateurOracle gen;
+    gen.graine = graine;
+    gen.chiffresMax = chiffresMax;
+    gen.profondeurMax = profondeurMax;
+    gen.longueur = gen.nombreMots = 0;
+    gen.capacite = profondeurMax + 2;
+    gen.capaciteMots = 12 * profondeurMax + 12; // Au plus 4 profondeurMax tours de génération, de trois mots chacun.
+    gen.pile = malloc(sizeof(mpz_t) * (size_t) gen.capacite);
+    gen.mot = malloc((size_t) chiffresMax + 4096);
+    gen.durees = malloc(sizeof(long long) * (size_t) gen.capaciteMots);
+    long long *durees = malloc(sizeof(long long) * (size_t) gen.capaciteMots);
+    int *seaux = malloc(sizeof(int) * (size_t) gen.capaciteMots);
+    memoire *mem = malloc(sizeof(memoire));
+    if (!gen.pile || !gen.mot || !gen.durees || !durees || !seaux || !mem) {
+        fprintf(stderr, "Out of Memory.\n");
+        return 1;
+    }
+    for (i = 0; i < gen.capacite; i++)
+        mpz_init(gen.pile[i]);
+    for (i = 0; i < NOMS_ORACLE; i++) {
+        mpz_init(gen.variables[i]);
+        gen.affectees[i] = 0;
+    }
+    initMem(mem);
+
+    for (numero = 1; numero <= lignes; numero++) {
+        char *texteLigne = NULL, *attendu = NULL, *obtenu = NULL, extrait[104];
+        size_t tailleLigne = 0;
+        FILE *flux = open_memstream(&texteLigne, &tailleLigne);
+        if (!flux || genererLigne(&gen, flux, &attendu)) {
+            fprintf(stderr, "Out of Memory à la ligne %d.\n", numero);
+            differences++;
+            break;
+        }
+        fclose(flux);
+        if (rejeu)
+            fprintf(rejeu, "%s\n", texteLigne);
+        snprintf(extrait, sizeof(extrait), "%.100s%s", texteLigne, tailleLigne > 100 ? "..." : "");
+
+        ligneDecoupee decoupee;
+        decouperLigne(texteLigne, &decoupee); // Les mots pointent dans texteLigne.
+        int exception = decoupee.exception;
+        if (!exception && decoupee.nombreMots != gen.nombreMots)
+            exception = 2;
+        if (!exception)
+            exception = evaluerOracle(mem, &decoupee, durees, seaux, &obtenu);
+
+        if (exception || strcmp(obtenu, attendu)) {
+            size_t j = 0;
+            if (!exception)
+                for (; obtenu[j] == attendu[j]; j++) ;
+            fprintf(stderr, "Différence à la ligne %d (graine %llu, %zu caractères): %s\n", numero, graine, tailleLigne, extrait);
+            fprintf(stderr, "     GMP:          %.60s%s (%zu caractères)\n", attendu, strlen(attendu) > 60 ? "..." : "", strlen(attendu));
+            if (exception)
+                fprintf(stderr, "     calculatrice: erreur %d\n", exception);
+            else
+                fprintf(stderr, "     calculatrice: %.60s%s (%zu caractères, premier écart à l'octet %zu)\n", obtenu,
+                        strlen(obtenu) > 60 ? "..." : "", strlen(obtenu), j);
+            differences++;
         }
         else {
-            ptr->suivant = mem->tete;
-            mem->tete = ptr;
+            for (i = 0; i < decoupee.nombreMots; i++) {
+                mesureOracle *mesure = &mesures[operationOracle(decoupee.mots[i])][seaux[i]];
+                mesure->mots++;
+                mesure->calc += durees[i];
+                mesure->gmp += gen.durees[i];
+            }
+            totalMots += decoupee.nombreMots;
         }
-        return 0; //OK
+        free(decoupee.mots);
+        (free)(texteLigne);
+        (free)(attendu);
+        (free)(obtenu);
+        if (differences && !continuer)
+            break; // Après une différence, les variables des deux évaluateurs peuvent diverger.
     }
-}
-
-int retablirValeurs(memoire* buf, memoire* mem) {  // Rétablir la valeur des variables en memoire a partir du buf si tout est OK.
-    variable *ptr = buf->tete;                     // Ajouter les nouvelles variables si nécessaires si elles n,existent pas en memoire.
-    int longueur = 0;
 
-    // Afin d'être sûr que le rétablissement de la mémoire se fera sans problème.
-    // Si un échec appairaissait lors de l'affectation des valeurs à la mémoire principale, la mémoire principale contiendrait des valeurs
-    // issus du buffer, alors que l'on préfère garantir l'intégrite des données en mémoire principale.
-    // Ainsi on test qu'il y assez de blocs mémoires disponibles pour le rétablissement des valeurs.
-    while(ptr) {
-        longueur++;
-        ptr = ptr->suivant;
+    printf("%-10s %10s %10s %16s %16s %10s\n", "operation", "chiffres", "mots", "calc (ns/mot)", "gmp (ns/mot)", "rapport");
+    if (json)
+        fprintf(json, "{\n  \"graine\": %llu,\n  \"lignes\": %d,\n  \"differences\": %d,\n  \"mesures\": [", graine, lignes, differences);
+    int premier = 1;
+    for (i = 0; i < OPERATIONS_ORACLE; i++) {
+        for (k = 0; k < SEAUX_ORACLE; k++) {
+            mesureOracle *mesure = &mesures[i][k];
+            if (!mesure->mots)
+                continue;
+            long long chiffres = 1;
+            int e;
+            for (e = 0; e < k; e++)
+                chiffres *= 10;
+            double rapport = mesure->gmp ? (double) mesure->calc / (double) mesure->gmp : 0;
+            printf("%-10s %10lld %10lld %16lld %16lld %10.2f\n", nomsOperationsOracle[i], chiffres, mesure->mots,
+                   mesure->calc / mesure->mots, mesure->gmp / mesure->mots, rapport);
+            if (json)
+                fprintf(json, "%s\n    {\"operation\": \"%s\", \"chiffres\": %lld, \"mots\": %lld, \"calc_ns\": %lld, "
+                              "\"gmp_ns\": %lld, \"rapport\": %.3f}", premier ? "" : ",", nomsOperationsOracle[i],
+                        chiffres, mesure->mots, mesure->calc, mesure->gmp, rapport);
+            premier = 0;
+        }
     }
-
-    // Test qu'il n'y aura aucun problème d'allocation au moment du rétablissement des valeurs.
-    void *test = malloc(sizeof(variable)*longueur);
-    if (!test)
-        return 1;
-    else free(test);
-
-    ptr = buf->tete;
-    if (!ptr)
-        return 0; // Il n'y a rien à rétablir à partir du buffer.
-    while (ptr) {
-        if (affecterVal(mem, ptr->var, ptr->nombre))
-            return 1; // Out of memory
-        ptr = ptr->suivant;
+    if (json) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
     }
-    return 0;
+    if (rejeu)
+        fclose(rejeu);
+    fprintf(stderr, "%d lignes, %lld mots comparés, %d différence(s).\n", numero > lignes ? lignes : numero, totalMots, differences);
+
+    for (i = 0; i < gen.capacite; i++)
+        mpz_clear(gen.pile[i]);
+    for (i = 0; i < NOMS_ORACLE; i++)
+        mpz_clear(gen.variables[i]);
+    free(gen.pile);
+    free(gen.mot);
+    free(gen.durees);
+    free(durees);
+    free(seaux);
+    deleteMem(mem, NULL);
+    return differences != 0;
 }
 
-void deleteMem(memoire *mem, num *nombre) {
-    variable* ptr;
-    ptr = mem->tete;
-    variable* temp;
-    while (ptr) {
-        temp = ptr->suivant;
-        ptr->nombre->compteurRef--;
-        if (!ptr->nombre->compteurRef && !isEqual(ptr->nombre, nombre))
-            deleteNumber(ptr->nombre);
-        free(ptr);
-        ptr = temp;
-    }
-    free(mem);
-}
\ No newline at end of file
+#endif